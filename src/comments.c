@@ -98,6 +98,7 @@ comments_process_update_result (const struct updateResult * const result, gpoint
 	commentFeedPtr		commentFeed = (commentFeedPtr)user_data;
 	itemPtr			item;
 	nodePtr			node;
+	gboolean		itemChanged = FALSE;
 
 	debug_enter ("comments_process_update_result");
 
@@ -105,19 +106,21 @@ comments_process_update_result (const struct updateResult * const result, gpoint
 	g_return_if_fail (item != NULL);
 
 	/* note this is to update the feed URL on permanent redirects */
-	if (result->source && !g_strcmp0 (result->source, metadata_list_get (item->metadata, "commentFeedUri"))) {
+	if (result->source && g_strcmp0 (result->source, metadata_list_get (item->metadata, "commentFeedUri"))) {
 
 		debug2 (DEBUG_UPDATE, "updating comment feed URL from \"%s\" to \"%s\"",
 		                      metadata_list_get (item->metadata, "commentFeedUri"),
 				      result->source);
 
 		metadata_list_set (&(item->metadata), "commentFeedUri", result->source);
+		itemChanged = TRUE;
 	}
 
 	if (401 == result->httpstatus) { /* unauthorized */
 		commentFeed->error = g_strdup (_("Authorization Error"));
 	} else if (410 == result->httpstatus) { /* gone */
 		metadata_list_set (&item->metadata, "commentFeedGone", "true");
+		itemChanged = TRUE;
 	} else if (304 == result->httpstatus) {
 		debug1(DEBUG_UPDATE, "comment feed \"%s\" did not change", result->source);
 	} else if (result->data) {
@@ -170,6 +173,10 @@ comments_process_update_result (const struct updateResult * const result, gpoint
 	update_state_free (commentFeed->updateState);
 	commentFeed->updateState = update_state_copy (result->updateState);
 
+	/* the item is shared with the item cache, keep it in sync with the DB */
+	if (itemChanged)
+		db_item_update (item);
+
 	/* rerender item with new comments */
 	itemview_update_item (item);
 	itemview_update ();
@@ -50,7 +50,11 @@
 /* feed handling settings */
 #define DEFAULT_MAX_ITEMS		"maxitemcount"
 #define DEFAULT_UPDATE_INTERVAL		"default-update-interval"
+#define ADAPTIVE_UPDATE			"adaptive-update"
+#define ADAPTIVE_UPDATE_MIN_INTERVAL	"adaptive-update-min-interval"
+#define ADAPTIVE_UPDATE_MAX_INTERVAL	"adaptive-update-max-interval"
 #define STARTUP_FEED_ACTION		"startup-feed-action"
+#define SEARCH_INDEX			"search-index"
 
 /* folder handling settings */
 #define FOLDER_DISPLAY_MODE		"folder-display-mode"
@@ -82,6 +86,8 @@
 #define PROXY_USER			"proxy-authentication-user"
 #define PROXY_PASSWD			"proxy-authentication-password"
 #define DO_NOT_TRACK			"do-not-track"
+#define MAX_ACTIVE_UPDATES		"max-active-updates"
+#define MAX_HOST_UPDATES		"max-host-updates"
 
 /* initializing methods */
 void	conf_init (void);
@@ -27,6 +27,7 @@
 #include "db.h"
 #include "debug.h"
 #include "item.h"
+#include "item_cache.h"
 #include "itemset.h"
 #include "metadata.h"
 #include "vfolder.h"
@@ -34,11 +35,52 @@
 static sqlite3	*db = NULL;
 gboolean searchFolderRebuild = FALSE;
 
-/** hash of all prepared statements */
+/** hash of all prepared statements (name -> struct dbStatement) */
 static GHashTable *statements = NULL;
 
+/** TRUE if the full text search index is enabled and available */
+static gboolean searchIndex = FALSE;
+
+/** subscription metadata (node id -> metadata list) and node counters
+    (node id -> struct dbNodeCounters) preloaded for feed list startup */
+static GHashTable *preloadedMetadata = NULL;
+static GHashTable *preloadedCounters = NULL;
+
+struct dbNodeCounters {
+	guint	itemCount;
+	guint	unreadCount;
+};
+
 static void db_view_remove (const gchar *id);
 
+/** number of id parameters of statements used for batched item access */
+#define DB_ID_BATCH_SIZE	100
+
+/** column list parsed by db_load_item_from_columns() */
+#define DB_ITEM_COLUMNS \
+	"title," \
+	"read," \
+	"updated," \
+	"popup," \
+	"marked," \
+	"source," \
+	"source_id," \
+	"valid_guid," \
+	"description," \
+	"date," \
+	"comment_feed_id," \
+	"comment," \
+	"item_id," \
+	"parent_item_id," \
+	"node_id," \
+	"parent_node_id"
+
+/** batched item and metadata loading, shared with the read-only connections */
+#define DB_ITEM_LOAD_MANY_SQL \
+	"SELECT " DB_ITEM_COLUMNS " FROM items WHERE item_id IN (%s)"
+#define DB_METADATA_LOAD_MANY_SQL \
+	"SELECT item_id,key,value,nr FROM metadata WHERE item_id IN (%s) ORDER BY item_id,nr"
+
 static void
 db_prepare_stmt (sqlite3_stmt **stmt, const gchar *sql)
 {
@@ -55,33 +97,167 @@ db_prepare_stmt (sqlite3_stmt **stmt, const gchar *sql)
 		g_error ("Failure while preparing statement, (error=%d, %s) SQL: \"%s\"", res, sqlite3_errmsg(db), sql);
 }
 
+/* Prepared statement cache
+
+   All statements are registered using db_new_statement() and prepared
+   once during db_init(). Users fetch them with db_get_statement() and
+   must hand them back using db_release_statement() which resets the
+   statement for the next use. The statements are finalized on db_deinit(). */
+
+typedef struct dbStatement {
+	const gchar	*name;		/*<< name used for lookup */
+	gchar		*sql;		/*<< SQL text of the statement */
+	sqlite3_stmt	*stmt;		/*<< the cached prepared statement */
+	gboolean	inUse;		/*<< TRUE while handed out by db_get_statement() */
+	gint64		startTime;	/*<< start of current use (monotonic time) */
+
+	/* statistics */
+	guint		prepares;	/*<< number of statement compilations */
+	guint		reuses;		/*<< number of uses without compilation */
+	gint64		stepTime;	/*<< total usage time in microseconds */
+} *dbStatementPtr;
+
+/** maps statement handles in use to their cache entries */
+static GHashTable *statementsInUse = NULL;
+
+static void
+db_statement_free (gpointer data)
+{
+	dbStatementPtr	dbStmt = (dbStatementPtr)data;
+
+	if (dbStmt->stmt)
+		sqlite3_finalize (dbStmt->stmt);
+	g_free (dbStmt->sql);
+	g_free (dbStmt);
+}
+
 static void
 db_new_statement (const gchar *name, const gchar *sql)
 {
+	dbStatementPtr	dbStmt;
+
+	if (!statements) {
+		statements = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, db_statement_free);
+		statementsInUse = g_hash_table_new (g_direct_hash, g_direct_equal);
+	}
+
+	dbStmt = g_new0 (struct dbStatement, 1);
+	dbStmt->name = name;
+	dbStmt->sql = g_strdup (sql);
+
+	db_prepare_stmt (&dbStmt->stmt, sql);
+	dbStmt->prepares++;
+
+	g_hash_table_insert (statements, (gpointer)name, dbStmt);
+}
+
+/* Returns the given SQL with DB_ID_BATCH_SIZE item id parameters.
+   The given SQL must contain a single "%s" for the parameter list. */
+static gchar *
+db_id_batch_sql (const gchar *sqlFormat)
+{
+	GString	*params;
+	gchar	*sql;
+	guint	i;
+
+	params = g_string_new ("?");
+	for (i = 1; i < DB_ID_BATCH_SIZE; i++)
+		g_string_append (params, ",?");
+
+	sql = g_strdup_printf (sqlFormat, params->str);
+	g_string_free (params, TRUE);
+
+	return sql;
+}
+
+static void
+db_new_statement_for_id_batch (const gchar *name, const gchar *sqlFormat)
+{
+	gchar	*sql;
+
+	sql = db_id_batch_sql (sqlFormat);
+	db_new_statement (name, sql);
+	g_free (sql);
+}
+
+/* Binds up to DB_ID_BATCH_SIZE ids to a statement registered using
+   db_new_statement_for_id_batch(). Unused parameters stay NULL. */
+static void
+db_bind_id_batch (sqlite3_stmt *stmt, const gulong *ids, guint count)
+{
+	guint	i;
 
-	if (!statements)
-		statements = g_hash_table_new (g_str_hash, g_str_equal);
+	g_assert (count <= DB_ID_BATCH_SIZE);
 
-	g_hash_table_insert (statements, (gpointer)name, (gpointer)sql);
+	for (i = 0; i < count; i++)
+		sqlite3_bind_int (stmt, i + 1, ids[i]);
 }
 
 static sqlite3_stmt *
 db_get_statement (const gchar *name)
 {
-	sqlite3_stmt *statement;
-	gchar *sql;
+	dbStatementPtr	dbStmt;
+	sqlite3_stmt	*statement;
 
-	sql = (gchar *) g_hash_table_lookup (statements, name);
+	dbStmt = (dbStatementPtr) g_hash_table_lookup (statements, name);
+	if (!dbStmt)
+		g_error ("Fatal: unknown prepared statement \"%s\" requested!", name);
 
-	db_prepare_stmt (&statement, sql);
+	if (dbStmt->inUse) {
+		/* Nested use of the same statement: the cached handle is
+		   still being stepped, so compile a temporary one that is
+		   finalized again on release. */
+		debug1 (DEBUG_DB, "statement \"%s\" in use, preparing temporary copy", name);
+		db_prepare_stmt (&statement, dbStmt->sql);
+		dbStmt->prepares++;
+	} else {
+		statement = dbStmt->stmt;
+		dbStmt->inUse = TRUE;
+		dbStmt->reuses++;
+		sqlite3_reset (statement);
+		sqlite3_clear_bindings (statement);
+	}
 
-	if (!statement)
-		g_error ("Fatal: unknown prepared statement \"%s\" requested!", name);
+	dbStmt->startTime = g_get_monotonic_time ();
+	g_hash_table_insert (statementsInUse, statement, dbStmt);
 
-	sqlite3_reset (statement);
 	return statement;
 }
 
+static void
+db_release_statement (sqlite3_stmt *statement)
+{
+	dbStatementPtr	dbStmt;
+
+	dbStmt = (dbStatementPtr) g_hash_table_lookup (statementsInUse, statement);
+	g_return_if_fail (dbStmt != NULL);
+
+	g_hash_table_remove (statementsInUse, statement);
+	dbStmt->stepTime += g_get_monotonic_time () - dbStmt->startTime;
+
+	if (statement == dbStmt->stmt) {
+		sqlite3_reset (statement);
+		sqlite3_clear_bindings (statement);
+		dbStmt->inUse = FALSE;
+	} else {
+		sqlite3_finalize (statement);
+	}
+}
+
+static void
+db_statement_print_stats (gpointer key, gpointer value, gpointer user_data)
+{
+	dbStatementPtr	dbStmt = (dbStatementPtr)value;
+
+	if (0 == dbStmt->reuses)
+		return;
+
+	debug5 (DEBUG_PERF, "statement %-32s prepares=%u reuses=%u step time=%ldms (%ldus/use)",
+	        dbStmt->name, dbStmt->prepares, dbStmt->reuses,
+	        (long)(dbStmt->stepTime / 1000),
+	        (long)(dbStmt->stepTime / dbStmt->reuses));
+}
+
 static void
 db_exec (const gchar *sql)
 {
@@ -151,12 +327,47 @@ db_get_schema_version (void)
 	return schemaVersion;
 }
 
+static gint64
+db_info_get_int64 (const gchar *name, gint64 defaultValue)
+{
+	sqlite3_stmt	*stmt;
+	gint64		value = defaultValue;
+
+	db_prepare_stmt (&stmt, "SELECT value FROM info WHERE name = ?");
+	sqlite3_bind_text (stmt, 1, name, -1, SQLITE_TRANSIENT);
+	if (SQLITE_ROW == sqlite3_step (stmt))
+		value = sqlite3_column_int64 (stmt, 0);
+	sqlite3_finalize (stmt);
+
+	return value;
+}
+
+static void
+db_info_set_int64 (const gchar *name, gint64 value)
+{
+	sqlite3_stmt	*stmt;
+
+	db_prepare_stmt (&stmt, "REPLACE INTO info (name, value) VALUES (?, ?)");
+	sqlite3_bind_text (stmt, 1, name, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64 (stmt, 2, value);
+	if (SQLITE_DONE != sqlite3_step (stmt))
+		debug2 (DEBUG_DB, "setting info value %s failed: %s", name, sqlite3_errmsg (db));
+	sqlite3_finalize (stmt);
+}
+
+/** nesting depth of db_begin_transaction() calls, only the outermost
+    call starts a transaction (e.g. for all writes of a merge session) */
+static guint transactionDepth = 0;
+
 static void
 db_begin_transaction (void)
 {
 	gchar	*sql, *err;
 	gint	res;
 
+	if (transactionDepth++ > 0)
+		return;
+
 	sql = sqlite3_mprintf ("BEGIN");
 	res = sqlite3_exec (db, sql, NULL, NULL, &err);
 	if (SQLITE_OK != res)
@@ -171,6 +382,10 @@ db_end_transaction (void)
 	gchar	*sql, *err;
 	gint	res;
 
+	g_assert (transactionDepth > 0);
+	if (--transactionDepth > 0)
+		return;
+
 	sql = sqlite3_mprintf ("END");
 	res = sqlite3_exec (db, sql, NULL, NULL, &err);
 	if (SQLITE_OK != res)
@@ -179,51 +394,109 @@ db_end_transaction (void)
 	sqlite3_free (err);
 }
 
+/* Runs a pragma or query returning a single number */
+static gint
+db_query_int (const gchar *sql)
+{
+	sqlite3_stmt	*stmt;
+	gint		res, value;
+
+	db_prepare_stmt (&stmt, sql);
+	res = sqlite3_step (stmt);
+	if (SQLITE_ROW != res)
+		g_error ("Could not run \"%s\" (error code %d)!", sql, res);
+	value = sqlite3_column_int (stmt, 0);
+	sqlite3_finalize (stmt);
+
+	return value;
+}
+
 #define VACUUM_ON_FRAGMENTATION_RATIO	10
 
+/* Determines the fragmentation ratio using
+
+	PRAGMA page_count
+	PRAGMA freelist_count
+
+   as suggested by adriatic in this blog post
+   http://jeff.ecchi.ca/blog/2011/12/24/investigating-lifereas-startup-performance/#comment-19989 */
+static float
+db_get_fragmentation (void)
+{
+	gint	page_count, freelist_count;
+
+	page_count = db_query_int ("PRAGMA page_count");
+	freelist_count = db_query_int ("PRAGMA freelist_count");
+	if (0 == page_count)
+		return 0;
+
+	return (100 * (float)freelist_count/page_count);
+}
+
+/* SQL function to hash descriptions of items without a stored content hash */
 static void
-db_vacuum (void)
+db_item_content_hash_func (sqlite3_context *context, int argc, sqlite3_value **argv)
 {
-	sqlite3_stmt	*stmt;
-	gint		res, page_count, freelist_count;
+	gchar	*hash;
 
-	/* Determine fragmentation ratio using
+	hash = item_get_description_hash ((const gchar *) sqlite3_value_text (argv[0]));
+	sqlite3_result_text (context, hash, -1, g_free);
+}
 
-		PRAGMA page_count
-		PRAGMA freelist_count
+/* SQL function for case insensitive text search in search folder
+   rules, the 2nd argument is expected to be case folded already */
+static void
+db_casefold_contains_func (sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+	const gchar	*text = (const gchar *) sqlite3_value_text (argv[0]);
+	const gchar	*needle = (const gchar *) sqlite3_value_text (argv[1]);
+	gchar		*textCaseFold;
 
-	   as suggested by adriatic in this blog post
-	   http://jeff.ecchi.ca/blog/2011/12/24/investigating-lifereas-startup-performance/#comment-19989
-	   and perform VACUUM only when needed.
-	 */
+	if (!text || !needle) {
+		sqlite3_result_int (context, 0);
+		return;
+	}
 
-	db_prepare_stmt (&stmt, "PRAGMA page_count");
-	sqlite3_reset (stmt);
-	res = sqlite3_step (stmt);
-	if (SQLITE_ROW != res)
-		g_error ("Could not determine page count (error code %d)!", res);
-	page_count = sqlite3_column_int (stmt, 0);
-	sqlite3_finalize (stmt);
+	textCaseFold = g_utf8_casefold (text, -1);
+	sqlite3_result_int (context, NULL != strstr (textCaseFold, needle));
+	g_free (textCaseFold);
+}
 
-	db_prepare_stmt (&stmt, "PRAGMA freelist_count");
-	sqlite3_reset (stmt);
-	res = sqlite3_step (stmt);
-	if (SQLITE_ROW != res)
-		g_error ("Could not determine free list count (error code %d)!", res);
-	freelist_count = sqlite3_column_int (stmt, 0);
-	sqlite3_finalize (stmt);
+/* SQL function case folding text for the search index, so that the
+   index matches exactly what casefold_contains() matches */
+static void
+db_casefold_func (sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+	const gchar	*text = (const gchar *) sqlite3_value_text (argv[0]);
 
-	float fragmentation = (100 * (float)freelist_count/page_count);
-	if (fragmentation > VACUUM_ON_FRAGMENTATION_RATIO) {
-		debug2 (DEBUG_DB, "Performing VACUUM as freelist count/page count ratio %2.2f > %d",
-		                  fragmentation, VACUUM_ON_FRAGMENTATION_RATIO);
-		debug_start_measurement (DEBUG_DB);
-		db_exec ("VACUUM;");
-		debug_end_measurement (DEBUG_DB, "VACUUM");
-	} else {
-		debug2 (DEBUG_DB, "No VACUUM as freelist count/page count ratio %2.2f <= %d",
-		                  fragmentation, VACUUM_ON_FRAGMENTATION_RATIO);
+	if (!text) {
+		sqlite3_result_null (context);
+		return;
 	}
+
+	sqlite3_result_text (context, g_utf8_casefold (text, -1), -1, g_free);
+}
+
+/* Registers the SQL functions on the given connection */
+static void
+db_register_functions (sqlite3 *handle)
+{
+	gint	res;
+
+	res = sqlite3_create_function (handle, "item_content_hash", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+	                               NULL, db_item_content_hash_func, NULL, NULL);
+	if (SQLITE_OK != res)
+		g_error ("Could not register SQL function item_content_hash (error code %d)!", res);
+
+	res = sqlite3_create_function (handle, "casefold_contains", 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+	                               NULL, db_casefold_contains_func, NULL, NULL);
+	if (SQLITE_OK != res)
+		g_error ("Could not register SQL function casefold_contains (error code %d)!", res);
+
+	res = sqlite3_create_function (handle, "casefold", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+	                               NULL, db_casefold_func, NULL, NULL);
+	if (SQLITE_OK != res)
+		g_error ("Could not register SQL function casefold (error code %d)!", res);
 }
 
 static void
@@ -240,13 +513,290 @@ db_open (void)
 	g_free (filename);
 
 	sqlite3_extended_result_codes (db, TRUE);
+	db_register_functions (db);
+
+	/* The vacuum mode can only be set before the first table is
+	   created, existing DB files are converted by db_deinit() */
+	if (0 == db_query_int ("PRAGMA page_count"))
+		db_exec ("PRAGMA auto_vacuum=INCREMENTAL");
 
 	db_exec("PRAGMA journal_mode=WAL");
 	db_exec("PRAGMA page_size=32768");
 	db_exec("PRAGMA synchronous=NORMAL");
 }
 
-#define SCHEMA_TARGET_VERSION 10
+/* Full text search index */
+
+/* Bump whenever the indexed content changes, the index is rebuilt then */
+#define DB_SEARCH_INDEX_VERSION		3
+
+/* Number of items indexed per maintenance step */
+#define DB_SEARCH_INDEX_STEP_ITEMS	500
+
+/** highest item id indexed so far while the index is built, -1 if complete */
+static gint64 searchIndexCursor = -1;
+
+static void
+db_search_index_set_cursor (gint64 cursor)
+{
+	searchIndexCursor = cursor;
+	db_info_set_int64 ("searchIndexCursor", cursor);
+}
+
+static gboolean
+db_search_index_create (void)
+{
+	gchar	*err = NULL;
+	gint	res;
+
+	/* The trigram tokenizer matches substrings (which includes token
+	   prefixes and phrases) so the index can be used for the
+	   "contains" rules without changing their semantics. */
+	res = sqlite3_exec (db, "CREATE VIRTUAL TABLE items_fts USING fts5 ("
+	                        "   title, description, category, tokenize = 'trigram'"
+	                        ");", NULL, NULL, &err);
+	if (SQLITE_OK != res) {
+		g_warning ("Full text search index not available (%s)!", err);
+		sqlite3_free (err);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void
+db_search_index_rebuild (void)
+{
+	if (!searchIndex)
+		return;
+
+	debug0 (DEBUG_DB, "Scheduling rebuild of the full text search index...");
+
+	/* Recreating is much faster than deleting all entries */
+	db_begin_transaction ();
+	db_exec ("DROP TABLE items_fts;");
+	if (!db_search_index_create ()) {
+		db_exec ("DROP TRIGGER IF EXISTS items_fts_removal;");
+		searchIndex = FALSE;
+	}
+	db_search_index_set_cursor (0);
+	db_info_set_int64 ("searchIndexVersion", DB_SEARCH_INDEX_VERSION);
+	db_end_transaction ();
+}
+
+/* Indexes the next range of items, returns FALSE if the index is complete */
+static gboolean
+db_search_index_build_step (void)
+{
+	sqlite3_stmt	*stmt;
+	gint64		upper = 0;
+	gboolean	found = FALSE;
+
+	db_prepare_stmt (&stmt, "SELECT MAX(id) FROM (SELECT item_id AS id FROM items WHERE item_id > ? "
+	                        "ORDER BY item_id LIMIT " G_STRINGIFY (DB_SEARCH_INDEX_STEP_ITEMS) ")");
+	sqlite3_bind_int64 (stmt, 1, searchIndexCursor);
+	if (SQLITE_ROW == sqlite3_step (stmt) && SQLITE_NULL != sqlite3_column_type (stmt, 0)) {
+		upper = sqlite3_column_int64 (stmt, 0);
+		found = TRUE;
+	}
+	sqlite3_finalize (stmt);
+
+	if (!found) {
+		debug0 (DEBUG_DB, "Full text search index is complete");
+		db_search_index_set_cursor (-1);
+		return FALSE;
+	}
+
+	/* Items updated meanwhile might have been indexed already */
+	db_prepare_stmt (&stmt, "DELETE FROM items_fts WHERE rowid > ?1 AND rowid <= ?2");
+	sqlite3_bind_int64 (stmt, 1, searchIndexCursor);
+	sqlite3_bind_int64 (stmt, 2, upper);
+	if (SQLITE_DONE != sqlite3_step (stmt))
+		g_warning ("search index cleanup failed (%s)", sqlite3_errmsg (db));
+	sqlite3_finalize (stmt);
+
+	db_prepare_stmt (&stmt, "INSERT INTO items_fts (rowid, title, description, category) "
+	                        "SELECT item_id, casefold(title), casefold(description), "
+	                        "casefold((SELECT group_concat(value, ' ') FROM metadata WHERE metadata.item_id = items.item_id AND metadata.key = 'category')) "
+	                        "FROM items WHERE comment = 0 AND item_id > ?1 AND item_id <= ?2");
+	sqlite3_bind_int64 (stmt, 1, searchIndexCursor);
+	sqlite3_bind_int64 (stmt, 2, upper);
+	if (SQLITE_DONE != sqlite3_step (stmt))
+		g_warning ("search index build failed (%s)", sqlite3_errmsg (db));
+	sqlite3_finalize (stmt);
+
+	db_search_index_set_cursor (upper);
+
+	return TRUE;
+}
+
+gboolean
+db_search_index_available (void)
+{
+	/* A partial index would miss items */
+	return searchIndex && searchIndexCursor < 0;
+}
+
+static void
+db_search_index_setup (void)
+{
+	gboolean	enabled = TRUE;
+
+	conf_get_bool_value (SEARCH_INDEX, &enabled);
+
+	if (!enabled) {
+		if (db_table_exists ("items_fts")) {
+			debug0 (DEBUG_DB, "Dropping full text search index...");
+			db_exec ("DROP TRIGGER IF EXISTS items_fts_removal;");
+			db_exec ("DROP TABLE items_fts;");
+		}
+		return;
+	}
+
+	if (!db_table_exists ("items_fts")) {
+		if (!db_search_index_create ())
+			return;
+		db_search_index_set_cursor (0);
+		db_info_set_int64 ("searchIndexVersion", DB_SEARCH_INDEX_VERSION);
+	}
+
+	/* Index entries without item are removed by db_maintenance_run() */
+	db_exec ("CREATE TRIGGER IF NOT EXISTS items_fts_removal AFTER DELETE ON items "
+	         "BEGIN "
+	         "   DELETE FROM items_fts WHERE rowid = old.item_id; "
+	         "END;");
+
+	db_new_statement ("searchIndexRemoveStmt",
+	                  "DELETE FROM items_fts WHERE rowid = ?");
+
+	db_new_statement ("searchIndexInsertStmt",
+	                  "INSERT INTO items_fts (rowid, title, description, category) "
+	                  "VALUES (?, casefold(?), casefold(?), casefold(?))");
+
+	searchIndex = TRUE;
+
+	/* The index is built in the background by db_maintenance_run() */
+	if (DB_SEARCH_INDEX_VERSION != db_info_get_int64 ("searchIndexVersion", 0))
+		db_search_index_rebuild ();
+	else
+		searchIndexCursor = db_info_get_int64 ("searchIndexCursor", -1);
+
+	if (searchIndexCursor >= 0)
+		debug1 (DEBUG_DB, "Full text search index is incomplete, continuing after item %" G_GINT64_FORMAT, searchIndexCursor);
+}
+
+/* Bump whenever the trigger definitions in db_triggers_create() change */
+#define DB_TRIGGER_VERSION	1
+
+/* (Re)creates all triggers. Note: view counting triggers are set up
+   in the view preparation code (see db_view_create()) and the search
+   index trigger in db_search_index_setup() */
+static void
+db_triggers_create (void)
+{
+	db_exec ("DROP TRIGGER IF EXISTS item_insert;");
+	db_exec ("DROP TRIGGER IF EXISTS item_update;");
+	db_exec ("DROP TRIGGER IF EXISTS item_removal;");
+	db_exec ("DROP TRIGGER IF EXISTS subscription_removal;");
+	db_exec ("DROP TRIGGER IF EXISTS counters_item_insert_before;");
+	db_exec ("DROP TRIGGER IF EXISTS counters_item_insert;");
+	db_exec ("DROP TRIGGER IF EXISTS counters_item_update;");
+	db_exec ("DROP TRIGGER IF EXISTS counters_item_removal;");
+	db_exec ("DROP TRIGGER IF EXISTS counters_search_folder_insert;");
+	db_exec ("DROP TRIGGER IF EXISTS counters_search_folder_removal;");
+
+	/* This trigger does explicitely not remove comments! */
+	db_exec ("CREATE TRIGGER item_removal DELETE ON items "
+        	 "BEGIN "
+		 "   DELETE FROM metadata WHERE item_id = old.item_id; "
+		 "   DELETE FROM search_folder_items WHERE item_id = old.item_id; "
+        	 "END;");
+
+	db_exec ("CREATE TRIGGER subscription_removal DELETE ON subscription "
+        	 "BEGIN "
+		 "   DELETE FROM node WHERE node_id = old.node_id; "
+		 "   DELETE FROM subscription_metadata WHERE node_id = old.node_id; "
+		 "   DELETE FROM search_folder_items WHERE parent_node_id = old.node_id; "
+        	 "END;");
+
+	/* Counter triggers. Note: the counter rows are created without
+	   conflict clause, as one in a trigger would be overruled by the
+	   REPLACE of the item update statement. For the same reason
+	   REPLACE doesn't run delete triggers (no recursive triggers) so
+	   the old version of a replaced item is uncounted before insertion. */
+	db_exec ("CREATE TRIGGER counters_item_insert_before BEFORE INSERT ON items "
+	         "BEGIN "
+	         "   UPDATE node_counters SET "
+	         "      item_count = item_count - 1, "
+	         "      unread_count = unread_count - (SELECT read = 0 FROM items WHERE item_id = new.item_id) "
+	         "   WHERE node_id = (SELECT node_id FROM items WHERE item_id = new.item_id); "
+	         "   UPDATE node_counters SET unread_count = unread_count - 1 "
+	         "   WHERE node_id IN (SELECT node_id FROM search_folder_items WHERE item_id = new.item_id) "
+	         "   AND 0 = (SELECT read FROM items WHERE item_id = new.item_id); "
+	         "END;");
+
+	db_exec ("CREATE TRIGGER counters_item_insert AFTER INSERT ON items "
+	         "WHEN new.node_id IS NOT NULL "
+	         "BEGIN "
+	         "   INSERT INTO node_counters (node_id, item_count, unread_count) "
+	         "   SELECT new.node_id, 0, 0 WHERE NOT EXISTS (SELECT 1 FROM node_counters WHERE node_id = new.node_id); "
+	         "   UPDATE node_counters SET "
+	         "      item_count = item_count + 1, "
+	         "      unread_count = unread_count + (new.read = 0) "
+	         "   WHERE node_id = new.node_id; "
+	         "   UPDATE node_counters SET unread_count = unread_count + 1 "
+	         "   WHERE new.read = 0 AND node_id IN (SELECT node_id FROM search_folder_items WHERE item_id = new.item_id); "
+	         "END;");
+
+	db_exec ("CREATE TRIGGER counters_item_update AFTER UPDATE OF read, node_id ON items "
+	         "WHEN old.read IS NOT new.read OR old.node_id IS NOT new.node_id "
+	         "BEGIN "
+	         "   UPDATE node_counters SET "
+	         "      item_count = item_count - 1, "
+	         "      unread_count = unread_count - (old.read = 0) "
+	         "   WHERE node_id = old.node_id; "
+	         "   INSERT INTO node_counters (node_id, item_count, unread_count) "
+	         "   SELECT new.node_id, 0, 0 WHERE new.node_id IS NOT NULL AND NOT EXISTS (SELECT 1 FROM node_counters WHERE node_id = new.node_id); "
+	         "   UPDATE node_counters SET "
+	         "      item_count = item_count + 1, "
+	         "      unread_count = unread_count + (new.read = 0) "
+	         "   WHERE node_id = new.node_id; "
+	         "   UPDATE node_counters SET unread_count = unread_count + (new.read = 0) - (old.read = 0) "
+	         "   WHERE node_id IN (SELECT node_id FROM search_folder_items WHERE item_id = new.item_id); "
+	         "END;");
+
+	db_exec ("CREATE TRIGGER counters_item_removal AFTER DELETE ON items "
+	         "WHEN old.node_id IS NOT NULL "
+	         "BEGIN "
+	         "   UPDATE node_counters SET "
+	         "      item_count = item_count - 1, "
+	         "      unread_count = unread_count - (old.read = 0) "
+	         "   WHERE node_id = old.node_id; "
+	         "END;");
+
+	/* Search folder items are removed by the item_removal trigger
+	   which runs before the item is deleted, so its read state can
+	   still be looked up */
+	db_exec ("CREATE TRIGGER counters_search_folder_insert AFTER INSERT ON search_folder_items "
+	         "BEGIN "
+	         "   INSERT INTO node_counters (node_id, item_count, unread_count) "
+	         "   SELECT new.node_id, 0, 0 WHERE NOT EXISTS (SELECT 1 FROM node_counters WHERE node_id = new.node_id); "
+	         "   UPDATE node_counters SET "
+	         "      item_count = item_count + 1, "
+	         "      unread_count = unread_count + IFNULL((SELECT read = 0 FROM items WHERE item_id = new.item_id), 0) "
+	         "   WHERE node_id = new.node_id; "
+	         "END;");
+
+	db_exec ("CREATE TRIGGER counters_search_folder_removal AFTER DELETE ON search_folder_items "
+	         "BEGIN "
+	         "   UPDATE node_counters SET "
+	         "      item_count = item_count - 1, "
+	         "      unread_count = unread_count - IFNULL((SELECT read = 0 FROM items WHERE item_id = old.item_id), 0) "
+	         "   WHERE node_id = old.node_id; "
+	         "END;");
+}
+
+#define SCHEMA_TARGET_VERSION 11
 
 /* opening or creation of database */
 void
@@ -431,15 +981,20 @@ db_init (void)
 
 			searchFolderRebuild = TRUE;
 		}
+
+		if (db_get_schema_version () == 10) {
+			/* Description hash to allow merging without loading descriptions.
+			   Existing items get their hash computed lazily (see item_content_hash()) */
+			db_exec ("BEGIN; "
+			         "ALTER TABLE items ADD COLUMN content_hash TEXT; "
+			         "REPLACE INTO info (name, value) VALUES ('schemaVersion',11); "
+			         "END;" );
+		}
 	}
 
 	if (SCHEMA_TARGET_VERSION != db_get_schema_version ())
 		g_error ("Fatal: DB schema version not up-to-date! Running with --debug-db could give some hints about the problem!");
 
-	/* Vacuuming... */
-
-	db_vacuum ();
-
 	/* Schema creation */
 
 	debug_start_measurement (DEBUG_DB);
@@ -463,6 +1018,7 @@ db_init (void)
         	 "   date		INTEGER,"
         	 "   comment_feed_id	TEXT,"
 		 "   comment            INTEGER,"
+		 "   content_hash       TEXT,"
 		 "   PRIMARY KEY (item_id)"
         	 ");");
 
@@ -472,6 +1028,7 @@ db_init (void)
 	db_exec ("CREATE INDEX items_idx4 ON items (item_id);");
 	db_exec ("CREATE INDEX items_idx5 ON items (parent_item_id);");
 	db_exec ("CREATE INDEX items_idx6 ON items (parent_node_id);");
+	db_exec ("CREATE INDEX items_idx7 ON items (node_id, source_id);");
 
 	db_exec ("CREATE TABLE metadata ("
         	 "   item_id		INTEGER,"
@@ -524,84 +1081,50 @@ db_init (void)
 		 "   PRIMARY KEY (node_id, item_id)"
 		 ");");
 
-	db_end_transaction ();
-	debug_end_measurement (DEBUG_DB, "table setup");
-
-	/* 2. Removing old triggers */
-	db_exec ("DROP TRIGGER item_insert;");
-	db_exec ("DROP TRIGGER item_update;");
-	db_exec ("DROP TRIGGER item_removal;");
-	db_exec ("DROP TRIGGER subscription_removal;");
-
-	/* 3. Cleanup of DB */
-
-	/* Note: do not check on subscriptions here, as non-subscription node
-	   types (e.g. news bin) do contain items too. */
-	debug0 (DEBUG_DB, "Checking for items without a feed list node...\n");
-	db_exec ("DELETE FROM items WHERE comment = 0 AND node_id NOT IN "
-        	 "(SELECT node_id FROM node);");
-
-        debug0 (DEBUG_DB, "Checking for comments without parent item...\n");
-	db_exec ("BEGIN; "
-	         "   CREATE TEMP TABLE tmp_id ( id );"
-	         "   INSERT INTO tmp_id SELECT item_id FROM items WHERE comment = 1 AND parent_item_id NOT IN (SELECT item_id FROM items WHERE comment = 0);"
-	         /* limit to 1000 items as it is very slow */
-	         "   DELETE FROM items WHERE item_id IN (SELECT id FROM tmp_id LIMIT 1000);"
-	         "   DROP TABLE tmp_id;"
-		 "END;");
-
-	debug0 (DEBUG_DB, "Checking for search folder items without a feed list node...\n");
-	db_exec ("DELETE FROM search_folder_items WHERE parent_node_id NOT IN "
-        	 "(SELECT node_id FROM node);");
-
-	debug0 (DEBUG_DB, "Checking for search folder items without a search folder...\n");
-	db_exec ("DELETE FROM search_folder_items WHERE node_id NOT IN "
-        	 "(SELECT node_id FROM node);");
+	db_exec ("CREATE INDEX search_folder_items_idx ON search_folder_items (item_id);");
 
-	debug0 (DEBUG_DB, "Checking for search folder with comments...\n");
-	db_exec ("DELETE FROM search_folder_items WHERE comment = 1;");
-
-	debug0 (DEBUG_DB, "Checking for subscription metadata without node...\n");
-	db_exec ("DELETE FROM subscription_metadata WHERE node_id NOT IN "
-          	 "(SELECT node_id FROM node);");
-
-	debug0 (DEBUG_DB, "Removing metadata without item...\n");
-	db_exec ("DELETE FROM metadata WHERE item_id NOT IN "
-		 "(SELECT item_id FROM items);");
-
-	debug0 (DEBUG_DB, "DB cleanup finished. Continuing startup.");
+	/* Materialized item counters of feeds and search folders, kept
+	   up-to-date by the counter triggers created below */
+	db_exec ("CREATE TABLE node_counters ("
+	         "   node_id            STRING,"
+	         "   item_count         INTEGER,"
+	         "   unread_count       INTEGER,"
+		 "   PRIMARY KEY (node_id)"
+		 ");");
 
-	/* 4. Creating triggers (after cleanup so it is not slowed down by triggers) */
+	db_end_transaction ();
+	debug_end_measurement (DEBUG_DB, "table setup");
 
-	/* This trigger does explicitely not remove comments! */
-	db_exec ("CREATE TRIGGER item_removal DELETE ON items "
-        	 "BEGIN "
-		 "   DELETE FROM metadata WHERE item_id = old.item_id; "
-		 "   DELETE FROM search_folder_items WHERE item_id = old.item_id; "
-        	 "END;");
+	/* 2. Recreate the triggers only if their definitions have changed.
+	      DB cleanup is not done here but deferred to idle times, see
+	      db_maintenance_run(). */
+	if (DB_TRIGGER_VERSION != db_info_get_int64 ("triggerVersion", 0)) {
+		debug1 (DEBUG_DB, "updating triggers to version %d", DB_TRIGGER_VERSION);
+		db_begin_transaction ();
+		db_triggers_create ();
+		db_info_set_int64 ("triggerVersion", DB_TRIGGER_VERSION);
+		db_end_transaction ();
+	}
 
-	db_exec ("CREATE TRIGGER subscription_removal DELETE ON subscription "
-        	 "BEGIN "
-		 "   DELETE FROM node WHERE node_id = old.node_id; "
-		 "   DELETE FROM subscription_metadata WHERE node_id = old.node_id; "
-		 "   DELETE FROM search_folder_items WHERE parent_node_id = old.node_id; "
-        	 "END;");
+	/* 3. Initially fill the counters (e.g. after migrating from a
+	      version without counters). Otherwise they are checked by
+	      db_maintenance_run() only. */
+	if (!db_query_int ("SELECT EXISTS (SELECT 1 FROM node_counters)") &&
+	    db_query_int ("SELECT EXISTS (SELECT 1 FROM items)"))
+		db_node_counters_check ();
 
-	/* Note: view counting triggers are set up in the view preparation code (see db_view_create()) */
-	/* prepare statements */
+	/* 4. Prepare statements */
 
 	db_new_statement ("itemsetLoadStmt",
 	                  "SELECT item_id FROM items WHERE node_id = ?");
 
-	db_new_statement ("itemsetLoadOffsetStmt",
-			  "SELECT item_id FROM items WHERE comment = 0 LIMIT ? OFFSET ?");
-
-	db_new_statement ("itemsetReadCountStmt",
-	                  "SELECT COUNT(item_id) FROM items "
-		          "WHERE read = 0 AND node_id = ?");
+	/* Batches are fetched with a cursor on the item id instead of
+	   LIMIT/OFFSET which would need to skip all previous rows again */
+	db_new_statement ("itemsetLoadCursorStmt",
+			  "SELECT item_id FROM items WHERE comment = 0 AND item_id > ? ORDER BY item_id LIMIT ?");
 
-	db_new_statement ("itemsetItemCountStmt",
-	                  "SELECT COUNT(item_id) FROM items "
+	db_new_statement ("nodeCountersLoadStmt",
+	                  "SELECT item_count, unread_count FROM node_counters "
 		          "WHERE node_id = ?");
 
 	db_new_statement ("itemsetRemoveStmt",
@@ -614,7 +1137,17 @@ db_init (void)
 	                  "UPDATE items SET popup = 0 WHERE node_id = ?");
 
 	db_new_statement ("itemLoadStmt",
-	                  "SELECT "
+	                  "SELECT " DB_ITEM_COLUMNS " FROM items WHERE item_id = ?");
+
+	db_new_statement_for_id_batch ("itemLoadManyStmt", DB_ITEM_LOAD_MANY_SQL);
+
+	db_new_statement_for_id_batch ("itemHeaderLoadManyStmt",
+	                  "SELECT item_id,source_id,title,"
+	                  "IFNULL(content_hash,item_content_hash(description)),"
+	                  "date,read,marked FROM items WHERE item_id IN (%s)");
+
+	db_new_statement ("itemUpdateStmt",
+	                  "REPLACE INTO items ("
 	                  "title,"
 	                  "read,"
 	                  "updated,"
@@ -627,31 +1160,12 @@ db_init (void)
 	                  "date,"
 		          "comment_feed_id,"
 		          "comment,"
-		          "item_id,"
-			  "parent_item_id, "
-		          "node_id, "
-			  "parent_node_id "
-	                  " FROM items WHERE item_id = ?");
-
-	db_new_statement ("itemUpdateStmt",
-	                  "REPLACE INTO items ("
-	                  "title,"
-	                  "read,"
-	                  "updated,"
-	                  "popup,"
-	                  "marked,"
-	                  "source,"
-	                  "source_id,"
-	                  "valid_guid,"
-	                  "description,"
-	                  "date,"
-		          "comment_feed_id,"
-		          "comment,"
-	                  "item_id,"
-	                  "parent_item_id,"
-	                  "node_id,"
-	                  "parent_node_id"
-	                  ") values (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)");
+	                  "item_id,"
+	                  "parent_item_id,"
+	                  "node_id,"
+	                  "parent_node_id,"
+	                  "content_hash"
+	                  ") values (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)");
 
 	db_new_statement ("itemStateUpdateStmt",
 			  "UPDATE items SET read=?, marked=?, updated=? "
@@ -664,12 +1178,20 @@ db_init (void)
 	                  "SELECT node_id FROM items WHERE item_id IN "
 			  "(SELECT item_id FROM items WHERE source_id = ?)");
 
+	db_new_statement_for_id_batch ("duplicatesCountManyStmt",
+	                  "SELECT source_id, COUNT(*) FROM items WHERE source_id IN (%s) GROUP BY source_id");
+
+	db_new_statement_for_id_batch ("itemFindManyBySourceIdStmt",
+	                  "SELECT source_id, item_id FROM items WHERE node_id = ? AND source_id IN (%s) ORDER BY item_id");
+
 	db_new_statement ("duplicatesMarkReadStmt",
  	                  "UPDATE items SET read = 1, updated = 0 WHERE source_id = ?");
 
 	db_new_statement ("metadataLoadStmt",
 	                  "SELECT key,value,nr FROM metadata WHERE item_id = ? ORDER BY nr");
 
+	db_new_statement_for_id_batch ("metadataLoadManyStmt", DB_METADATA_LOAD_MANY_SQL);
+
 	db_new_statement ("metadataUpdateStmt",
 	                  "REPLACE INTO metadata (item_id,nr,key,value) VALUES (?,?,?,?)");
 
@@ -709,8 +1231,12 @@ db_init (void)
 	db_new_statement ("nodeUpdateStmt",
 	                  "REPLACE INTO node (node_id,parent_id,title,type,expanded,view_mode,sort_column,sort_reversed) VALUES (?,?,?,?,?,?,?,?)");
 
+	/* no REPLACE here, it would count an existing item twice */
 	db_new_statement ("itemUpdateSearchFoldersStmt",
-	                  "REPLACE INTO search_folder_items (node_id, parent_node_id, item_id) VALUES (?,?,?)");
+	                  "INSERT OR IGNORE INTO search_folder_items (node_id, parent_node_id, item_id) VALUES (?,?,?)");
+
+	db_new_statement ("itemSearchFoldersLoadStmt",
+	                  "SELECT node_id FROM search_folder_items WHERE item_id = ?;");
 
 	db_new_statement ("itemRemoveFromSearchFolderStmt",
 	                  "DELETE FROM search_folder_items WHERE node_id =? AND item_id = ?;");
@@ -718,11 +1244,8 @@ db_init (void)
 	db_new_statement ("searchFolderLoadStmt",
 	                  "SELECT item_id FROM search_folder_items WHERE node_id = ?;");
 
-	db_new_statement ("searchFolderCountStmt",
-	                  "SELECT count(item_id) FROM search_folder_items WHERE node_id = ?;");
-
-	db_new_statement ("searchFolderUnreadCountStmt",
-	                  "SELECT count(items.item_id) FROM search_folder_items JOIN items ON search_folder_items.item_id = items.item_id WHERE search_folder_items.node_id = ? and items.read = 0;");
+	db_new_statement ("searchFolderLoadCursorStmt",
+	                  "SELECT item_id FROM search_folder_items WHERE node_id = ? AND item_id > ? ORDER BY item_id LIMIT ?;");
 
 	db_new_statement ("nodeIdListStmt",
 	                  "SELECT node_id FROM node;");
@@ -730,6 +1253,9 @@ db_init (void)
 	db_new_statement ("nodeRemoveStmt",
 	                  "DELETE FROM node WHERE node_id = ?;");
 
+	/* 5. Optional full text search index */
+	db_search_index_setup ();
+
 	g_assert (sqlite3_get_autocommit (db));
 
 	debug_exit ("db_init");
@@ -738,17 +1264,45 @@ db_init (void)
 void
 db_deinit (void)
 {
+	guint	hits, misses;
 
 	debug_enter ("db_deinit");
 
 	if (FALSE == sqlite3_get_autocommit (db))
 		g_warning ("Fatal: DB not in auto-commit mode. This is a bug. Data may be lost!");
 
+	item_cache_get_stats (&hits, &misses);
+	debug2 (DEBUG_PERF, "item cache: %u hits, %u misses", hits, misses);
+	item_cache_clear ();
+
 	if (statements) {
+		g_hash_table_foreach (statements, db_statement_print_stats, NULL);
+		g_hash_table_destroy (statementsInUse);
 		g_hash_table_destroy (statements);
+		statementsInUse = NULL;
 		statements = NULL;
 	}
 
+	/* Incremental vacuuming (see db_maintenance_run()) needs a one time
+	   conversion by a full VACUUM. As this can take very long on large
+	   DB files it is not done in the idle time slices but on shutdown,
+	   and like the VACUUM formerly done on startup only when needed. */
+	if (2 != db_query_int ("PRAGMA auto_vacuum")) {
+		float fragmentation = db_get_fragmentation ();
+
+		if (fragmentation > VACUUM_ON_FRAGMENTATION_RATIO) {
+			debug2 (DEBUG_DB, "Converting DB to incremental vacuuming as freelist count/page count ratio %2.2f > %d",
+			                  fragmentation, VACUUM_ON_FRAGMENTATION_RATIO);
+			debug_start_measurement (DEBUG_DB);
+			db_exec ("PRAGMA auto_vacuum=INCREMENTAL");
+			db_exec ("VACUUM;");
+			debug_end_measurement (DEBUG_DB, "VACUUM");
+		} else {
+			debug2 (DEBUG_DB, "No VACUUM as freelist count/page count ratio %2.2f <= %d",
+			                  fragmentation, VACUUM_ON_FRAGMENTATION_RATIO);
+		}
+	}
+
 	if (SQLITE_OK != sqlite3_close (db))
 		g_warning ("DB close failed: %s", sqlite3_errmsg (db));
 
@@ -789,7 +1343,7 @@ db_item_metadata_load(itemPtr item)
 		metadata = db_metadata_list_append (metadata, key, value);
 	}
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
 	return metadata;
 }
@@ -813,7 +1367,7 @@ db_item_metadata_update_cb (const gchar *key,
 	if (SQLITE_DONE != res)
 		g_warning ("Update in \"metadata\" table failed (error code=%d, %s)", res, sqlite3_errmsg (db));
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
 }
 
@@ -858,8 +1412,6 @@ db_load_item_from_columns (sqlite3_stmt *stmt)
 	else
 		item->description = g_strdup ("");
 
-	item->metadata = db_item_metadata_load (item);
-
 	return item;
 }
 
@@ -880,7 +1432,7 @@ db_itemset_load (const gchar *id)
 		itemSet->ids = g_list_append (itemSet->ids, GUINT_TO_POINTER (sqlite3_column_int (stmt, 0)));
 	}
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
 	debug0 (DEBUG_DB, "loading of itemset finished");
 
@@ -893,6 +1445,10 @@ db_item_load (gulong id)
 	sqlite3_stmt	*stmt;
 	itemPtr 	item = NULL;
 
+	item = item_cache_lookup (id);
+	if (item)
+		return item;
+
 	debug1 (DEBUG_DB, "loading item %lu", id);
 	debug_start_measurement (DEBUG_DB);
 
@@ -901,18 +1457,170 @@ db_item_load (gulong id)
 
 	if (sqlite3_step (stmt) == SQLITE_ROW) {
 		item = db_load_item_from_columns (stmt);
+		item->metadata = db_item_metadata_load (item);
 		(void) sqlite3_step (stmt);
+		item_cache_add (item);
 	} else {
 		debug1 (DEBUG_DB, "Could not load item with id %lu!", id);
 	}
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
 	debug_end_measurement (DEBUG_DB, "item load");
 
 	return item;
 }
 
+/* Loads the item rows and metadata of up to DB_ID_BATCH_SIZE items
+   into the given hash (item id -> item) using the given statements
+   prepared with DB_ITEM_LOAD_MANY_SQL and DB_METADATA_LOAD_MANY_SQL */
+static void
+db_items_load_batch (sqlite3_stmt *itemStmt, sqlite3_stmt *metadataStmt,
+                     const gulong *ids, guint count, GHashTable *loaded)
+{
+	/* 1. Load item rows */
+	db_bind_id_batch (itemStmt, ids, count);
+	while (sqlite3_step (itemStmt) == SQLITE_ROW) {
+		itemPtr item = db_load_item_from_columns (itemStmt);
+		g_hash_table_insert (loaded, GUINT_TO_POINTER (item->id), item);
+	}
+
+	/* 2. Load metadata of all items in one pass */
+	db_bind_id_batch (metadataStmt, ids, count);
+	while (sqlite3_step (metadataStmt) == SQLITE_ROW) {
+		const char	*key, *value;
+		itemPtr		item;
+
+		item = g_hash_table_lookup (loaded, GUINT_TO_POINTER (sqlite3_column_int (metadataStmt, 0)));
+		if (!item)
+			continue;
+
+		key = (const char *) sqlite3_column_text (metadataStmt, 1);
+		value = (const char *) sqlite3_column_text (metadataStmt, 2);
+		if (g_str_equal (key, "enclosure"))
+			item->hasEnclosure = TRUE;
+		item->metadata = db_metadata_list_append (item->metadata, key, value);
+	}
+}
+
+/* Returns the loaded items in the order requested */
+static GList *
+db_items_sort_loaded (const gulong *ids, guint count, GHashTable *loaded)
+{
+	GList	*items = NULL;
+	guint	i;
+
+	for (i = count; i > 0; i--) {
+		gpointer key = GUINT_TO_POINTER (ids[i - 1]);
+		itemPtr item = g_hash_table_lookup (loaded, key);
+		if (item) {
+			g_hash_table_remove (loaded, key);
+			items = g_list_prepend (items, item);
+		} else {
+			debug1 (DEBUG_DB, "Could not load item with id %lu!", ids[i - 1]);
+		}
+	}
+
+	return items;
+}
+
+GList *
+db_items_load_many (const gulong *ids, guint count)
+{
+	sqlite3_stmt	*itemStmt, *metadataStmt;
+	GHashTable	*loaded;
+	GArray		*missing;
+	GList		*items;
+	guint		i, offset;
+
+	debug1 (DEBUG_DB, "loading %u items", count);
+	debug_start_measurement (DEBUG_DB);
+
+	loaded = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	/* Only load the items not in the item cache. Loaded items are
+	   not added to the cache to keep bulk loads from evicting the
+	   recently used items. */
+	missing = g_array_new (FALSE, FALSE, sizeof (gulong));
+	for (i = 0; i < count; i++) {
+		itemPtr item;
+
+		if (g_hash_table_contains (loaded, GUINT_TO_POINTER (ids[i])))
+			continue;
+
+		item = item_cache_lookup (ids[i]);
+		if (item)
+			g_hash_table_insert (loaded, GUINT_TO_POINTER (ids[i]), item);
+		else
+			g_array_append_val (missing, ids[i]);
+	}
+
+	for (offset = 0; offset < missing->len; offset += DB_ID_BATCH_SIZE) {
+		itemStmt = db_get_statement ("itemLoadManyStmt");
+		metadataStmt = db_get_statement ("metadataLoadManyStmt");
+		db_items_load_batch (itemStmt, metadataStmt, &g_array_index (missing, gulong, offset),
+		                     MIN (DB_ID_BATCH_SIZE, missing->len - offset), loaded);
+		db_release_statement (metadataStmt);
+		db_release_statement (itemStmt);
+	}
+	g_array_free (missing, TRUE);
+
+	items = db_items_sort_loaded (ids, count, loaded);
+	g_hash_table_destroy (loaded);
+
+	debug_end_measurement (DEBUG_DB, "batched item load");
+
+	return items;
+}
+
+GList *
+db_item_headers_load_many (const gulong *ids, guint count)
+{
+	sqlite3_stmt	*stmt;
+	GHashTable	*loaded;
+	GList		*headers = NULL;
+	guint		i, offset;
+
+	debug1 (DEBUG_DB, "loading %u item headers", count);
+	debug_start_measurement (DEBUG_DB);
+
+	loaded = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (offset = 0; offset < count; offset += DB_ID_BATCH_SIZE) {
+		stmt = db_get_statement ("itemHeaderLoadManyStmt");
+		db_bind_id_batch (stmt, &ids[offset], MIN (DB_ID_BATCH_SIZE, count - offset));
+		while (sqlite3_step (stmt) == SQLITE_ROW) {
+			itemHeaderPtr header = g_new0 (struct itemHeader, 1);
+
+			header->id		= sqlite3_column_int (stmt, 0);
+			header->sourceId	= g_strdup ((const gchar *) sqlite3_column_text (stmt, 1));
+			header->title		= g_strdup ((const gchar *) sqlite3_column_text (stmt, 2));
+			header->descriptionHash	= g_strdup ((const gchar *) sqlite3_column_text (stmt, 3));
+			header->time		= sqlite3_column_int64 (stmt, 4);
+			header->readStatus	= sqlite3_column_int (stmt, 5)?TRUE:FALSE;
+			header->flagStatus	= sqlite3_column_int (stmt, 6)?TRUE:FALSE;
+
+			g_hash_table_insert (loaded, GUINT_TO_POINTER (header->id), header);
+		}
+		db_release_statement (stmt);
+	}
+
+	for (i = count; i > 0; i--) {
+		gpointer key = GUINT_TO_POINTER (ids[i - 1]);
+		itemHeaderPtr header = g_hash_table_lookup (loaded, key);
+		if (header) {
+			g_hash_table_remove (loaded, key);
+			headers = g_list_prepend (headers, header);
+		}
+	}
+
+	g_hash_table_destroy (loaded);
+
+	debug_end_measurement (DEBUG_DB, "item header load");
+
+	return headers;
+}
+
 /* Item modification methods */
 
 static void
@@ -921,17 +1629,34 @@ db_item_search_folders_update (itemPtr item)
 	sqlite3_stmt	*stmt;
 	gint 		res;
 	GSList		*iter, *list;
+	GHashTable	*current;
+	GHashTableIter	hiter;
+	gpointer	id;
 
 	/* Bail on comments which are not covered by search folders */
 	if (item->isComment)
 		return;
 
-	/* Add item to all search folders it now belongs to */
+	/* Load the search folders the item currently belongs to, so
+	   that only membership changes need to be written */
+	current = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	stmt = db_get_statement ("itemSearchFoldersLoadStmt");
+	sqlite3_bind_int (stmt, 1, item->id);
+	while (sqlite3_step (stmt) == SQLITE_ROW)
+		g_hash_table_add (current, g_strdup ((const gchar *)sqlite3_column_text (stmt, 0)));
+	db_release_statement (stmt);
+
+	/* Add item to all search folders it newly belongs to */
 
 	stmt = db_get_statement ("itemUpdateSearchFoldersStmt");
 	iter = list = vfolder_get_all_with_item_id (item);
 	while (iter) {
 		vfolderPtr vfolder = (vfolderPtr)iter->data;
+		iter = g_slist_next (iter);
+
+		if (g_hash_table_remove (current, vfolder->node->id))
+			continue;
+
 		sqlite3_reset (stmt);
 		sqlite3_bind_text (stmt, 1, vfolder->node->id, -1, SQLITE_TRANSIENT);
 		sqlite3_bind_text (stmt, 2, item->nodeId, -1, SQLITE_TRANSIENT);
@@ -940,33 +1665,67 @@ db_item_search_folders_update (itemPtr item)
 
 		if (SQLITE_DONE != res)
 			g_warning ("item add to search folder failed (error code=%d, %s)", res, sqlite3_errmsg (db));
-		iter = g_slist_next (iter);
-
 	}
 	g_slist_free (list);
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
-	/* Remove item from all search folders it does not belong
-	   (we do not check if it is in there, just remove it) */
+	/* Remove item from all search folders it does not belong to anymore */
 
 	stmt = db_get_statement ("itemRemoveFromSearchFolderStmt");
-	iter = list = vfolder_get_all_without_item_id (item);
-	while (iter) {
-		vfolderPtr vfolder = (vfolderPtr)iter->data;
+	g_hash_table_iter_init (&hiter, current);
+	while (g_hash_table_iter_next (&hiter, &id, NULL)) {
 		sqlite3_reset (stmt);
-		sqlite3_bind_text (stmt, 1, vfolder->node->id, -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text (stmt, 1, (gchar *)id, -1, SQLITE_TRANSIENT);
 		sqlite3_bind_int (stmt, 2, item->id);
 		res = sqlite3_step (stmt);
 
 		if (SQLITE_DONE != res)
 			g_warning ("item remove from search folder failed (error code=%d, %s)", res, sqlite3_errmsg (db));
-		iter = g_slist_next (iter);
+	}
+
+	db_release_statement (stmt);
+
+	g_hash_table_destroy (current);
+}
+
+static void
+db_item_search_index_update (itemPtr item)
+{
+	sqlite3_stmt	*stmt;
+	GString		*categories;
+	GSList		*iter;
+	gint		res;
+
+	/* comments are not searched */
+	if (!searchIndex || item->isComment)
+		return;
 
+	stmt = db_get_statement ("searchIndexRemoveStmt");
+	sqlite3_bind_int (stmt, 1, item->id);
+	res = sqlite3_step (stmt);
+	if (SQLITE_DONE != res)
+		g_warning ("search index remove failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+	db_release_statement (stmt);
+
+	categories = g_string_new (NULL);
+	for (iter = metadata_list_get_values (item->metadata, "category"); iter; iter = g_slist_next (iter)) {
+		if (categories->len)
+			g_string_append_c (categories, ' ');
+		g_string_append (categories, (gchar *)iter->data);
 	}
-	g_slist_free (list);
 
-	sqlite3_finalize (stmt);
+	stmt = db_get_statement ("searchIndexInsertStmt");
+	sqlite3_bind_int  (stmt, 1, item->id);
+	sqlite3_bind_text (stmt, 2, item->title, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 3, item->description, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 4, categories->str, -1, SQLITE_TRANSIENT);
+	res = sqlite3_step (stmt);
+	if (SQLITE_DONE != res)
+		g_warning ("search index update failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+	db_release_statement (stmt);
+
+	g_string_free (categories, TRUE);
 }
 
 void
@@ -974,6 +1733,7 @@ db_item_update (itemPtr item)
 {
 	sqlite3_stmt	*stmt;
 	gint		res;
+	gchar		*contentHash;
 
 	debug2 (DEBUG_DB, "update of item \"%s\" (id=%lu)", item->title, item->id);
 	debug_start_measurement (DEBUG_DB);
@@ -981,6 +1741,7 @@ db_item_update (itemPtr item)
 	db_begin_transaction ();
 
 	/* Update the item... */
+	contentHash = item_get_description_hash (item->description);
 	stmt = db_get_statement ("itemUpdateStmt");
 	sqlite3_bind_text (stmt, 1,  item->title, -1, SQLITE_TRANSIENT);
 	sqlite3_bind_int  (stmt, 2,  item->readStatus?1:0);
@@ -1001,6 +1762,7 @@ db_item_update (itemPtr item)
 	sqlite3_bind_int  (stmt, 14, item->parentItemId);
 	sqlite3_bind_text (stmt, 15, item->nodeId, -1, SQLITE_TRANSIENT);
 	sqlite3_bind_text (stmt, 16, item->parentNodeId, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 17, contentHash, -1, SQLITE_TRANSIENT);
 
 	res = sqlite3_step (stmt);
 
@@ -1011,13 +1773,17 @@ db_item_update (itemPtr item)
 		debug2(DEBUG_DB, "insert into table \"items\": \"%s\" id : %lu", item->title, item->id);
 	}
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
+	g_free (contentHash);
 
 	db_item_metadata_update (item);
+	db_item_search_index_update (item);
 	db_item_search_folders_update (item);
 
 	db_end_transaction ();
 
+	item_cache_item_updated (item);
+
 	debug_end_measurement (DEBUG_DB, "item update");
 }
 
@@ -1044,12 +1810,28 @@ db_item_state_update (itemPtr item)
 	if (sqlite3_step (stmt) != SQLITE_DONE)
 		g_warning ("item state update failed (%s)", sqlite3_errmsg (db));
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
+
+	item_cache_item_state_updated (item);
 
 	debug_end_measurement (DEBUG_DB, "item state update");
 
 }
 
+void
+db_merge_session_begin (void)
+{
+	debug0 (DEBUG_DB, "starting merge session");
+	db_begin_transaction ();
+}
+
+void
+db_merge_session_end (void)
+{
+	db_end_transaction ();
+	debug0 (DEBUG_DB, "merge session committed");
+}
+
 void
 db_item_remove (gulong id)
 {
@@ -1066,7 +1848,9 @@ db_item_remove (gulong id)
 	if (SQLITE_DONE != res)
 		g_warning ("item remove failed (error code=%d, %s)", res, sqlite3_errmsg (db));
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
+
+	item_cache_item_removed (id);
 }
 
 GSList *
@@ -1089,13 +1873,79 @@ db_item_get_duplicates (const gchar *guid)
 		duplicates = g_slist_append (duplicates, GUINT_TO_POINTER (id));
 	}
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
 	debug_end_measurement (DEBUG_DB, "searching for duplicates");
 
 	return duplicates;
 }
 
+GHashTable *
+db_items_count_duplicates (GSList *guids)
+{
+	GHashTable	*counts;
+	sqlite3_stmt	*stmt;
+	guint		i;
+
+	debug_start_measurement (DEBUG_DB);
+
+	counts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	while (guids) {
+		stmt = db_get_statement ("duplicatesCountManyStmt");
+		for (i = 1; guids && i <= DB_ID_BATCH_SIZE; guids = g_slist_next (guids))
+			sqlite3_bind_text (stmt, i++, (const gchar *)guids->data, -1, SQLITE_TRANSIENT);
+
+		while (sqlite3_step (stmt) == SQLITE_ROW) {
+			g_hash_table_insert (counts,
+			                     g_strdup ((const gchar *) sqlite3_column_text (stmt, 0)),
+			                     GUINT_TO_POINTER (sqlite3_column_int (stmt, 1)));
+		}
+
+		db_release_statement (stmt);
+	}
+
+	debug_end_measurement (DEBUG_DB, "counting duplicates");
+
+	return counts;
+}
+
+GHashTable *
+db_items_find_by_source_ids (const gchar *nodeId, GSList *sourceIds)
+{
+	GHashTable	*ids;
+	sqlite3_stmt	*stmt;
+	guint		i;
+
+	debug_start_measurement (DEBUG_DB);
+
+	ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	/* The first parameter is the node id, followed by the source ids */
+	while (sourceIds) {
+		stmt = db_get_statement ("itemFindManyBySourceIdStmt");
+		sqlite3_bind_text (stmt, 1, nodeId, -1, SQLITE_TRANSIENT);
+		for (i = 2; sourceIds && i <= DB_ID_BATCH_SIZE + 1; sourceIds = g_slist_next (sourceIds))
+			sqlite3_bind_text (stmt, i++, (const gchar *)sourceIds->data, -1, SQLITE_TRANSIENT);
+
+		while (sqlite3_step (stmt) == SQLITE_ROW) {
+			const gchar *sourceId = (const gchar *) sqlite3_column_text (stmt, 0);
+
+			/* keep the oldest item in case of duplicates */
+			if (!g_hash_table_contains (ids, sourceId))
+				g_hash_table_insert (ids,
+				                     g_strdup (sourceId),
+				                     GUINT_TO_POINTER (sqlite3_column_int (stmt, 1)));
+		}
+
+		db_release_statement (stmt);
+	}
+
+	debug_end_measurement (DEBUG_DB, "resolving source ids");
+
+	return ids;
+}
+
 GSList *
 db_item_get_duplicate_nodes (const gchar *guid)
 {
@@ -1116,7 +1966,7 @@ db_item_get_duplicate_nodes (const gchar *guid)
 		duplicates = g_slist_append (duplicates, id);
 	}
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
 	debug_end_measurement (DEBUG_DB, "searching for duplicates");
 
@@ -1139,7 +1989,9 @@ db_itemset_remove_all (const gchar *id)
 	if (SQLITE_DONE != res)
 		g_warning ("removing all items failed (error code=%d, %s)", res, sqlite3_errmsg (db));
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
+
+	item_cache_node_changed (id);
 
 }
 
@@ -1158,82 +2010,119 @@ db_itemset_mark_all_popup (const gchar *id)
 	if (SQLITE_DONE != res)
 		g_warning ("marking all items popup failed (error code=%d, %s)", res, sqlite3_errmsg(db));
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
+
+	item_cache_node_changed (id);
 
 }
 
 gboolean
-db_itemset_get (itemSetPtr itemSet, gulong offset, guint limit)
+db_itemset_get (itemSetPtr itemSet, dbItemCursor *cursor, guint limit)
 {
 	sqlite3_stmt	*stmt;
 	gboolean	success = FALSE;
 
-	debug2 (DEBUG_DB, "loading %d items offset %lu", limit, offset);
+	debug2 (DEBUG_DB, "loading %d items after item id %lu", limit, *cursor);
+	debug_start_measurement (DEBUG_DB);
 
-	stmt = db_get_statement ("itemsetLoadOffsetStmt");
-	sqlite3_bind_int (stmt, 1, limit);
-	sqlite3_bind_int (stmt, 2, offset);
+	stmt = db_get_statement ("itemsetLoadCursorStmt");
+	sqlite3_bind_int64 (stmt, 1, *cursor);
+	sqlite3_bind_int (stmt, 2, limit);
 
 	while (sqlite3_step (stmt) == SQLITE_ROW) {
-		itemSet->ids = g_list_append (itemSet->ids, GUINT_TO_POINTER (sqlite3_column_int (stmt, 0)));
+		*cursor = sqlite3_column_int (stmt, 0);
+		itemSet->ids = g_list_prepend (itemSet->ids, GUINT_TO_POINTER (*cursor));
 		success = TRUE;
 	}
+	itemSet->ids = g_list_reverse (itemSet->ids);
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
+
+	debug_end_measurement (DEBUG_DB, "item batch load");
 
 	return success;
 }
 
 /* Statistics interface */
 
-guint
-db_itemset_get_unread_count (const gchar *id)
+void
+db_node_get_counters (const gchar *id, guint *itemCount, guint *unreadCount)
 {
 	sqlite3_stmt	*stmt;
 	gint		res;
-	guint		count = 0;
 
-	debug_start_measurement (DEBUG_DB);
+	*itemCount = 0;
+	*unreadCount = 0;
+
+	if (preloadedCounters) {
+		struct dbNodeCounters *counters = g_hash_table_lookup (preloadedCounters, id);
+		if (counters) {
+			*itemCount = counters->itemCount;
+			*unreadCount = counters->unreadCount;
+		}
+		return;
+	}
 
-	stmt = db_get_statement ("itemsetReadCountStmt");
+	stmt = db_get_statement ("nodeCountersLoadStmt");
 	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
 	res = sqlite3_step (stmt);
 
-	if (SQLITE_ROW == res)
-		count = sqlite3_column_int (stmt, 0);
-	else
-		g_warning("item read counting failed (error code=%d, %s)", res, sqlite3_errmsg (db));
-
-	sqlite3_finalize (stmt);
-
-	debug_end_measurement (DEBUG_DB, "counting unread items");
+	if (SQLITE_ROW == res) {
+		*itemCount = sqlite3_column_int (stmt, 0);
+		*unreadCount = sqlite3_column_int (stmt, 1);
+	} else if (SQLITE_DONE != res) {
+		g_warning ("loading item counters failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+	}
 
-	return count;
+	db_release_statement (stmt);
 }
 
-guint
-db_itemset_get_item_count (const gchar *id)
+/* the counters as they are computed from the item tables */
+#define DB_COUNTERS_EXPECTED \
+	"SELECT node_id, COUNT(*), SUM(read = 0) FROM items " \
+	"WHERE node_id IS NOT NULL GROUP BY node_id " \
+	"UNION ALL " \
+	"SELECT search_folder_items.node_id, COUNT(*), SUM(IFNULL(items.read = 0, 0)) " \
+	"FROM search_folder_items LEFT JOIN items ON search_folder_items.item_id = items.item_id " \
+	"GROUP BY search_folder_items.node_id"
+
+gboolean
+db_node_counters_check (void)
 {
-	sqlite3_stmt 	*stmt;
-	gint		res;
-	guint		count = 0;
+	sqlite3_stmt	*stmt;
+	gint		mismatches = 0;
 
 	debug_start_measurement (DEBUG_DB);
 
-	stmt = db_get_statement ("itemsetItemCountStmt");
-	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
-	res = sqlite3_step (stmt);
+	/* Counter rows of emptied nodes are kept with zero values */
+	db_prepare_stmt (&stmt, "WITH expected AS (" DB_COUNTERS_EXPECTED ") "
+	                        "SELECT "
+	                        "(SELECT COUNT(*) FROM ("
+	                        "   SELECT * FROM expected EXCEPT "
+	                        "   SELECT node_id, item_count, unread_count FROM node_counters)) + "
+	                        "(SELECT COUNT(*) FROM ("
+	                        "   SELECT node_id, item_count, unread_count FROM node_counters "
+	                        "   WHERE item_count != 0 OR unread_count != 0 EXCEPT "
+	                        "   SELECT * FROM expected))");
+	if (SQLITE_ROW == sqlite3_step (stmt))
+		mismatches = sqlite3_column_int (stmt, 0);
+	sqlite3_finalize (stmt);
 
-	if (SQLITE_ROW == res)
-		count = sqlite3_column_int (stmt, 0);
-	else
-		g_warning ("item counting failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+	debug_end_measurement (DEBUG_DB, "checking item counters");
 
-	sqlite3_finalize (stmt);
+	if (0 == mismatches)
+		return TRUE;
+
+	debug1 (DEBUG_DB, "%d item counters are out of date, rebuilding all counters", mismatches);
 
-	debug_end_measurement (DEBUG_DB, "counting items");
+	debug_start_measurement (DEBUG_DB);
+	db_exec ("BEGIN; "
+	         "DELETE FROM node_counters; "
+	         "INSERT INTO node_counters (node_id, item_count, unread_count) " DB_COUNTERS_EXPECTED "; "
+	         "END;");
+	debug_end_measurement (DEBUG_DB, "rebuilding item counters");
 
-	return count;
+	return FALSE;
 }
 
 /* This method is only used for migration from old schema versions */
@@ -1329,7 +2218,7 @@ db_search_folder_load (const gchar *id)
 		itemSet->ids = g_list_append (itemSet->ids, GUINT_TO_POINTER (sqlite3_column_int (stmt, 0)));
 	}
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
 	debug1 (DEBUG_DB, "loading search folder finished (%d items)", g_list_length (itemSet->ids));
 
@@ -1382,59 +2271,113 @@ db_search_folder_add_items (const gchar *id, GSList *items)
 
 	}
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
 	debug0 (DEBUG_DB, "adding items to search folder finished");
 }
 
-guint
-db_search_folder_get_item_count (const gchar *id)
+void
+db_search_folder_add_ids (const gchar *id, const gulong *ids, guint count, const gchar *condition, GSList *params)
 {
 	sqlite3_stmt	*stmt;
+	GSList		*iter;
+	gchar		*idParams, *sql;
+	guint		i, offset;
 	gint		res;
-	guint		count = 0;
 
+	debug3 (DEBUG_DB, "add %u item ids matching \"%s\" to search folder node \"%s\"", count, condition, id);
 	debug_start_measurement (DEBUG_DB);
 
-	stmt = db_get_statement ("searchFolderCountStmt");
-	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
-	res = sqlite3_step (stmt);
+	/* The condition is checked again as the items might have
+	   changed since the ids were matched. The first parameter is
+	   the node id, followed by the item ids and the condition values. */
+	idParams = db_id_batch_sql ("%s");
+	sql = g_strdup_printf ("INSERT OR IGNORE INTO search_folder_items (node_id, parent_node_id, item_id) "
+	                       "SELECT ?, items.node_id, items.item_id FROM items "
+	                       "WHERE items.item_id IN (%s) AND items.comment = 0 AND (%s);", idParams, condition);
+	db_prepare_stmt (&stmt, sql);
 
-	if (SQLITE_ROW == res)
-		count = sqlite3_column_int (stmt, 0);
-	else
-		g_warning("item read counting failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+	db_begin_transaction ();
+	for (offset = 0; offset < count; offset += DB_ID_BATCH_SIZE) {
+		sqlite3_reset (stmt);
+		sqlite3_clear_bindings (stmt);
 
-	sqlite3_finalize (stmt);
+		sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
+		for (i = 0; i < MIN (DB_ID_BATCH_SIZE, count - offset); i++)
+			sqlite3_bind_int (stmt, i + 2, ids[offset + i]);
+		i = DB_ID_BATCH_SIZE + 2;
+		for (iter = params; iter; iter = g_slist_next (iter))
+			sqlite3_bind_text (stmt, i++, (const gchar *)iter->data, -1, SQLITE_TRANSIENT);
 
-	debug_end_measurement (DEBUG_DB, "counting unread items");
+		res = sqlite3_step (stmt);
+		if (SQLITE_DONE != res)
+			g_warning ("adding items to search folder failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+	}
+	db_end_transaction ();
 
-	return count;
+	sqlite3_finalize (stmt);
+	g_free (sql);
+	g_free (idParams);
+
+	debug_end_measurement (DEBUG_DB, "search folder item ids add");
 }
 
-guint
-db_search_folder_get_unread_count (const gchar *id)
+gboolean
+db_search_folder_add_matching (const gchar *id, const gchar *condition, GSList *params)
 {
 	sqlite3_stmt	*stmt;
-	gint		res;
-	guint		count = 0;
+	gchar		*sql;
+	gint		res, i = 2;
 
+	debug2 (DEBUG_DB, "adding items matching \"%s\" to search folder node \"%s\"", condition, id);
 	debug_start_measurement (DEBUG_DB);
 
-	stmt = db_get_statement ("searchFolderUnreadCountStmt");
+	sql = g_strdup_printf ("INSERT OR IGNORE INTO search_folder_items (node_id, parent_node_id, item_id) "
+	                       "SELECT ?, items.node_id, items.item_id FROM items "
+	                       "WHERE items.comment = 0 AND (%s);", condition);
+	db_prepare_stmt (&stmt, sql);
 	sqlite3_bind_text (stmt, 1, id, -1, SQLITE_TRANSIENT);
-	res = sqlite3_step (stmt);
+	for (; params; params = g_slist_next (params))
+		sqlite3_bind_text (stmt, i++, (const gchar *)params->data, -1, SQLITE_TRANSIENT);
 
-	if (SQLITE_ROW == res)
-		count = sqlite3_column_int (stmt, 0);
-	else
-		g_warning("item unread counting failed (error code=%d, %s)", res, sqlite3_errmsg (db));
+	res = sqlite3_step (stmt);
+	if (SQLITE_DONE != res)
+		g_warning ("adding matching items to search folder failed (error code=%d, %s)", res, sqlite3_errmsg (db));
 
 	sqlite3_finalize (stmt);
+	g_free (sql);
+
+	debug_end_measurement (DEBUG_DB, "search folder matching");
+
+	return (SQLITE_DONE == res);
+}
+
+gboolean
+db_search_folder_get (itemSetPtr itemSet, dbItemCursor *cursor, guint limit)
+{
+	sqlite3_stmt	*stmt;
+	gboolean	success = FALSE;
+
+	debug3 (DEBUG_DB, "loading %d items after item id %lu of search folder node \"%s\"", limit, *cursor, itemSet->nodeId);
+	debug_start_measurement (DEBUG_DB);
+
+	stmt = db_get_statement ("searchFolderLoadCursorStmt");
+	sqlite3_bind_text (stmt, 1, itemSet->nodeId, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64 (stmt, 2, *cursor);
+	sqlite3_bind_int (stmt, 3, limit);
+
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		*cursor = sqlite3_column_int (stmt, 0);
+		itemSet->ids = g_list_prepend (itemSet->ids, GUINT_TO_POINTER (*cursor));
+		success = TRUE;
+	}
+	itemSet->ids = g_list_reverse (itemSet->ids);
 
-	debug_end_measurement (DEBUG_DB, "counting unread items");
+	db_release_statement (stmt);
 
-	return count;
+	debug_end_measurement (DEBUG_DB, "search folder item batch load");
+
+	return success;
 }
 
 static GSList *
@@ -1454,7 +2397,7 @@ db_subscription_metadata_load (const gchar *id)
 		                                           (const char *) sqlite3_column_text(stmt, 1));
 	}
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
 	return metadata;
 }
@@ -1478,7 +2421,7 @@ db_subscription_metadata_update_cb (const gchar *key,
 	if (SQLITE_DONE != res)
 		g_warning ("Update in \"subscription_metadata\" table failed (error code=%d, %s)", res, sqlite3_errmsg (db));
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 }
 
 static void
@@ -1490,7 +2433,83 @@ db_subscription_metadata_update (subscriptionPtr subscription)
 void
 db_subscription_load (subscriptionPtr subscription)
 {
-	subscription->metadata = db_subscription_metadata_load (subscription->node->id);
+	gpointer	key, metadata;
+
+	if (!preloadedMetadata) {
+		subscription->metadata = db_subscription_metadata_load (subscription->node->id);
+		return;
+	}
+
+	/* Take over the preloaded list, subscriptions without metadata have none */
+	if (g_hash_table_lookup_extended (preloadedMetadata, subscription->node->id, &key, &metadata)) {
+		g_hash_table_steal (preloadedMetadata, key);
+		g_free (key);
+		subscription->metadata = (GSList *)metadata;
+	}
+}
+
+void
+db_startup_preload_begin (void)
+{
+	sqlite3_stmt	*stmt;
+	GSList		*metadata;
+	const gchar	*id;
+
+	g_assert (!preloadedMetadata && !preloadedCounters);
+
+	debug_start_measurement (DEBUG_DB);
+
+	/* One ordered scan instead of one query per subscription */
+	preloadedMetadata = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)metadata_list_free);
+	db_prepare_stmt (&stmt, "SELECT node_id,key,value FROM subscription_metadata ORDER BY node_id,nr");
+	while (SQLITE_ROW == sqlite3_step (stmt)) {
+		id = (const gchar *)sqlite3_column_text (stmt, 0);
+		if (!id)
+			continue;
+
+		/* appending keeps the list head, so only new lists are inserted */
+		metadata = g_hash_table_lookup (preloadedMetadata, id);
+		if (metadata) {
+			db_metadata_list_append (metadata, (const char *) sqlite3_column_text (stmt, 1),
+			                                   (const char *) sqlite3_column_text (stmt, 2));
+		} else {
+			metadata = db_metadata_list_append (NULL, (const char *) sqlite3_column_text (stmt, 1),
+			                                          (const char *) sqlite3_column_text (stmt, 2));
+			if (metadata)
+				g_hash_table_insert (preloadedMetadata, g_strdup (id), metadata);
+		}
+	}
+	sqlite3_finalize (stmt);
+
+	/* The counters are maintained by triggers, so all of them can
+	   be fetched with a single scan of the counter table */
+	preloadedCounters = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	db_prepare_stmt (&stmt, "SELECT node_id,item_count,unread_count FROM node_counters");
+	while (SQLITE_ROW == sqlite3_step (stmt)) {
+		struct dbNodeCounters *counters;
+
+		id = (const gchar *)sqlite3_column_text (stmt, 0);
+		if (!id)
+			continue;
+
+		counters = g_new0 (struct dbNodeCounters, 1);
+		counters->itemCount = sqlite3_column_int (stmt, 1);
+		counters->unreadCount = sqlite3_column_int (stmt, 2);
+		g_hash_table_insert (preloadedCounters, g_strdup (id), counters);
+	}
+	sqlite3_finalize (stmt);
+
+	debug2 (DEBUG_DB, "preloaded metadata of %u subscriptions and counters of %u nodes", g_hash_table_size (preloadedMetadata), g_hash_table_size (preloadedCounters));
+	debug_end_measurement (DEBUG_DB, "startup preload");
+}
+
+void
+db_startup_preload_end (void)
+{
+	g_hash_table_destroy (preloadedMetadata);
+	preloadedMetadata = NULL;
+	g_hash_table_destroy (preloadedCounters);
+	preloadedCounters = NULL;
 }
 
 void
@@ -1518,7 +2537,7 @@ db_subscription_update (subscriptionPtr subscription)
 	if (SQLITE_DONE != res)
 		g_warning ("Could not update subscription info for node id %s in DB (error code %d)!", subscription->node->id, res);
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
 	db_subscription_metadata_update (subscription);
 
@@ -1541,7 +2560,7 @@ db_subscription_remove (const gchar *id)
 	if (SQLITE_DONE != res)
 		g_warning ("Could not remove subscription %s from DB (error code %d)!", id, res);
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
 	debug_end_measurement (DEBUG_DB, "subscription remove");
 }
@@ -1569,7 +2588,7 @@ db_node_update (nodePtr node)
 	if (SQLITE_DONE != res)
 		g_warning ("Could not update node info %s in DB (error code %d)!", node->id, res);
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 
 	debug_end_measurement (DEBUG_DB, "node update");
 }
@@ -1605,7 +2624,7 @@ db_node_remove (const gchar *id)
 	if (SQLITE_DONE != res)
 		g_warning ("Could not remove node %s in DB (error code %d)!", id, res);
 
-	sqlite3_finalize (stmt);
+	db_release_statement (stmt);
 }
 
 void
@@ -1626,5 +2645,411 @@ db_node_cleanup (nodePtr root)
 		}
 	}
 
+	db_release_statement (stmt);
+}
+
+/* Deferred maintenance
+
+   Removing orphaned rows and vacuuming can take very long on large
+   DB files, so instead of blocking db_init() it is done in small steps
+   by db_maintenance_run() during idle times. The cleanup tasks sweep
+   their tables in rowid ranges. The current task and position are kept
+   in the info table, so an interrupted maintenance cycle continues
+   where it stopped on the next start. */
+
+/* Minimum time between maintenance cycles (in seconds) */
+#define DB_MAINTENANCE_INTERVAL		(24 * 60 * 60)
+
+/* Number of rows checked per cleanup step */
+#define DB_MAINTENANCE_STEP_ROWS	2000
+
+/* Number of nodes whose counters are checked per step */
+#define DB_MAINTENANCE_STEP_NODES	20
+
+/* Number of free pages released per incremental vacuum step */
+#define DB_MAINTENANCE_VACUUM_PAGES	256
+
+typedef struct dbMaintenanceTask {
+	const gchar	*description;	/**< the rows removed, for debug output */
+	const gchar	*table;		/**< the table to sweep */
+	const gchar	*condition;	/**< condition of the rows to remove */
+	const gboolean	*enabled;	/**< optional flag the task depends on */
+} dbMaintenanceTask;
+
+static const dbMaintenanceTask maintenanceTasks[] = {
+	/* Note: do not check on subscriptions here, as non-subscription node
+	   types (e.g. news bin) do contain items too. */
+	{ "items without a feed list node", "items",
+	  "comment = 0 AND node_id IS NOT NULL AND NOT EXISTS (SELECT 1 FROM node WHERE node.node_id = items.node_id)", NULL },
+	{ "comments without parent item", "items",
+	  "comment = 1 AND parent_item_id IS NOT NULL AND NOT EXISTS (SELECT 1 FROM items AS parent WHERE parent.item_id = items.parent_item_id AND parent.comment = 0)", NULL },
+	{ "search folder items without a feed list node", "search_folder_items",
+	  "parent_node_id IS NOT NULL AND NOT EXISTS (SELECT 1 FROM node WHERE node.node_id = search_folder_items.parent_node_id)", NULL },
+	{ "search folder items without a search folder", "search_folder_items",
+	  "node_id IS NOT NULL AND NOT EXISTS (SELECT 1 FROM node WHERE node.node_id = search_folder_items.node_id)", NULL },
+	{ "subscription metadata without node", "subscription_metadata",
+	  "node_id IS NOT NULL AND NOT EXISTS (SELECT 1 FROM node WHERE node.node_id = subscription_metadata.node_id)", NULL },
+	{ "metadata without item", "metadata",
+	  "item_id IS NOT NULL AND NOT EXISTS (SELECT 1 FROM items WHERE items.item_id = metadata.item_id)", NULL },
+	{ "counters without node", "node_counters",
+	  "node_id IS NOT NULL AND NOT EXISTS (SELECT 1 FROM node WHERE node.node_id = node_counters.node_id)", NULL },
+	{ "search index entries without item", "items_fts",
+	  "NOT EXISTS (SELECT 1 FROM items WHERE items.item_id = items_fts.rowid)", &searchIndex }
+};
+
+/* the steps following the cleanup tasks */
+#define DB_MAINTENANCE_COUNTERS	((gint64)G_N_ELEMENTS (maintenanceTasks))
+#define DB_MAINTENANCE_VACUUM	(DB_MAINTENANCE_COUNTERS + 1)
+#define DB_MAINTENANCE_DONE	(DB_MAINTENANCE_COUNTERS + 2)
+
+/** number of rows removed or repaired by the current task */
+static gint64 maintenanceChanges = 0;
+
+static void
+db_maintenance_save (gint64 task, gint64 cursor)
+{
+	db_info_set_int64 ("maintenanceTask", task);
+	db_info_set_int64 ("maintenanceCursor", cursor);
+}
+
+/* Checks the next range of rows of the task's table,
+   returns FALSE if the whole table was checked */
+static gboolean
+db_maintenance_cleanup_step (const dbMaintenanceTask *task, gint64 *cursor)
+{
+	sqlite3_stmt	*stmt;
+	gchar		*sql;
+	gint64		upper = 0;
+	gboolean	found = FALSE;
+
+	sql = g_strdup_printf ("SELECT MAX(id) FROM (SELECT rowid AS id FROM %s WHERE rowid > ? ORDER BY rowid LIMIT %d)",
+	                       task->table, DB_MAINTENANCE_STEP_ROWS);
+	db_prepare_stmt (&stmt, sql);
+	sqlite3_bind_int64 (stmt, 1, *cursor);
+	if (SQLITE_ROW == sqlite3_step (stmt) && SQLITE_NULL != sqlite3_column_type (stmt, 0)) {
+		upper = sqlite3_column_int64 (stmt, 0);
+		found = TRUE;
+	}
+	sqlite3_finalize (stmt);
+	g_free (sql);
+
+	if (!found)
+		return FALSE;
+
+	sql = g_strdup_printf ("DELETE FROM %s WHERE rowid > ? AND rowid <= ? AND %s", task->table, task->condition);
+	db_prepare_stmt (&stmt, sql);
+	sqlite3_bind_int64 (stmt, 1, *cursor);
+	sqlite3_bind_int64 (stmt, 2, upper);
+	if (SQLITE_DONE == sqlite3_step (stmt))
+		maintenanceChanges += sqlite3_changes (db);
+	else
+		g_warning ("Removing %s failed (%s)", task->description, sqlite3_errmsg (db));
+	sqlite3_finalize (stmt);
+	g_free (sql);
+
+	*cursor = upper;
+
+	return TRUE;
+}
+
+/* Compares the counters of the next nodes with the item tables and
+   repairs them, returns FALSE if all nodes were checked. Unlike
+   db_node_counters_check() this uses the per node indices only. */
+static gboolean
+db_maintenance_counters_step (gint64 *cursor, gboolean *changed)
+{
+	sqlite3_stmt	*stmt, *repairStmt;
+	gboolean	found = FALSE;
+
+	db_prepare_stmt (&stmt, "SELECT node.rowid, node.node_id, "
+	                        "(SELECT COUNT(*) FROM items WHERE items.node_id = node.node_id) + "
+	                        "(SELECT COUNT(*) FROM search_folder_items WHERE search_folder_items.node_id = node.node_id), "
+	                        "(SELECT COUNT(*) FROM items WHERE items.node_id = node.node_id AND items.read = 0) + "
+	                        "(SELECT COUNT(*) FROM search_folder_items INNER JOIN items ON search_folder_items.item_id = items.item_id "
+	                        " WHERE search_folder_items.node_id = node.node_id AND items.read = 0), "
+	                        "IFNULL(node_counters.item_count, 0), IFNULL(node_counters.unread_count, 0) "
+	                        "FROM node LEFT JOIN node_counters ON node_counters.node_id = node.node_id "
+	                        "WHERE node.rowid > ? ORDER BY node.rowid LIMIT " G_STRINGIFY (DB_MAINTENANCE_STEP_NODES));
+	db_prepare_stmt (&repairStmt, "REPLACE INTO node_counters (node_id, item_count, unread_count) VALUES (?,?,?)");
+
+	sqlite3_bind_int64 (stmt, 1, *cursor);
+	while (SQLITE_ROW == sqlite3_step (stmt)) {
+		*cursor = sqlite3_column_int64 (stmt, 0);
+		found = TRUE;
+
+		if (sqlite3_column_int (stmt, 2) == sqlite3_column_int (stmt, 4) &&
+		    sqlite3_column_int (stmt, 3) == sqlite3_column_int (stmt, 5))
+			continue;
+
+		debug5 (DEBUG_DB, "DB maintenance: counters of %s are %d/%d instead of %d/%d",
+		        sqlite3_column_text (stmt, 1),
+		        sqlite3_column_int (stmt, 4), sqlite3_column_int (stmt, 5),
+		        sqlite3_column_int (stmt, 2), sqlite3_column_int (stmt, 3));
+
+		sqlite3_bind_text (repairStmt, 1, (const gchar *)sqlite3_column_text (stmt, 1), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int (repairStmt, 2, sqlite3_column_int (stmt, 2));
+		sqlite3_bind_int (repairStmt, 3, sqlite3_column_int (stmt, 3));
+		if (SQLITE_DONE == sqlite3_step (repairStmt)) {
+			maintenanceChanges++;
+			*changed = TRUE;
+		} else {
+			g_warning ("Repairing item counters failed (%s)", sqlite3_errmsg (db));
+		}
+		sqlite3_reset (repairStmt);
+	}
+
+	sqlite3_finalize (repairStmt);
 	sqlite3_finalize (stmt);
+
+	return found;
+}
+
+/* Releases free pages, returns FALSE if there is nothing left to do.
+   DB files created before incremental vacuuming are converted on
+   shutdown once they are fragmented enough, see db_deinit(). */
+static gboolean
+db_maintenance_vacuum_step (void)
+{
+	if (2 != db_query_int ("PRAGMA auto_vacuum"))
+		return FALSE;
+
+	if (0 == db_query_int ("PRAGMA freelist_count"))
+		return FALSE;
+
+	db_exec ("PRAGMA incremental_vacuum(" G_STRINGIFY (DB_MAINTENANCE_VACUUM_PAGES) ")");
+
+	return TRUE;
+}
+
+gboolean
+db_maintenance_run (gint64 deadline, gboolean *countersChanged)
+{
+	gint64		task, cursor = 0;
+	gboolean	more;
+
+	*countersChanged = FALSE;
+
+	/* Building the search index has priority over the cleanup */
+	while (searchIndex && searchIndexCursor >= 0 && g_get_monotonic_time () < deadline) {
+		db_begin_transaction ();
+		db_search_index_build_step ();
+		db_end_transaction ();
+	}
+	if (searchIndex && searchIndexCursor >= 0)
+		return TRUE;
+
+	task = db_info_get_int64 ("maintenanceTask", -1);
+	if (task < 0 || task >= DB_MAINTENANCE_DONE) {
+		if (g_get_real_time () / G_USEC_PER_SEC - db_info_get_int64 ("maintenanceLastCycle", 0) < DB_MAINTENANCE_INTERVAL)
+			return FALSE;
+
+		debug0 (DEBUG_DB, "DB maintenance: starting new cycle");
+		task = 0;
+		maintenanceChanges = 0;
+	} else {
+		cursor = db_info_get_int64 ("maintenanceCursor", 0);
+	}
+
+	while (task < DB_MAINTENANCE_DONE && g_get_monotonic_time () < deadline) {
+		more = FALSE;
+
+		if (task < DB_MAINTENANCE_COUNTERS) {
+			const dbMaintenanceTask *t = &maintenanceTasks[task];
+
+			/* removing rows and saving the progress is atomic */
+			db_begin_transaction ();
+			if (!t->enabled || *(t->enabled))
+				more = db_maintenance_cleanup_step (t, &cursor);
+			db_maintenance_save (more?task:task + 1, more?cursor:0);
+			db_end_transaction ();
+
+			if (!more) {
+				debug2 (DEBUG_DB, "DB maintenance: removed %" G_GINT64_FORMAT " %s", maintenanceChanges, t->description);
+				maintenanceChanges = 0;
+			}
+		} else if (DB_MAINTENANCE_COUNTERS == task) {
+			/* The cleanup runs with the counter triggers,
+			   so this is just a safety net */
+			db_begin_transaction ();
+			more = db_maintenance_counters_step (&cursor, countersChanged);
+			db_maintenance_save (more?task:task + 1, more?cursor:0);
+			db_end_transaction ();
+
+			if (!more) {
+				debug1 (DEBUG_DB, "DB maintenance: repaired %" G_GINT64_FORMAT " item counters", maintenanceChanges);
+				maintenanceChanges = 0;
+			}
+		} else if (DB_MAINTENANCE_VACUUM == task) {
+			more = db_maintenance_vacuum_step ();
+			if (!more) {
+				db_maintenance_save (-1, 0);
+				db_info_set_int64 ("maintenanceLastCycle", g_get_real_time () / G_USEC_PER_SEC);
+				debug0 (DEBUG_DB, "DB maintenance: cycle finished");
+			}
+		}
+
+		if (!more) {
+			task++;
+			cursor = 0;
+		}
+	}
+
+	return task < DB_MAINTENANCE_DONE;
+}
+
+/* Read-only connections
+
+   Worker threads must not use the main connection or the statement
+   cache above. Instead each worker gets its own read-only connection
+   with privately prepared statements. As the DB is in WAL mode readers
+   do not block the main connection and see all committed changes. */
+
+struct dbReader {
+	sqlite3		*db;			/**< the read-only connection */
+	sqlite3_stmt	*itemLoadManyStmt;	/**< prepared DB_ITEM_LOAD_MANY_SQL */
+	sqlite3_stmt	*metadataLoadManyStmt;	/**< prepared DB_METADATA_LOAD_MANY_SQL */
+	sqlite3_stmt	*selectStmt;		/**< item id selection of the last db_reader_itemset_get() */
+	gchar		*selectSql;		/**< SQL of selectStmt */
+};
+
+static sqlite3_stmt *
+db_reader_prepare (dbReaderPtr reader, const gchar *sql)
+{
+	sqlite3_stmt	*stmt = NULL;
+	gint		res;
+
+	res = sqlite3_prepare_v2 (reader->db, sql, -1, &stmt, NULL);
+	if (SQLITE_OK != res)
+		g_warning ("Failure while preparing reader statement, (error=%d, %s) SQL: \"%s\"", res, sqlite3_errmsg (reader->db), sql);
+
+	return stmt;
+}
+
+dbReaderPtr
+db_reader_new (void)
+{
+	dbReaderPtr	reader;
+	gchar		*filename, *sql;
+	gint		res;
+
+	reader = g_new0 (struct dbReader, 1);
+
+	filename = common_create_data_filename ("liferea.db");
+	res = sqlite3_open_v2 (filename, &reader->db, SQLITE_OPEN_READONLY, NULL);
+	g_free (filename);
+	if (SQLITE_OK != res) {
+		g_warning ("Could not open read-only DB connection (error code %d: %s)!", res, sqlite3_errmsg (reader->db));
+		db_reader_free (reader);
+		return NULL;
+	}
+
+	sqlite3_extended_result_codes (reader->db, TRUE);
+	sqlite3_busy_timeout (reader->db, 1000);
+	db_register_functions (reader->db);
+
+	sql = db_id_batch_sql (DB_ITEM_LOAD_MANY_SQL);
+	reader->itemLoadManyStmt = db_reader_prepare (reader, sql);
+	g_free (sql);
+
+	sql = db_id_batch_sql (DB_METADATA_LOAD_MANY_SQL);
+	reader->metadataLoadManyStmt = db_reader_prepare (reader, sql);
+	g_free (sql);
+
+	if (!reader->itemLoadManyStmt || !reader->metadataLoadManyStmt) {
+		db_reader_free (reader);
+		return NULL;
+	}
+
+	return reader;
+}
+
+void
+db_reader_free (dbReaderPtr reader)
+{
+	if (!reader)
+		return;
+
+	sqlite3_finalize (reader->itemLoadManyStmt);
+	sqlite3_finalize (reader->metadataLoadManyStmt);
+	sqlite3_finalize (reader->selectStmt);
+	sqlite3_close (reader->db);
+	g_free (reader->selectSql);
+	g_free (reader);
+}
+
+gboolean
+db_reader_itemset_get (dbReaderPtr reader, itemSetPtr itemSet, const gchar *condition, GSList *params, dbItemCursor *cursor, guint limit)
+{
+	gboolean	success = FALSE;
+	gchar		*sql;
+	gint		i = 2;
+
+	debug2 (DEBUG_DB, "reader: loading %d items after item id %lu", limit, *cursor);
+
+	/* The loaders run the same selection over and over again, so
+	   keep the statement until the condition changes */
+	sql = g_strdup_printf ("SELECT items.item_id FROM items "
+	                       "WHERE items.comment = 0 AND items.item_id > ? AND (%s) "
+	                       "ORDER BY items.item_id LIMIT ?",
+	                       condition?condition:"1");
+	if (!reader->selectSql || !g_str_equal (sql, reader->selectSql)) {
+		sqlite3_finalize (reader->selectStmt);
+		g_free (reader->selectSql);
+		reader->selectStmt = db_reader_prepare (reader, sql);
+		reader->selectSql = sql;
+	} else {
+		g_free (sql);
+	}
+
+	if (!reader->selectStmt)
+		return FALSE;
+
+	sqlite3_reset (reader->selectStmt);
+	sqlite3_clear_bindings (reader->selectStmt);
+	sqlite3_bind_int64 (reader->selectStmt, 1, *cursor);
+	for (; params; params = g_slist_next (params))
+		sqlite3_bind_text (reader->selectStmt, i++, (const gchar *)params->data, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int (reader->selectStmt, i, limit);
+
+	while (sqlite3_step (reader->selectStmt) == SQLITE_ROW) {
+		*cursor = sqlite3_column_int (reader->selectStmt, 0);
+		itemSet->ids = g_list_prepend (itemSet->ids, GUINT_TO_POINTER (*cursor));
+		success = TRUE;
+	}
+	itemSet->ids = g_list_reverse (itemSet->ids);
+
+	sqlite3_reset (reader->selectStmt);
+
+	return success;
+}
+
+GList *
+db_reader_items_load_many (dbReaderPtr reader, const gulong *ids, guint count)
+{
+	GHashTable	*loaded;
+	GList		*items;
+	guint		offset;
+
+	debug1 (DEBUG_DB, "reader: loading %u items", count);
+
+	loaded = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (offset = 0; offset < count; offset += DB_ID_BATCH_SIZE) {
+		sqlite3_reset (reader->itemLoadManyStmt);
+		sqlite3_clear_bindings (reader->itemLoadManyStmt);
+		sqlite3_reset (reader->metadataLoadManyStmt);
+		sqlite3_clear_bindings (reader->metadataLoadManyStmt);
+
+		db_items_load_batch (reader->itemLoadManyStmt, reader->metadataLoadManyStmt,
+		                     &ids[offset], MIN (DB_ID_BATCH_SIZE, count - offset), loaded);
+	}
+
+	/* do not keep read transactions open between batches */
+	sqlite3_reset (reader->itemLoadManyStmt);
+	sqlite3_reset (reader->metadataLoadManyStmt);
+
+	items = db_items_sort_loaded (ids, count, loaded);
+	g_hash_table_destroy (loaded);
+
+	return items;
 }
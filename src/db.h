@@ -65,36 +65,78 @@ void	db_itemset_remove_all (const gchar *id);
 void	db_itemset_mark_all_popup (const gchar *id);
 
 /**
- * Returns the number of unread items for the given item set.
+ * Returns the number of items and unread items of the given
+ * feed list node (item set or search folder). The counters are
+ * maintained by DB triggers, so this is a single row lookup.
  *
- * @param id	the node id
+ * @param id		the node id
+ * @param itemCount	returns the number of items
+ * @param unreadCount	returns the number of unread items
+ */
+void	db_node_get_counters (const gchar *id, guint *itemCount, guint *unreadCount);
+
+/**
+ * Checks the materialized node counters against the item and
+ * search folder tables and rebuilds them if they differ.
  *
- * @returns the number of unread items
+ * @returns TRUE if the counters were up-to-date
  */
-guint	db_itemset_get_unread_count (const gchar *id);
+gboolean db_node_counters_check (void);
 
 /**
- * Returns the number of items for the given item set.
+ * Runs deferred DB maintenance (building the search index, removal
+ * of orphaned rows, counter checks and vacuuming) for a limited time. To be called repeatedly
+ * during idle times as long as it returns TRUE. Progress is kept in
+ * the DB, so maintenance continues after a restart. A new maintenance
+ * cycle is started once a day.
  *
- * @param id	the node id
+ * @param deadline		monotonic time (in µs) to stop working at
+ * @param countersChanged	returns TRUE if the node counters were rebuilt
  *
- * @returns the number of items
+ * @returns TRUE if there is more work to do
  */
-guint   db_itemset_get_item_count (const gchar *id);
+gboolean db_maintenance_run (gint64 deadline, gboolean *countersChanged);
 
 /**
- * Returns a batch of items starting with the given
- * offset and no more than the given limit.
+ * Returns TRUE if the full text search index of item titles,
+ * descriptions and categories (table "items_fts") is available.
+ * The index is optional and can be disabled with the "search-index"
+ * setting. It is not available while it is being built.
+ *
+ * @returns TRUE if the search index can be used
+ */
+gboolean db_search_index_available (void);
+
+/**
+ * Drops the full text search index contents and starts rebuilding
+ * it from the items table in the background (see db_maintenance_run()).
+ * Does nothing if the index is disabled.
+ */
+void	db_search_index_rebuild (void);
+
+/**
+ * Continuation token for batched item loading. To be treated as
+ * opaque, initialize with DB_ITEM_CURSOR_START before the first
+ * fetch. Each fetch advances the cursor behind the returned items.
+ */
+typedef gulong dbItemCursor;
+
+#define DB_ITEM_CURSOR_START	0
+
+/**
+ * Returns the next batch of items after the given cursor
+ * position and no more than the given limit. Items are
+ * returned in item id order.
  *
  * To be used for batched item loading (search folder loaders)
  *
  * @param itemSet       an itemset to add the items to
- * @param offset        the current offset
+ * @param cursor        the continuation token (will be advanced)
  * @param limit         maximum number of items to fetch
  *
  * @returns FALSE if no more items to fetch
  */
-gboolean        db_itemset_get (itemSetPtr itemSet, gulong offset, guint limit);
+gboolean        db_itemset_get (itemSetPtr itemSet, dbItemCursor *cursor, guint limit);
 
 /* item access (note: items are identified by the numeric item id) */
 
@@ -107,6 +149,31 @@ gboolean        db_itemset_get (itemSetPtr itemSet, gulong offset, guint limit);
  */
 itemPtr	db_item_load(gulong id);
 
+/**
+ * Loads all items with the given ids from the DB using
+ * a few set based queries instead of one query per item.
+ * Ids that do not exist are skipped.
+ *
+ * @param ids		array of item ids
+ * @param count		number of ids in the array
+ *
+ * @returns list of new item structures in the order of the given
+ *          ids, each must be free'd using item_unload()
+ */
+GList *	db_items_load_many (const gulong *ids, guint count);
+
+/**
+ * Loads the merge headers of all items with the given ids.
+ * Does not read item descriptions or metadata.
+ *
+ * @param ids		array of item ids
+ * @param count		number of ids in the array
+ *
+ * @returns list of new item headers in the order of the given
+ *          ids, each must be free'd using item_header_free()
+ */
+GList * db_item_headers_load_many (const gulong *ids, guint count);
+
 /**
  * Updates all attributes of the item in the DB
  *
@@ -114,6 +181,18 @@ itemPtr	db_item_load(gulong id);
  */
 void	db_item_update(itemPtr item);
 
+/**
+ * Starts a merge session. All DB writes until db_merge_session_end()
+ * are done in a single transaction to commit all items of a feed
+ * update at once. Sessions must not be nested.
+ */
+void	db_merge_session_begin (void);
+
+/**
+ * Commits all writes of the current merge session.
+ */
+void	db_merge_session_end (void);
+
 /**
  * Removes the given item from the DB
  *
@@ -137,6 +216,29 @@ void    db_item_state_update (itemPtr item);
  */
 GSList * db_item_get_duplicates(const gchar *guid);
 
+/**
+ * Counts the items for each of the given GUIDs using
+ * set based queries instead of one query per GUID.
+ *
+ * @param guid	list of item GUIDs
+ *
+ * @returns a hash of GUID -> number of items (GUINT_TO_POINTER),
+ *          GUIDs without items are not included
+ */
+GHashTable * db_items_count_duplicates (GSList *guids);
+
+/**
+ * Resolves many GUIDs of items in the given node at once
+ * using set based queries instead of one query per GUID.
+ *
+ * @param nodeId	the node id
+ * @param sourceIds	list of item GUIDs
+ *
+ * @returns a hash of GUID -> item id (GUINT_TO_POINTER),
+ *          GUIDs without items are not included
+ */
+GHashTable * db_items_find_by_source_ids (const gchar *nodeId, GSList *sourceIds);
+
 /**
  * Returns a list of node ids containing an item with the given GUID.
  *
@@ -171,22 +273,43 @@ void    db_search_folder_reset (const gchar *id);
 void    db_search_folder_add_items (const gchar *id, GSList *items);
 
 /**
- * Returns the number of items for the given search folder.
+ * Adds the items with the given ids to a search folder if they
+ * still match the given SQL condition.
  *
- * @param id	the node id
+ * @param id		the search folder id
+ * @param ids		array of item ids
+ * @param count		number of ids in the array
+ * @param condition	SQL condition on the "items" table
+ *			(see itemset_rules_to_sql())
+ * @param params	values for the placeholders of the condition
+ */
+void    db_search_folder_add_ids (const gchar *id, const gulong *ids, guint count, const gchar *condition, GSList *params);
+
+/**
+ * Adds all items matching the given SQL condition to a search
+ * folder using a single statement.
  *
- * @returns the number of items
+ * @param id		the search folder id
+ * @param condition	SQL condition on the "items" table
+ *			(see itemset_rules_to_sql())
+ * @param params	values for the placeholders of the condition
+ *
+ * @returns FALSE on errors
  */
-guint   db_search_folder_get_item_count (const gchar *id);
+gboolean db_search_folder_add_matching (const gchar *id, const gchar *condition, GSList *params);
 
 /**
- * Returns the number of items for the given search folder.
+ * Returns the next batch of item ids of the search folder given by
+ * itemSet->nodeId after the given cursor position and no more than
+ * the given limit.
  *
- * @param id	the node id
+ * @param itemSet       an itemset to add the items to
+ * @param cursor        the continuation token (will be advanced)
+ * @param limit         maximum number of items to fetch
  *
- * @returns the number of items
+ * @returns FALSE if no more items to fetch
  */
-guint   db_search_folder_get_unread_count (const gchar *id);
+gboolean db_search_folder_get (itemSetPtr itemSet, dbItemCursor *cursor, guint limit);
 
 /**
  * Load the metadata and update state of the given subscription.
@@ -195,6 +318,21 @@ guint   db_search_folder_get_unread_count (const gchar *id);
  */
 void db_subscription_load (subscriptionPtr subscription);
 
+/**
+ * Loads the metadata of all subscriptions and the counters of all
+ * nodes with one scan each. Until db_startup_preload_end() is called
+ * db_subscription_load() and db_node_get_counters() are served from
+ * memory instead of querying the DB for each node. To be used while
+ * initializing the feed list only, as the preloaded data is not
+ * updated by DB changes.
+ */
+void db_startup_preload_begin (void);
+
+/**
+ * Drops the data preloaded by db_startup_preload_begin().
+ */
+void db_startup_preload_end (void);
+
 /**
  * Updates (or inserts) the properties of the given subscription in the DB.
  *
@@ -225,4 +363,52 @@ void db_node_update (nodePtr node);
  */
 void db_node_cleanup (nodePtr root);
 
+/* read-only connections for worker threads */
+
+typedef struct dbReader *dbReaderPtr;
+
+/**
+ * Opens an additional read-only connection to the DB. A reader may
+ * be used from any thread but only by one thread at a time, and only
+ * with the db_reader_*() functions.
+ *
+ * @returns a new reader (or NULL on errors)
+ */
+dbReaderPtr db_reader_new (void);
+
+/**
+ * Closes the given reader connection.
+ *
+ * @param reader	the reader (or NULL)
+ */
+void db_reader_free (dbReaderPtr reader);
+
+/**
+ * Returns the next batch of items matching the given SQL condition
+ * after the given cursor position and no more than the given limit.
+ * Items are returned in item id order.
+ *
+ * @param reader	the reader connection
+ * @param itemSet	an itemset to add the items to
+ * @param condition	SQL condition on the "items" table (or NULL for all items)
+ * @param params	values for the placeholders of the condition
+ * @param cursor	the continuation token (will be advanced)
+ * @param limit		maximum number of items to fetch
+ *
+ * @returns FALSE if no more items to fetch
+ */
+gboolean db_reader_itemset_get (dbReaderPtr reader, itemSetPtr itemSet, const gchar *condition, GSList *params, dbItemCursor *cursor, guint limit);
+
+/**
+ * Same as db_items_load_many() but using the given reader connection.
+ *
+ * @param reader	the reader connection
+ * @param ids		array of item ids
+ * @param count		number of ids in the array
+ *
+ * @returns list of new item structures in the order of the given
+ *          ids, each must be free'd using item_unload()
+ */
+GList * db_reader_items_load_many (dbReaderPtr reader, const gulong *ids, guint count);
+
 #endif
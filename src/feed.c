@@ -28,6 +28,7 @@
 #include "db.h"
 #include "debug.h"
 #include "favicon.h"
+#include "feed_pipeline.h"
 #include "feedlist.h"
 #include "html.h"
 #include "itemlist.h"
@@ -301,20 +302,14 @@ feed_enrich_item (subscriptionPtr subscription, itemPtr item)
 	update_execute_request (subscription, request, feed_enrich_item_cb, GUINT_TO_POINTER (item->id), FEED_REQ_NO_FEED);
 }
 
-/* implementation of subscription type interface */
-
+/* merges the result of feed_parse_data(), also used as pipeline merge stage */
 static void
-feed_process_update_result (subscriptionPtr subscription, const struct updateResult * const result, updateFlags flags)
+feed_process_parse_result (subscriptionPtr subscription, feedParserCtxtPtr ctxt, gboolean success, updateFlags flags)
 {
-	feedParserCtxtPtr	ctxt;
 	nodePtr			node = subscription->node;
 
-	debug_enter ("feed_process_update_result");
-
-	ctxt = feed_parser_ctxt_new (subscription, result->data, result->size);
-
-	/* try to parse the feed */
-	if (!feed_parse (ctxt)) {
+	/* check the parsing result */
+	if (!feed_parse_finish (ctxt, success)) {
 		/* No feed found, display an error */
 		node->available = FALSE;
 
@@ -333,6 +328,10 @@ feed_process_update_result (subscriptionPtr subscription, const struct updateRes
 		node->newCount = itemset_merge_items (itemSet, ctxt->items, ctxt->feed->valid, ctxt->feed->markAsRead);
 		if (node->newCount)
 			itemlist_merge_itemset (itemSet);
+
+		/* remember the publishing rate for adaptive updating */
+		subscription->updateState->newestItemTime = itemSet->newestItemTime;
+		subscription->updateState->publishPeriod = itemSet->publishPeriod;
 		itemset_free (itemSet);
 
 		/* restore user defined properties if necessary */
@@ -344,15 +343,35 @@ feed_process_update_result (subscriptionPtr subscription, const struct updateRes
 			db_subscription_update (subscription);
 	}
 
-	feed_parser_ctxt_free (ctxt);
-
 	// FIXME: this should not be here, but in subscription.c
 	if (FETCH_ERROR_NONE != subscription->error)
 		node->available = FALSE;
+}
+
+/* implementation of subscription type interface */
+
+static void
+feed_process_update_result (subscriptionPtr subscription, const struct updateResult * const result, updateFlags flags)
+{
+	feedParserCtxtPtr	ctxt;
+
+	debug_enter ("feed_process_update_result");
+
+	ctxt = feed_parser_ctxt_new (subscription, result->data, result->size);
+	ctxt->contentType = result->contentType;
+	feed_process_parse_result (subscription, ctxt, feed_parse_data (ctxt), flags);
+	feed_parser_ctxt_free (ctxt);
 
 	debug_exit ("feed_process_update_result");
 }
 
+static void
+feed_process_update_result_async (subscriptionPtr subscription, const struct updateResult * const result, updateFlags flags)
+{
+	/* parse on a worker thread, merge in feed_process_parse_result() */
+	feed_pipeline_process (subscription, result, flags, feed_process_parse_result);
+}
+
 static gboolean
 feed_prepare_update_request (subscriptionPtr subscription, UpdateRequest *request)
 {
@@ -378,8 +397,7 @@ feed_save (nodePtr node)
 static void
 feed_update_counters (nodePtr node)
 {
-	node->itemCount = db_itemset_get_item_count (node->id);
-	node->unreadCount = db_itemset_get_unread_count (node->id);
+	db_node_get_counters (node->id, &node->itemCount, &node->unreadCount);
 }
 
 static void
@@ -448,7 +466,8 @@ feed_get_subscription_type (void)
 {
 	static struct subscriptionType sti = {
 		feed_prepare_update_request,
-		feed_process_update_result
+		feed_process_update_result,
+		feed_process_update_result_async
 	};
 
 	return &sti;
@@ -23,6 +23,7 @@
 #include "common.h"
 #include "debug.h"
 #include "html.h"
+#include "item.h"
 #include "metadata.h"
 #include "xml.h"
 #include "parsers/atom10.h"
@@ -31,9 +32,14 @@
 #include "parsers/rss_channel.h"
 
 #define AUTO_DISCOVERY_MAX_REDIRECTS	5
+#define FEED_SNIFF_LENGTH		4096	/**< number of bytes checked to guess the document type */
+#define FEED_STREAM_MIN_LENGTH		(1024*1024)	/**< minimum document size to try the streaming parsers */
 
 static GSList *feedHandlers = NULL;	/**< list of available parser implementations */
 
+static gint sniffCount = 0;		/**< number of documents parsed */
+static gint sniffFallbackCount = 0;	/**< number of documents parsed both as XML and HTML */
+
 struct feed_type {
 	gint id_num;
 	gchar *id_str;
@@ -42,15 +48,19 @@ struct feed_type {
 static GSList *
 feed_parsers_get_list (void)
 {
-	if (feedHandlers)
-		return feedHandlers;
+	static gsize initialized = 0;
+
+	/* might be called from parser worker threads first */
+	if (g_once_init_enter (&initialized)) {
+		feedHandlers = g_slist_append (feedHandlers, rss_init_feed_handler ());
+		feedHandlers = g_slist_append (feedHandlers, atom10_init_feed_handler ());
 
-	feedHandlers = g_slist_append (feedHandlers, rss_init_feed_handler ());
-	feedHandlers = g_slist_append (feedHandlers, atom10_init_feed_handler ());
+		/* Order is important ! */
+		feedHandlers = g_slist_append (feedHandlers, ldjson_init_feed_handler ());
+		feedHandlers = g_slist_append (feedHandlers, html5_init_feed_handler ());
 
-	/* Order is important ! */
-	feedHandlers = g_slist_append (feedHandlers, ldjson_init_feed_handler ());
-	feedHandlers = g_slist_append (feedHandlers, html5_init_feed_handler ());
+		g_once_init_leave (&initialized, 1);
+	}
 
 	return feedHandlers;
 }
@@ -102,6 +112,7 @@ feed_parser_ctxt_free (feedParserCtxtPtr ctxt)
 	if (ctxt) {
 		/* Don't free the itemset! */
 		g_hash_table_destroy (ctxt->tmpdata);
+		g_slist_free_full (ctxt->discoveredLinks, g_free);
 		g_free (ctxt->title);
 		g_free (ctxt);
 	}
@@ -117,13 +128,11 @@ static gboolean
 feed_parser_auto_discover (feedParserCtxtPtr ctxt)
 {
 	gchar	*source = NULL;
-	GSList	*links;
 
 	debug2 (DEBUG_UPDATE, "Starting feed auto discovery (%s) redirects=%d", subscription_get_source (ctxt->subscription), ctxt->subscription->autoDiscoveryTries);
 
-	links = html_auto_discover_feed (ctxt->data, subscription_get_source (ctxt->subscription));
-	if (links)
-		source = links->data;	// FIXME: let user choose feed!
+	if (ctxt->discoveredLinks)
+		source = ctxt->discoveredLinks->data;	// FIXME: let user choose feed!
 
 	/* FIXME: we only need the !g_str_equal as a workaround after a 404 */
 	if (source && !g_str_equal (source, subscription_get_source (ctxt->subscription))) {
@@ -134,7 +143,6 @@ feed_parser_auto_discover (feedParserCtxtPtr ctxt)
 		 * Cancel the update in case there's one in progress */
 		subscription_cancel_update (ctxt->subscription);
 		subscription_update (ctxt->subscription, FEED_REQ_RESET_TITLE);
-		g_free (source);
 
 		return TRUE;
 	}
@@ -158,89 +166,288 @@ feed_parser_ctxt_cleanup (feedParserCtxtPtr ctxt)
 	ctxt->subscription->metadata = NULL;
 }
 
-/**
- * General feed source parsing function. Parses the passed feed source
- * and tries to determine the source type. If all feed handlers fail
- * tries to do HTML5 feed extraction. If this also fails starts feed
- * link auto-discovery.
- *
- * @param ctxt		feed parsing context
- *
- * @returns FALSE if auto discovery is indicated,
- *          TRUE if feed type was recognized and parsing was successful
- */
-gboolean
-feed_parse (feedParserCtxtPtr ctxt)
+/* Guesses from the content type and the start of the document if
+   the data is to be parsed as HTML (TRUE) or as XML (FALSE). The root
+   element name decides, as servers often send wrong content types. */
+static gboolean
+feed_parser_sniff_html (feedParserCtxtPtr ctxt)
 {
-	xmlNodePtr	xmlNode = NULL, htmlNode = NULL;
-	xmlDocPtr	xmlDoc, htmlDoc;
-	gboolean	autoDiscovery = FALSE, success = FALSE;
+	const gchar	*cur = ctxt->data;
+	const gchar	*end = ctxt->data + MIN (ctxt->dataLength, FEED_SNIFF_LENGTH);
+	gboolean	html = FALSE;
 
-	debug_enter ("feed_parse");
+	if (ctxt->contentType)
+		html = (g_str_has_prefix (ctxt->contentType, "text/html") ||
+		        g_str_has_prefix (ctxt->contentType, "application/xhtml"));
 
-	g_assert (NULL == ctxt->items);
+	/* skip UTF-8 BOM */
+	if (end - cur >= 3 && 0 == memcmp (cur, "\xEF\xBB\xBF", 3))
+		cur += 3;
 
-	if (ctxt->feed->parseErrors)
-		g_string_truncate (ctxt->feed->parseErrors, 0);
-	else
-		ctxt->feed->parseErrors = g_string_new (NULL);
-
-	/* Prepare two documents, one parse as XML and one as XHTML.
-	   Depending on the feed parser being an HTML parser the one
-	   or the other is used. */
+	while (cur < end) {
+		const gchar	*name;
+		gsize		len;
 
-	/* 1.) try to parse downloaded data as XML */
-	do {
-		if (NULL == (xmlDoc = xml_parse_feed (ctxt))) {
-			ctxt->subscription->error = FETCH_ERROR_XML;
+		cur = memchr (cur, '<', end - cur);
+		if (!cur || ++cur >= end)
 			break;
-		}
 
-		if (NULL == (xmlNode = xmlDocGetRootElement (xmlDoc))) {
-			ctxt->subscription->error = FETCH_ERROR_XML;
-			g_string_append (ctxt->feed->parseErrors, _("Empty document!"));
-			break;
+		/* skip XML prolog and processing instructions */
+		if ('?' == *cur) {
+			cur = g_strstr_len (cur, end - cur, "?>");
+			if (!cur)
+				break;
+			continue;
 		}
 
-		while (xmlNode && xmlIsBlankNode (xmlNode)) {
-			xmlNode = xmlNode->next;
+		/* skip comments and DTD, but check for the HTML doctype */
+		if ('!' == *cur) {
+			if (end - cur > 8 && 0 == g_ascii_strncasecmp (cur, "!DOCTYPE", 8)) {
+				name = cur + 8;
+				while (name < end && g_ascii_isspace (*name))
+					name++;
+				if (end - name > 4 && 0 == g_ascii_strncasecmp (name, "html", 4) && !g_ascii_isalnum (name[4]))
+					return TRUE;
+			}
+			if (end - cur > 3 && 0 == strncmp (cur, "!--", 3))
+				cur = g_strstr_len (cur, end - cur, "-->");
+			else
+				cur = memchr (cur, '>', end - cur);
+			if (!cur)
+				break;
+			continue;
 		}
 
-		if (!xmlNode->name) {
-			g_string_append (ctxt->feed->parseErrors, _("Invalid XML!"));
-			break;
+		/* the root element: check its local name */
+		name = cur;
+		while (cur < end && (g_ascii_isalnum (*cur) || (*cur && strchr (":_-.", *cur)))) {
+			if (':' == *cur)
+				name = cur + 1;
+			cur++;
 		}
-	} while (0);
+		len = cur - name;
+		if (0 == len)
+			break;	/* e.g. UTF-16, let the content type decide */
 
-	/* 2.) Prepare data as XHTML */
-	do {
-		if (NULL == (htmlDoc = xhtml_parse (ctxt->data, ctxt->dataLength)))
-			break;
+		return (4 == len && 0 == g_ascii_strncasecmp (name, "html", 4));
+	}
 
-		if (NULL == (htmlNode = xmlDocGetRootElement (htmlDoc))) {
-			//g_string_append (ctxt->feed->parseErrors, _("Empty document!"));
-			break;
-		}
-	} while (0);
+	return html;
+}
+
+static xmlNodePtr
+feed_parser_parse_xml (feedParserCtxtPtr ctxt, xmlDocPtr *doc)
+{
+	xmlNodePtr	xmlNode;
 
-	/* determine the syndication format and start parser with either XML or XHTML doc */
-	GSList *handlerIter = feed_parsers_get_list ();
-	while (handlerIter) {
+	if (NULL == (*doc = xml_parse_feed (ctxt))) {
+		ctxt->subscription->error = FETCH_ERROR_XML;
+		return NULL;
+	}
+
+	if (NULL == (xmlNode = xmlDocGetRootElement (*doc))) {
+		ctxt->subscription->error = FETCH_ERROR_XML;
+		g_string_append (ctxt->feed->parseErrors, _("Empty document!"));
+		return NULL;
+	}
+
+	while (xmlNode && xmlIsBlankNode (xmlNode)) {
+		xmlNode = xmlNode->next;
+	}
+
+	if (!xmlNode->name) {
+		g_string_append (ctxt->feed->parseErrors, _("Invalid XML!"));
+		return NULL;
+	}
+
+	return xmlNode;
+}
+
+static xmlNodePtr
+feed_parser_parse_html (feedParserCtxtPtr ctxt, xmlDocPtr *doc)
+{
+	if (NULL == (*doc = xhtml_parse (ctxt->data, ctxt->dataLength)))
+		return NULL;
+
+	return xmlDocGetRootElement (*doc);
+}
+
+/* Runs the first XML or HTML feed handler accepting the document */
+static gboolean
+feed_parser_run_handler (feedParserCtxtPtr ctxt, xmlNodePtr node, gboolean html)
+{
+	GSList	*handlerIter;
+
+	if (!node)
+		return FALSE;
+
+	for (handlerIter = feed_parsers_get_list (); handlerIter; handlerIter = handlerIter->next) {
 		feedHandlerPtr handler = (feedHandlerPtr)(handlerIter->data);
-		xmlNodePtr node = handler->html?htmlNode:xmlNode;
 
-		if (node && handler && handler->checkFormat && (*(handler->checkFormat))(node->doc, node)) {
+		if (handler->html != html)
+			continue;
+
+		if (handler->checkFormat && (*(handler->checkFormat))(node->doc, node)) {
 			ctxt->feed->fhp = handler;
 			feed_parser_ctxt_cleanup (ctxt);
-			(*(handler->feedParser)) (ctxt, handler->html?htmlNode:xmlNode);
-			success = TRUE;
-			break;
+			(*(handler->feedParser)) (ctxt, node);
+			return TRUE;
 		}
-		handlerIter = handlerIter->next;
+	}
+
+	return FALSE;
+}
+
+/* Parses large XML documents with the streaming parser of a matching
+   feed handler, so that there is never a DOM of the whole document in
+   memory. Returns FALSE if no handler supports streaming or if the
+   document is malformed, the caller has to use the DOM parser then. */
+static gboolean
+feed_parser_parse_stream (feedParserCtxtPtr ctxt)
+{
+	struct errorCtxt	errors;
+	xmlTextReaderPtr	reader;
+	feedHandlerPtr		handler = NULL, oldHandler = ctxt->feed->fhp;
+	GSList			*handlerIter;
+	int			ret;
+
+	if (ctxt->dataLength < FEED_STREAM_MIN_LENGTH)
+		return FALSE;
+
+	errors.msg = ctxt->feed->parseErrors;
+	errors.errorCount = 0;
+
+	if (NULL == (reader = xml_reader_new (ctxt->data, ctxt->dataLength, &errors)))
+		return FALSE;
+
+	/* skip to the root element */
+	do {
+		ret = xmlTextReaderRead (reader);
+	} while (1 == ret && xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT);
+
+	if (1 == ret) {
+		for (handlerIter = feed_parsers_get_list (); handlerIter; handlerIter = handlerIter->next) {
+			feedHandlerPtr h = (feedHandlerPtr)(handlerIter->data);
+
+			if (h->html || !h->streamParser || !h->checkStreamFormat)
+				continue;
+
+			if ((*(h->checkStreamFormat)) (reader)) {
+				handler = h;
+				break;
+			}
+		}
+	}
+
+	if (handler) {
+		ctxt->feed->fhp = handler;
+		feed_parser_ctxt_cleanup (ctxt);
+		(*(handler->streamParser)) (ctxt, reader);
+
+		/* The handler may stop before the end of the document,
+		   so check the rest is well-formed too */
+		while (1 == (ret = xmlTextReaderNext (reader)))
+			;
+	}
+
+	xmlFreeTextReader (reader);
+
+	if (handler && 0 == ret) {
+		debug3 (DEBUG_PARSING, "stream parsed %s (%" G_GSIZE_FORMAT " bytes, %d items)",
+		        subscription_get_source (ctxt->subscription), ctxt->dataLength, g_list_length (ctxt->items));
+		ctxt->feed->valid = (0 == errors.errorCount);
+		return TRUE;
+	}
+
+	if (handler) {
+		/* Malformed feed (e.g. using HTML entities the reader can't
+		   resolve), drop everything and let the DOM parser retry */
+		debug1 (DEBUG_PARSING, "stream parsing %s failed, falling back to DOM parsing", subscription_get_source (ctxt->subscription));
+		g_list_free_full (ctxt->items, (GDestroyNotify)item_unload);
+		ctxt->items = NULL;
+		ctxt->item = NULL;
+		g_free (ctxt->title);
+		ctxt->title = NULL;
+		ctxt->feed->fhp = oldHandler;
+	}
+	g_string_truncate (ctxt->feed->parseErrors, 0);
+
+	return FALSE;
+}
+
+gboolean
+feed_parse_data (feedParserCtxtPtr ctxt)
+{
+	xmlNodePtr	node;
+	xmlDocPtr	doc = NULL, fallbackDoc = NULL;
+	gboolean	html, success = FALSE;
+
+	g_assert (NULL == ctxt->items);
+
+	if (ctxt->feed->parseErrors)
+		g_string_truncate (ctxt->feed->parseErrors, 0);
+	else
+		ctxt->feed->parseErrors = g_string_new (NULL);
+
+	/* 1.) Parse the data either as XML or as XHTML, depending on
+	       what the document looks like, and run the matching feed
+	       handlers for the document type */
+	html = feed_parser_sniff_html (ctxt);
+	if (!html && feed_parser_parse_stream (ctxt)) {
+		g_atomic_int_inc (&sniffCount);
+		return TRUE;
+	}
+
+	if (html) {
+		node = feed_parser_parse_html (ctxt, &doc);
+		ctxt->feed->valid = FALSE;	/* not validated by the XML parser */
+	} else {
+		node = feed_parser_parse_xml (ctxt, &doc);
+	}
+
+	success = feed_parser_run_handler (ctxt, node, html);
+	g_atomic_int_inc (&sniffCount);
+
+	/* 2.) Wrong guess or no feed at all, try the other document type */
+	if (!success) {
+		g_atomic_int_inc (&sniffFallbackCount);
+		debug3 (DEBUG_PARSING, "no %s feed handler matched for %s, trying %s parsing",
+		        html?"HTML":"XML", subscription_get_source (ctxt->subscription), html?"XML":"HTML");
+
+		if (html)
+			node = feed_parser_parse_xml (ctxt, &fallbackDoc);
+		else
+			node = feed_parser_parse_html (ctxt, &fallbackDoc);
+
+		success = feed_parser_run_handler (ctxt, node, !html);
 	}
 
 	/* 3.) None of the feed formats did work, chance is high that we are
 	       working on a HTML documents. Let's look for feed links inside it! */
+	if (!success && ctxt->subscription->autoDiscoveryTries < AUTO_DISCOVERY_MAX_REDIRECTS)
+		ctxt->discoveredLinks = html_auto_discover_feed (ctxt->data, subscription_get_source (ctxt->subscription));
+
+	if (fallbackDoc)
+		xmlFreeDoc (fallbackDoc);
+	if (doc)
+		xmlFreeDoc (doc);
+
+	return success;
+}
+
+void
+feed_parser_get_stats (guint *parsed, guint *fallbacks)
+{
+	*parsed = (guint)g_atomic_int_get (&sniffCount);
+	*fallbacks = (guint)g_atomic_int_get (&sniffFallbackCount);
+}
+
+gboolean
+feed_parse_finish (feedParserCtxtPtr ctxt, gboolean success)
+{
+	gboolean	autoDiscovery = FALSE;
+
+	/* 1.) Follow links found by auto discovery */
 	if (!success) {
 		ctxt->subscription->autoDiscoveryTries++;
 		if (ctxt->subscription->autoDiscoveryTries > AUTO_DISCOVERY_MAX_REDIRECTS) {
@@ -250,12 +457,7 @@ feed_parse (feedParserCtxtPtr ctxt)
 		}
 	}
 
-	if (htmlDoc)
-		xmlFreeDoc (htmlDoc);
-	if (xmlDoc)
-		xmlFreeDoc (xmlDoc);
-
-	/* 4.) Update subscription error status */
+	/* 2.) Update subscription error status */
 	if (!success && !autoDiscovery) {
 		/* Fuzzy test for HTML document */
 		if ((strstr (ctxt->data, "<html>") || strstr (ctxt->data, "<HTML>") ||
@@ -274,6 +476,29 @@ feed_parse (feedParserCtxtPtr ctxt)
 		ctxt->subscription->error = FETCH_ERROR_NONE;
 	}
 
+	return success;
+}
+
+/**
+ * General feed source parsing function. Parses the passed feed source
+ * and tries to determine the source type. If all feed handlers fail
+ * tries to do HTML5 feed extraction. If this also fails starts feed
+ * link auto-discovery.
+ *
+ * @param ctxt		feed parsing context
+ *
+ * @returns FALSE if auto discovery is indicated,
+ *          TRUE if feed type was recognized and parsing was successful
+ */
+gboolean
+feed_parse (feedParserCtxtPtr ctxt)
+{
+	gboolean	success;
+
+	debug_enter ("feed_parse");
+
+	success = feed_parse_finish (ctxt, feed_parse_data (ctxt));
+
 	debug_exit ("feed_parse");
 
 	return success;
@@ -22,6 +22,7 @@
 #define _FEED_PARSER_H
 
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 
 #include "feed.h"
 
@@ -35,9 +36,11 @@ typedef struct feedParserCtxt {
 	GHashTable	*tmpdata;		/**< tmp data hash used during stateful parsing */
 
 	gchar		*title;			/**< resulting feed/channel title */
+	GSList		*discoveredLinks;	/**< feed links found by auto discovery (if no format matched) */
 
 	const gchar	*data;			/**< data buffer to parse */
 	gsize		dataLength;		/**< length of the data buffer */
+	const gchar	*contentType;		/**< content type of the data (optional) */
 } *feedParserCtxtPtr;
 
 /**
@@ -58,12 +61,33 @@ typedef void 	(*feedParserFunc)	(feedParserCtxtPtr ctxt, xmlNodePtr cur);
  */
 typedef gboolean (*checkFormatFunc)	(xmlDocPtr doc, xmlNodePtr cur);
 
+/**
+ * Function type which parses the given feed data from an XML reader
+ * positioned on the root element.
+ *
+ * @param ctxt		feed parsing context
+ * @param reader	the XML reader
+ */
+typedef void	(*feedStreamParserFunc)	(feedParserCtxtPtr ctxt, xmlTextReaderPtr reader);
+
+/**
+ * Function type which checks the root element an XML reader is
+ * positioned on if it has the expected format.
+ *
+ * @param reader	the XML reader
+ *
+ * @return TRUE if the XML document has the correct format
+ */
+typedef gboolean (*checkStreamFormatFunc)	(xmlTextReaderPtr reader);
+
 /** feed handler interface */
 typedef struct feedHandler {
 	const gchar	*typeStr;		/**< string representation of the feed type */
 	feedParserFunc	feedParser;		/**< feed type parse function */
 	checkFormatFunc	checkFormat;		/**< Parser for the feed type*/
 	gboolean	html;			/**< TRUE if this is a HTML parser (as opposed tp XML feeds) */
+	feedStreamParserFunc	streamParser;		/**< streaming parse function for large feeds (optional) */
+	checkStreamFormatFunc	checkStreamFormat;	/**< format check for the streaming parser (optional) */
 } *feedHandlerPtr;
 
 /**
@@ -114,4 +138,40 @@ const gchar *feed_type_fhp_to_str (feedHandlerPtr fhp);
  */
 gboolean feed_parse (feedParserCtxtPtr ctxt);
 
+/**
+ * First half of feed_parse(). Parses the passed feed source and
+ * runs the matching feed handler. Only modifies the parsing context
+ * and its subscription and feed structures and does not run auto
+ * discovery, so it can be used on a worker thread when the context
+ * uses private copies of both structures.
+ *
+ * @param ctxt		feed parsing context
+ *
+ * @returns TRUE if feed type was recognized
+ */
+gboolean feed_parse_data (feedParserCtxtPtr ctxt);
+
+/**
+ * Second half of feed_parse(). Must be called in the main thread.
+ * Starts feed link auto discovery if feed_parse_data() failed and
+ * updates the subscription error status.
+ *
+ * @param ctxt		feed parsing context
+ * @param success	result of feed_parse_data()
+ *
+ * @returns FALSE if auto discovery is indicated,
+ *          TRUE if feed type was recognized
+ */
+gboolean feed_parse_finish (feedParserCtxtPtr ctxt, gboolean success);
+
+/**
+ * Query how often feed_parse_data() had to parse a document both
+ * as XML and as HTML because the guessed document type was wrong
+ * or no feed handler accepted the document.
+ *
+ * @param parsed	returns the number of parsed documents
+ * @param fallbacks	returns the number of documents parsed twice
+ */
+void feed_parser_get_stats (guint *parsed, guint *fallbacks);
+
 #endif
@@ -0,0 +1,344 @@
+/**
+ * @file feed_pipeline.c  staged feed update result processing
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "feed_pipeline.h"
+
+#include <string.h>
+
+#include "debug.h"
+#include "feed.h"
+#include "item.h"
+#include "metadata.h"
+#include "node.h"
+
+#define FEED_PIPELINE_MAX_WORKERS	4
+
+/** a downloaded feed passing the pipeline stages */
+typedef struct feedPipelineJob {
+	gchar			*nodeId;		/**< id of the subscription node */
+	subscriptionPtr		subscription;		/**< not to be used before the node was checked to still exist */
+	struct subscription	shadowSubscription;	/**< private subscription copy for the parser thread */
+	struct feed		shadowFeed;		/**< private feed copy for the parser thread */
+	feedParserCtxtPtr	ctxt;			/**< the feed parser context */
+	gchar			*data;			/**< copy of the downloaded data */
+	gchar			*contentType;		/**< copy of the content type */
+	updateFlags		flags;			/**< the update flags */
+	feedPipelineMergeFunc	merge;			/**< merge stage callback */
+	gboolean		success;		/**< result of feed_parse_data() */
+	gint64			queued;			/**< time the job entered the current stage queue */
+} *feedPipelineJobPtr;
+
+static GThreadPool	*parsePool = NULL;
+static GAsyncQueue	*parsedQueue = NULL;	/**< parsed jobs not yet passed to the merge stage */
+static GQueue		*mergeQueue = NULL;
+static guint		mergeSourceId = 0;
+static gint		shuttingDown = FALSE;	/**< if set the parser threads free jobs without parsing */
+
+/* statistics are updated by the parser threads too */
+static GMutex			statsLock;
+static feedPipelineStats	parseStats;
+static feedPipelineStats	mergeStats;
+
+static void
+feed_pipeline_job_free (feedPipelineJobPtr job)
+{
+	/* items not merged yet */
+	g_list_free_full (job->ctxt->items, (GDestroyNotify)item_unload);
+	job->ctxt->items = NULL;
+
+	feed_parser_ctxt_free (job->ctxt);
+	g_free (job->shadowSubscription.source);
+	update_state_free (job->shadowSubscription.updateState);
+	metadata_list_free (job->shadowSubscription.metadata);
+	if (job->shadowFeed.parseErrors)
+		g_string_free (job->shadowFeed.parseErrors, TRUE);
+	g_free (job->data);
+	g_free (job->contentType);
+	g_free (job->nodeId);
+	g_free (job);
+}
+
+static void
+feed_pipeline_stats_queue (feedPipelineStats *stats, feedPipelineJobPtr job)
+{
+	g_mutex_lock (&statsLock);
+	job->queued = g_get_monotonic_time ();
+	stats->queued++;
+	g_mutex_unlock (&statsLock);
+}
+
+static gint64
+feed_pipeline_stats_start (feedPipelineStats *stats, feedPipelineJobPtr job)
+{
+	gint64	now = g_get_monotonic_time ();
+
+	g_mutex_lock (&statsLock);
+	stats->queued--;
+	stats->active++;
+	stats->waitTime += (now - job->queued) / 1000;
+	g_mutex_unlock (&statsLock);
+
+	return now;
+}
+
+static void
+feed_pipeline_stats_finish (feedPipelineStats *stats, gint64 start)
+{
+	g_mutex_lock (&statsLock);
+	stats->active--;
+	stats->processed++;
+	stats->runTime += (g_get_monotonic_time () - start) / 1000;
+	g_mutex_unlock (&statsLock);
+}
+
+static void
+feed_pipeline_print_stage_stats (const gchar *name, feedPipelineStats *stats)
+{
+	debug6 (DEBUG_PERF, "%s stage: %u feeds processed, %u queued, wait time %" G_GINT64_FORMAT "ms avg, run time %" G_GINT64_FORMAT "ms avg (%" G_GINT64_FORMAT "ms total)",
+	        name,
+	        stats->processed,
+	        stats->queued,
+	        stats->processed?stats->waitTime / stats->processed:0,
+	        stats->processed?stats->runTime / stats->processed:0,
+	        stats->runTime);
+}
+
+void
+feed_pipeline_get_stats (feedPipelineStats *parse, feedPipelineStats *merge)
+{
+	g_mutex_lock (&statsLock);
+	*parse = parseStats;
+	*merge = mergeStats;
+	g_mutex_unlock (&statsLock);
+}
+
+/* Copies the results of the parser thread into the real subscription
+   and feed. Must be called in the main thread. */
+static void
+feed_pipeline_apply (feedPipelineJobPtr job)
+{
+	subscriptionPtr	subscription = job->subscription;
+	feedPtr		feed = (feedPtr)subscription->node->data;
+	GString		*tmp;
+
+	/* If a feed handler matched, the metadata was dropped and
+	   rebuilt by the parser, see feed_parser_ctxt_cleanup() */
+	if (job->success) {
+		metadata_list_free (subscription->metadata);
+		subscription->metadata = job->shadowSubscription.metadata;
+		job->shadowSubscription.metadata = NULL;
+		feed->fhp = job->shadowFeed.fhp;
+	}
+
+	subscription->error = job->shadowSubscription.error;
+	subscription->updateState->synPeriod = job->shadowSubscription.updateState->synPeriod;
+	subscription->updateState->synFrequency = job->shadowSubscription.updateState->synFrequency;
+	subscription->updateState->timeToLive = job->shadowSubscription.updateState->timeToLive;
+
+	feed->valid = job->shadowFeed.valid;
+	feed->time = job->shadowFeed.time;
+	tmp = feed->parseErrors;
+	feed->parseErrors = job->shadowFeed.parseErrors;
+	job->shadowFeed.parseErrors = tmp;
+
+	job->ctxt->subscription = subscription;
+	job->ctxt->feed = feed;
+}
+
+static gboolean
+feed_pipeline_merge_cb (gpointer user_data)
+{
+	feedPipelineJobPtr	job;
+	feedPipelineStats	parse, merge;
+	nodePtr			node;
+	gint64			start;
+	guint			queued, active, completed, parsed, fallbacks;
+
+	/* Merge only one feed per main loop iteration to keep the
+	   GUI responsive while many feeds are updated */
+	job = (feedPipelineJobPtr)g_queue_pop_head (mergeQueue);
+	if (job) {
+		start = feed_pipeline_stats_start (&mergeStats, job);
+
+		node = node_from_id (job->nodeId);
+		if (node && node->subscription == job->subscription) {
+			feed_pipeline_apply (job);
+			(*job->merge) (job->subscription, job->ctxt, job->success, job->flags);
+			job->ctxt->items = NULL;	/* owned by the merge callback */
+			subscription_update_processed (job->subscription, TRUE);
+		} else {
+			debug1 (DEBUG_UPDATE, "dropping parsed feed of removed node %s", job->nodeId);
+		}
+
+		feed_pipeline_stats_finish (&mergeStats, start);
+		feed_pipeline_job_free (job);
+	}
+
+	if (!g_queue_is_empty (mergeQueue))
+		return TRUE;
+
+	mergeSourceId = 0;
+
+	feed_pipeline_get_stats (&parse, &merge);
+	if (0 == parse.queued && 0 == parse.active) {
+		feed_pipeline_print_stage_stats ("parse", &parse);
+		feed_pipeline_print_stage_stats ("merge", &merge);
+
+		feed_parser_get_stats (&parsed, &fallbacks);
+		debug2 (DEBUG_PERF, "document type sniffing: %u documents parsed, %u parsed twice", parsed, fallbacks);
+
+		/* downloads might still be running */
+		update_jobs_get_stats (&queued, &active, &completed);
+		debug3 (DEBUG_PERF, "update jobs: %u queued, %u active, %u completed", queued, active, completed);
+	}
+
+	return FALSE;
+}
+
+/* Passes a parsed feed from the parser threads to the merge stage */
+static gboolean
+feed_pipeline_parsed_cb (gpointer user_data)
+{
+	feedPipelineJobPtr	job;
+
+	/* After shutdown the remaining jobs were freed by feed_pipeline_deinit() */
+	if (!parsedQueue)
+		return FALSE;
+
+	job = (feedPipelineJobPtr)g_async_queue_try_pop (parsedQueue);
+	if (!job)
+		return FALSE;
+
+	feed_pipeline_stats_queue (&mergeStats, job);
+	g_queue_push_tail (mergeQueue, job);
+
+	if (!mergeSourceId)
+		mergeSourceId = g_idle_add (feed_pipeline_merge_cb, NULL);
+
+	return FALSE;
+}
+
+static void
+feed_pipeline_parse_func (gpointer data, gpointer user_data)
+{
+	feedPipelineJobPtr	job = (feedPipelineJobPtr)data;
+	gint64			start;
+
+	start = feed_pipeline_stats_start (&parseStats, job);
+	if (g_atomic_int_get (&shuttingDown)) {
+		feed_pipeline_stats_finish (&parseStats, start);
+		feed_pipeline_job_free (job);
+		return;
+	}
+
+	job->success = feed_parse_data (job->ctxt);
+	feed_pipeline_stats_finish (&parseStats, start);
+
+	debug3 (DEBUG_UPDATE, "parsed %s (%d items) in %" G_GINT64_FORMAT "ms", job->shadowSubscription.source, g_list_length (job->ctxt->items), (g_get_monotonic_time () - start) / 1000);
+
+	/* The job is queued instead of being passed to the idle callback,
+	   so feed_pipeline_deinit() can free it if the callback never runs */
+	g_async_queue_push (parsedQueue, job);
+	g_idle_add (feed_pipeline_parsed_cb, NULL);
+}
+
+void
+feed_pipeline_process (subscriptionPtr subscription,
+                       const struct updateResult * const result,
+                       updateFlags flags,
+                       feedPipelineMergeFunc merge)
+{
+	feedPipelineJobPtr	job;
+	updateStatePtr		state;
+
+	if (!parsePool) {
+		parsePool = g_thread_pool_new (feed_pipeline_parse_func, NULL,
+		                               CLAMP (g_get_num_processors (), 1, FEED_PIPELINE_MAX_WORKERS),
+		                               FALSE, NULL);
+		parsedQueue = g_async_queue_new ();
+		mergeQueue = g_queue_new ();
+		g_atomic_int_set (&shuttingDown, FALSE);
+	}
+
+	job = g_new0 (struct feedPipelineJob, 1);
+	job->nodeId = g_strdup (subscription->node->id);
+	job->subscription = subscription;
+	job->flags = flags;
+	job->merge = merge;
+
+	/* the update result is freed after the callback returns */
+	job->data = g_malloc (result->size + 1);
+	memcpy (job->data, result->data, result->size);
+	job->data[result->size] = '\0';
+	job->contentType = g_strdup (result->contentType);
+
+	/* The parser thread must not touch the real subscription and
+	   feed as the GUI uses them meanwhile. So it gets private copies
+	   of everything feed_parse_data() and the feed handlers use. */
+	state = job->shadowSubscription.updateState = update_state_copy (subscription->updateState);
+	state->synPeriod = subscription->updateState->synPeriod;
+	state->synFrequency = subscription->updateState->synFrequency;
+	state->timeToLive = subscription->updateState->timeToLive;
+	job->shadowSubscription.type = subscription->type;
+	job->shadowSubscription.source = g_strdup (subscription->source);
+	job->shadowSubscription.error = subscription->error;
+	job->shadowSubscription.autoDiscoveryTries = subscription->autoDiscoveryTries;
+
+	job->shadowFeed = *(feedPtr)subscription->node->data;
+	job->shadowFeed.parseErrors = g_string_new (NULL);
+
+	job->ctxt = feed_parser_ctxt_new (subscription, job->data, result->size);
+	job->ctxt->subscription = &job->shadowSubscription;
+	job->ctxt->feed = &job->shadowFeed;
+	job->ctxt->contentType = job->contentType;
+
+	feed_pipeline_stats_queue (&parseStats, job);
+	g_thread_pool_push (parsePool, job, NULL);
+}
+
+void
+feed_pipeline_deinit (void)
+{
+	feedPipelineJobPtr	job;
+
+	if (!parsePool)
+		return;
+
+	/* Let the parser threads free the queued feeds instead of
+	   parsing them and wait for them to finish */
+	g_atomic_int_set (&shuttingDown, TRUE);
+	g_thread_pool_free (parsePool, FALSE, TRUE);
+	parsePool = NULL;
+
+	/* Feeds parsed meanwhile whose idle callback did not run yet */
+	while ((job = (feedPipelineJobPtr)g_async_queue_try_pop (parsedQueue)))
+		feed_pipeline_job_free (job);
+	g_async_queue_unref (parsedQueue);
+	parsedQueue = NULL;
+
+	if (mergeSourceId)
+		g_source_remove (mergeSourceId);
+	mergeSourceId = 0;
+
+	while ((job = (feedPipelineJobPtr)g_queue_pop_head (mergeQueue)))
+		feed_pipeline_job_free (job);
+	g_queue_free (mergeQueue);
+	mergeQueue = NULL;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file feed_pipeline.h  staged feed update result processing
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _FEED_PIPELINE_H
+#define _FEED_PIPELINE_H
+
+#include <glib.h>
+
+#include "feed_parser.h"
+#include "subscription.h"
+#include "update.h"
+
+/* Downloaded feeds are processed in stages: after the download
+   the data is parsed on a pool of worker threads, then the parsed
+   items are merged one feed at a time in the main loop (which owns
+   the DB connection and the GUI) and finally the UI is notified. */
+
+/** statistics of a single pipeline stage */
+typedef struct feedPipelineStats {
+	guint		queued;		/**< number of feeds waiting for the stage */
+	guint		active;		/**< number of feeds currently processed */
+	guint		processed;	/**< number of feeds processed since startup */
+	gint64		waitTime;	/**< accumulated queue wait time (in ms) */
+	gint64		runTime;	/**< accumulated processing time (in ms) */
+} feedPipelineStats;
+
+/**
+ * Merge stage callback type. Called in the main thread with the
+ * context filled by feed_parse_data() on a worker thread.
+ *
+ * @param subscription	the subscription the feed was downloaded for
+ * @param ctxt		the feed parser context
+ * @param success	result of feed_parse_data()
+ * @param flags		the update flags
+ */
+typedef void (*feedPipelineMergeFunc) (subscriptionPtr subscription, feedParserCtxtPtr ctxt, gboolean success, updateFlags flags);
+
+/**
+ * Queues the given update result for parsing on a worker thread.
+ * Once parsed the merge callback will be run in the main thread
+ * and subscription_update_processed() is called afterwards. If the
+ * subscription is removed in between the result is dropped.
+ *
+ * @param subscription	the subscription
+ * @param result	the update result (will be copied)
+ * @param flags		the update flags
+ * @param merge		the merge stage callback
+ */
+void feed_pipeline_process (subscriptionPtr subscription,
+                            const struct updateResult * const result,
+                            updateFlags flags,
+                            feedPipelineMergeFunc merge);
+
+/**
+ * Query the live statistics of the pipeline stages.
+ *
+ * @param parse		returns the statistics of the parsing stage
+ * @param merge		returns the statistics of the merge stage
+ */
+void feed_pipeline_get_stats (feedPipelineStats *parse, feedPipelineStats *merge);
+
+/**
+ * Stops the worker threads and drops all feeds not yet merged.
+ */
+void feed_pipeline_deinit (void);
+
+#endif
@@ -27,12 +27,14 @@
 #include "db.h"
 #include "debug.h"
 #include "feed.h"
+#include "feed_pipeline.h"
 #include "feedlist.h"
 #include "folder.h"
 #include "itemlist.h"
 #include "net_monitor.h"
 #include "node.h"
 #include "update.h"
+#include "update_scheduler.h"
 #include "vfolder.h"
 #include "ui/feed_list_view.h"
 #include "ui/itemview.h"
@@ -53,7 +55,7 @@ struct _FeedList {
 				                     display enabled) */
 
 	guint		saveTimer;		/*<< timer id for delayed feed list saving */
-	guint		autoUpdateTimer; /*<< timer id for auto update */
+	guint		maintenanceTimer;	/*<< timer id for the next DB maintenance slice */
 
 	gboolean	loading;		/*<< prevents the feed list being saved before it is completely loaded */
 };
@@ -87,14 +89,15 @@ static void
 feedlist_finalize (GObject *object)
 {
 	/* Stop all timer based activity */
-	if (feedlist->autoUpdateTimer) {
-		g_source_remove (feedlist->autoUpdateTimer);
-		feedlist->autoUpdateTimer = 0;
-	}
+	update_scheduler_deinit ();
 	if (feedlist->saveTimer) {
 		g_source_remove (feedlist->saveTimer);
 		feedlist->saveTimer = 0;
 	}
+	if (feedlist->maintenanceTimer) {
+		g_source_remove (feedlist->maintenanceTimer);
+		feedlist->maintenanceTimer = 0;
+	}
 
 	/* Enforce synchronous save upon exit */
 	feedlist_save ();
@@ -145,25 +148,10 @@ feedlist_class_init (FeedListClass *klass)
 		G_TYPE_STRING);
 }
 
-static gboolean
-feedlist_auto_update (void *data)
-{
-	debug_enter ("feedlist_auto_update");
-
-	if (network_monitor_is_online ())
-		node_auto_update_subscription (ROOTNODE);
-	else
-		debug0 (DEBUG_UPDATE, "no update processing because we are offline!");
-
-	debug_exit ("feedlist_auto_update");
-
-	return TRUE;
-}
-
 static void
 on_network_status_changed (gpointer instance, gboolean online, gpointer data)
 {
-	if (online) feedlist_auto_update (NULL);
+	if (online) update_scheduler_wakeup ();
 }
 
 /* This method is used to initialize the node states in the feed list */
@@ -176,18 +164,64 @@ feedlist_init_node (nodePtr node)
 	if (node->subscription)
 		db_subscription_load (node->subscription);
 
-	node_update_counters (node);
+	node_foreach_child (node, feedlist_init_node);
+}
+
+static void
+feedlist_init_node_view (nodePtr node)
+{
 	feed_list_view_update_node (node->id);	/* Necessary to initially set folder unread counters */
 
-	node_foreach_child (node, feedlist_init_node);
+	node_foreach_child (node, feedlist_init_node_view);
+}
+
+/* DB maintenance runs in short slices while no feeds are updated */
+#define MAINTENANCE_START_DELAY		60	/* seconds after startup */
+#define MAINTENANCE_SLICE_INTERVAL	2	/* seconds between slices */
+#define MAINTENANCE_SLICE_DURATION	100	/* ms per slice */
+#define MAINTENANCE_CHECK_INTERVAL	3600	/* seconds between checks for a new cycle */
+
+static gboolean feedlist_maintenance_cb (gpointer user_data);
+
+static void
+feedlist_schedule_maintenance (guint seconds)
+{
+	feedlist->maintenanceTimer = g_timeout_add_seconds (seconds, feedlist_maintenance_cb, NULL);
+}
+
+static gboolean
+feedlist_maintenance_cb (gpointer user_data)
+{
+	feedPipelineStats	parse, merge;
+	guint			count, maxcount;
+	gboolean		pending, countersChanged;
+
+	update_jobs_get_count (&count, &maxcount);
+	feed_pipeline_get_stats (&parse, &merge);
+	if (count || parse.queued || parse.active || merge.queued || merge.active) {
+		feedlist_schedule_maintenance (MAINTENANCE_SLICE_INTERVAL);
+		return FALSE;
+	}
+
+	pending = db_maintenance_run (g_get_monotonic_time () + MAINTENANCE_SLICE_DURATION * 1000, &countersChanged);
+
+	if (countersChanged) {
+		node_update_counters (ROOTNODE);
+		feedlist_foreach (feedlist_init_node_view);
+	}
+
+	feedlist_schedule_maintenance (pending?MAINTENANCE_SLICE_INTERVAL:MAINTENANCE_CHECK_INTERVAL);
+	return FALSE;
 }
 
 static void
 feedlist_init (FeedList *fl)
 {
 	gint	startup_feed_action;
+	gint64	start, importTime, stateTime, viewTime, cleanupTime;
 
 	debug_enter ("feedlist_init");
+	start = g_get_monotonic_time ();
 
 	/* 1. Prepare globally accessible singleton */
 	g_assert (NULL == feedlist);
@@ -197,22 +231,26 @@ feedlist_init (FeedList *fl)
 	/* 2. Set up a root node and import the feed list source structure. */
 	debug0 (DEBUG_CACHE, "Setting up root node");
 	ROOTNODE = node_source_setup_root ();
+	importTime = g_get_monotonic_time ();
 
-	/* 3. Ensure folder expansion and unread count*/
+	/* 3. Ensure folder expansion and unread count. All metadata and
+	      counters are fetched at once and the counters are calculated
+	      in a single bottom-up pass over the tree. */
 	debug0 (DEBUG_CACHE, "Initializing node state");
+	db_startup_preload_begin ();
 	feedlist_foreach (feedlist_init_node);
+	node_update_counters (ROOTNODE);
+	db_startup_preload_end ();
+	stateTime = g_get_monotonic_time ();
 
-	/* 4. Check if feeds do need updating. */
-	debug0 (DEBUG_UPDATE, "Performing initial feed update");
+	feedlist_foreach (feedlist_init_node_view);
+	viewTime = g_get_monotonic_time ();
+
+	/* 4. Check if feeds do need updating. Due feeds are updated
+	      by the update scheduler once it is started. */
 	conf_get_int_value (STARTUP_FEED_ACTION, &startup_feed_action);
 	if (0 == startup_feed_action) {
-		/* Update all feeds */
-		if (network_monitor_is_online ()) {
-			debug0 (DEBUG_UPDATE, "initial update: updating all feeds");
-			node_auto_update_subscription (feedlist_get_root ());
-		} else {
-			debug0 (DEBUG_UPDATE, "initial update: prevented because we are offline");
-		}
+		debug0 (DEBUG_UPDATE, "initial update: updating all due feeds");
 	} else {
 		debug0 (DEBUG_UPDATE, "initial update: resetting feed counter");
 		feedlist_reset_update_counters (NULL);
@@ -220,15 +258,27 @@ feedlist_init (FeedList *fl)
 
 	/* 5. Purge old nodes from the database */
 	db_node_cleanup (feedlist_get_root ());
+	cleanupTime = g_get_monotonic_time ();
 
 	/* 6. Start automatic updating */
-	feedlist->autoUpdateTimer = g_timeout_add_seconds (10, feedlist_auto_update, NULL);
+	update_scheduler_init ();
 	g_signal_connect (network_monitor_get (), "online-status-changed", G_CALLBACK (on_network_status_changed), NULL);
 
 	/* 7. Finally save the new feed list state */
 	feedlist->loading = FALSE;
 	feedlist_schedule_save ();
 
+	/* 8. Cleanup and vacuuming of the DB is done later during idle times */
+	feedlist_schedule_maintenance (MAINTENANCE_START_DELAY);
+
+	debug6 (DEBUG_PERF, "feed list startup: import %" G_GINT64_FORMAT "ms, node state %" G_GINT64_FORMAT "ms, view %" G_GINT64_FORMAT "ms, DB cleanup %" G_GINT64_FORMAT "ms, update scheduler %" G_GINT64_FORMAT "ms (%" G_GINT64_FORMAT "ms total)",
+	        (importTime - start) / 1000,
+	        (stateTime - importTime) / 1000,
+	        (viewTime - stateTime) / 1000,
+	        (cleanupTime - viewTime) / 1000,
+	        (g_get_monotonic_time () - cleanupTime) / 1000,
+	        (g_get_monotonic_time () - start) / 1000);
+
 	debug_exit ("feedlist_init");
 }
 
@@ -449,6 +499,8 @@ feedlist_node_added (nodePtr node)
 
 	db_node_update (node);
 
+	update_scheduler_add_node (node);
+
 	feedlist_node_imported (node);
 
 	feed_list_view_select (node);
@@ -472,6 +524,8 @@ feedlist_node_removed (nodePtr node)
 	/* First remove all children */
 	node_foreach_child (node, feedlist_node_removed);
 
+	update_scheduler_remove_node (node);
+
 	node_remove (node);
 
 	feed_list_view_remove_node (node);
@@ -59,53 +59,14 @@ theoldreader_source_migrate_node (nodePtr node)
 	itemset_free (itemset);
 }
 
-static itemPtr
-theoldreader_source_load_item_from_sourceid (nodePtr node, gchar *sourceId, GHashTable *cache)
-{
-	gpointer    ret = g_hash_table_lookup (cache, sourceId);
-	itemSetPtr  itemset;
-	int         num = g_hash_table_size (cache);
-	GList       *iter;
-	itemPtr     item = NULL;
-
-	if (ret)
-		return item_load (GPOINTER_TO_UINT (ret));
-
-	/* skip the top 'num' entries */
-	itemset = node_get_itemset (node);
-	iter = itemset->ids;
-	while (num--) iter = g_list_next (iter);
-
-	for (; iter; iter = g_list_next (iter)) {
-		item = item_load (GPOINTER_TO_UINT (iter->data));
-		if (item) {
-			if (item->sourceId) {
-				/* save to cache */
-				g_hash_table_insert (cache, g_strdup(item->sourceId), (gpointer) item->id);
-				if (g_str_equal (item->sourceId, sourceId)) {
-					itemset_free (itemset);
-					return item;
-				}
-			}
-			item_unload (item);
-		}
-	}
-
-	g_print ("Could not find item for %s!", sourceId);
-	itemset_free (itemset);
-	return NULL;
-}
-
-static void
-theoldreader_source_item_retrieve_status (const xmlNodePtr entry, subscriptionPtr subscription, GHashTable *cache)
+/* Returns the id and the remote read state of an entry */
+static xmlChar *
+theoldreader_source_item_retrieve_status (const xmlNodePtr entry, gboolean *read)
 {
 	xmlNodePtr      xml;
-	nodePtr         node = subscription->node;
 	xmlChar         *id = NULL;
-	gboolean        read = FALSE;
 
-	xml = entry->children;
-	g_assert (xml);
+	*read = FALSE;
 
 	/* Note: at the moment TheOldReader doesn't exposed a "starred" label
 	   like Google Reader did. It also doesn't expose the like feature it
@@ -113,8 +74,10 @@ theoldreader_source_item_retrieve_status (const xmlNodePtr entry, subscriptionPt
 	   TheOldReader. */
 
 	for (xml = entry->children; xml; xml = xml->next) {
-		if (g_str_equal (xml->name, "id"))
+		if (g_str_equal (xml->name, "id")) {
+			xmlFree (id);
 			id = xmlNodeGetContent (xml);
+		}
 
 		if (g_str_equal (xml->name, "category")) {
 			xmlChar* label = xmlGetProp (xml, "label");
@@ -122,28 +85,63 @@ theoldreader_source_item_retrieve_status (const xmlNodePtr entry, subscriptionPt
 				continue;
 
 			if (g_str_equal (label, "read"))
-				read = TRUE;
+				*read = TRUE;
 
 			xmlFree (label);
 		}
 	}
 
-	if (!id) {
+	if (!id)
 		g_print ("Skipping item without id in theoldreader_source_item_retrieve_status()!");
-		return;
+
+	return id;
+}
+
+/* Applies the remote read states to the local items. All ids are
+   resolved with a single indexed query and only the items whose
+   state differs are loaded. */
+static void
+theoldreader_source_sync_read_states (nodePtr node, GSList *ids, GHashTable *readStates)
+{
+	GHashTable      *itemIds;
+	GHashTableIter  iter;
+	gpointer        key, value;
+	GArray          *candidates;
+	GList           *headers, *hiter;
+
+	itemIds = db_items_find_by_source_ids (node->id, ids);
+	if (g_hash_table_size (itemIds) < g_hash_table_size (readStates))
+		debug2 (DEBUG_UPDATE, "Could not find items for %u of %u ids!",
+		        g_hash_table_size (readStates) - g_hash_table_size (itemIds),
+		        g_hash_table_size (readStates));
+
+	candidates = g_array_new (FALSE, FALSE, sizeof (gulong));
+	g_hash_table_iter_init (&iter, itemIds);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		gulong id = GPOINTER_TO_UINT (value);
+
+		/* local changes not yet sent take precedence */
+		if (!google_reader_api_edit_is_in_queue (node->source, key))
+			g_array_append_val (candidates, id);
 	}
 
-	itemPtr item = theoldreader_source_load_item_from_sourceid (node, id, cache);
-	if (item && item->sourceId) {
-		if (g_str_equal (item->sourceId, id) && !google_reader_api_edit_is_in_queue(node->source, id)) {
+	headers = db_item_headers_load_many ((gulong *)candidates->data, candidates->len);
+	for (hiter = headers; hiter; hiter = g_list_next (hiter)) {
+		itemHeaderPtr	header = (itemHeaderPtr)hiter->data;
+		gboolean	read = GPOINTER_TO_INT (g_hash_table_lookup (readStates, header->sourceId));
 
-			if (item->readStatus != read)
+		if (header->readStatus != read) {
+			itemPtr item = item_load (header->id);
+			if (item) {
 				item_read_state_changed (item, read);
+				item_unload (item);
+			}
 		}
 	}
-	if (item)
-		item_unload (item);
-	xmlFree (id);
+
+	g_list_free_full (headers, (GDestroyNotify)item_header_free);
+	g_array_free (candidates, TRUE);
+	g_hash_table_unref (itemIds);
 }
 
 static void
@@ -172,19 +170,30 @@ theoldreader_feed_subscription_process_update_result (subscriptionPtr subscripti
 	if (doc) {
 		xmlNodePtr root = xmlDocGetRootElement (doc);
 		xmlNodePtr entry = root->children ;
-		GHashTable *cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+		GHashTable *readStates = g_hash_table_new (g_str_hash, g_str_equal);
+		GSList *ids = NULL;
 
 		while (entry) {
+			xmlChar		*id;
+			gboolean	read;
+
 			if (!g_str_equal (entry->name, "entry")) {
 				entry = entry->next;
 				continue; /* not an entry */
 			}
 
-			theoldreader_source_item_retrieve_status (entry, subscription, cache);
+			id = theoldreader_source_item_retrieve_status (entry, &read);
+			if (id) {
+				ids = g_slist_prepend (ids, id);
+				g_hash_table_insert (readStates, id, GINT_TO_POINTER (read));
+			}
 			entry = entry->next;
 		}
 
-		g_hash_table_unref (cache);
+		theoldreader_source_sync_read_states (subscription->node, ids, readStates);
+
+		g_hash_table_unref (readStates);
+		g_slist_free_full (ids, (GDestroyNotify)xmlFree);
 		xmlFreeDoc (doc);
 	} else {
 		debug0 (DEBUG_UPDATE, "theoldreader_feed_subscription_process_update_result(): Couldn't parse XML!");
@@ -38,6 +38,7 @@ item_new (void)
 	itemPtr		item;
 
 	item = g_new0 (struct item, 1);
+	item->refCount = 1;
 	item->popupStatus = TRUE;
 
 	return item;
@@ -49,6 +50,14 @@ item_load (gulong id)
 	return db_item_load (id);
 }
 
+itemPtr
+item_ref (itemPtr item)
+{
+	item->refCount++;
+
+	return item;
+}
+
 itemPtr
 item_copy (itemPtr item)
 {
@@ -202,6 +211,10 @@ item_get_author(itemPtr item)
 void
 item_unload (itemPtr item)
 {
+	g_assert (item->refCount > 0);
+	if (--item->refCount > 0)
+		return;
+
 	g_free (item->title);
 	g_free (item->source);
 	g_free (item->sourceId);
@@ -216,6 +229,38 @@ item_unload (itemPtr item)
 	g_free (item);
 }
 
+gchar *
+item_get_description_hash (const gchar *description)
+{
+	return g_compute_checksum_for_string (G_CHECKSUM_SHA1, description?description:"", -1);
+}
+
+itemHeaderPtr
+item_header_from_item (itemPtr item)
+{
+	itemHeaderPtr header = g_new0 (struct itemHeader, 1);
+
+	header->id = item->id;
+	header->sourceId = g_strdup (item->sourceId);
+	header->title = g_strdup (item->title);
+	if (item->description)
+		header->descriptionHash = item_get_description_hash (item->description);
+	header->time = item->time;
+	header->readStatus = item->readStatus;
+	header->flagStatus = item->flagStatus;
+
+	return header;
+}
+
+void
+item_header_free (itemHeaderPtr header)
+{
+	g_free (header->sourceId);
+	g_free (header->title);
+	g_free (header->descriptionHash);
+	g_free (header);
+}
+
 const gchar *
 item_get_base_url (itemPtr item)
 {
@@ -42,6 +42,7 @@
  *  for folders and vfolders. */
 typedef struct item {
 	gulong		id;			/*<< internally unique item id */
+	guint		refCount;		/*<< number of references, see item_ref() and item_unload() */
 
 	/* those fields should not be accessed directly. Accessors are provided. */
 	gboolean 	readStatus;		/*<< TRUE if the item has been read */
@@ -75,6 +76,21 @@ typedef struct item {
 	gboolean	remoteFlagStatus;	/*<< TRUE if the remote copy of the item has been flagged */
 } *itemPtr;
 
+/*
+ * A compact projection of an item with just the fields needed to
+ * merge downloaded items against the items in the cache. Instead of
+ * the description only a hash of it is kept.
+ */
+typedef struct itemHeader {
+	gulong		id;			/*<< internally unique item id */
+	gchar		*sourceId;		/*<< "Unique" syndication item identifier */
+	gchar		*title;			/*<< Title */
+	gchar		*descriptionHash;	/*<< Hash of the description (or NULL if the item has no description) */
+	gint64		time;			/*<< Last modified date of the headline */
+	gboolean 	readStatus;		/*<< TRUE if the item has been read */
+	gboolean 	flagStatus;		/*<< TRUE if the item has been flagged */
+} *itemHeaderPtr;
+
 /**
  * item_new: (skip)
  * Allocates a new item structure.
@@ -88,13 +104,27 @@ itemPtr 	item_new(void);
  * @id:	item id to load
  *
  * Returns the item structure for the given item id or
- * NULL if no such item does exist. The caller has to free
+ * NULL if no such item does exist. The caller has to release
  * the item with item_unload() once it is not used anymore.
  *
+ * Recently used items are shared with the item cache, so
+ * changes to the item must be written using db_item_update()
+ * or db_item_state_update().
+ *
  * Returns: (transfer full) (nullable): item structure
  */
 itemPtr		item_load(gulong id);
 
+/**
+ * item_ref: (skip)
+ * @item:	the item
+ *
+ * Adds a reference to the given item.
+ *
+ * Returns: the item
+ */
+itemPtr		item_ref(itemPtr item);
+
 /**
  * item_copy: (skip)
  * @item: the item to copy
@@ -121,12 +151,42 @@ const gchar * item_get_base_url(itemPtr item);
  * item_unload: (skip)
  * @item:	the item to unload
  *
- * Free the memory used by an itempointer. The item needs to be
+ * Releases a reference to the item and frees the memory used by
+ * the item when it was the last one. The item needs to be
  * removed from the itemlist before calling this function.
  *
  */
 void	item_unload(itemPtr item);
 
+/**
+ * item_get_description_hash: (skip)
+ * @description:	an item description (or NULL)
+ *
+ * Computes the content hash used to compare item descriptions
+ * without loading them. NULL is hashed like an empty description.
+ *
+ * Returns: (transfer full): newly allocated hash string
+ */
+gchar * item_get_description_hash (const gchar *description);
+
+/**
+ * item_header_from_item: (skip)
+ * @item:	the item
+ *
+ * Creates the merge header for the given item.
+ *
+ * Returns: (transfer full): new header, to be free'd using item_header_free()
+ */
+itemHeaderPtr item_header_from_item (itemPtr item);
+
+/**
+ * item_header_free: (skip)
+ * @header:	the item header
+ *
+ * Frees the given item header.
+ */
+void item_header_free (itemHeaderPtr header);
+
 /* methods to access properties */
 /* Returns the id of item. */
 const gchar *	item_get_id(itemPtr item);
@@ -0,0 +1,179 @@
+/**
+ * @file item_cache.c  cache of recently used items
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "item_cache.h"
+
+static GHashTable	*items = NULL;		/**< item id -> link in lru */
+static GQueue		lru = G_QUEUE_INIT;	/**< cached items, most recently used first */
+static guint		maxSize = ITEM_CACHE_SIZE;
+
+static guint		hits = 0;
+static guint		misses = 0;
+
+static GList *
+item_cache_find (gulong id)
+{
+	if (!items)
+		return NULL;
+
+	return (GList *)g_hash_table_lookup (items, GUINT_TO_POINTER (id));
+}
+
+static void
+item_cache_remove_link (GList *link)
+{
+	itemPtr	item = (itemPtr)link->data;
+
+	g_hash_table_remove (items, GUINT_TO_POINTER (item->id));
+	g_queue_delete_link (&lru, link);
+	item_unload (item);
+}
+
+itemPtr
+item_cache_lookup (gulong id)
+{
+	GList	*link;
+
+	link = item_cache_find (id);
+	if (!link) {
+		misses++;
+		return NULL;
+	}
+
+	hits++;
+	g_queue_unlink (&lru, link);
+	g_queue_push_head_link (&lru, link);
+
+	return item_ref ((itemPtr)link->data);
+}
+
+void
+item_cache_add (itemPtr item)
+{
+	GList	*link;
+
+	if (0 == maxSize || 0 == item->id)
+		return;
+
+	if (!items)
+		items = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	link = item_cache_find (item->id);
+	if (link) {
+		if (link->data == item)
+			return;
+		item_cache_remove_link (link);
+	}
+
+	g_queue_push_head (&lru, item_ref (item));
+	g_hash_table_insert (items, GUINT_TO_POINTER (item->id), lru.head);
+
+	while (lru.length > maxSize)
+		item_cache_remove_link (lru.tail);
+}
+
+void
+item_cache_item_updated (itemPtr item)
+{
+	GList	*link;
+
+	/* the cached instance is up-to-date as it was the one written */
+	link = item_cache_find (item->id);
+	if (link && link->data != item)
+		item_cache_remove_link (link);
+}
+
+void
+item_cache_item_state_updated (itemPtr item)
+{
+	GList	*link;
+	itemPtr	cached;
+
+	link = item_cache_find (item->id);
+	if (!link || link->data == item)
+		return;
+
+	cached = (itemPtr)link->data;
+	cached->readStatus = item->readStatus;
+	cached->flagStatus = item->flagStatus;
+	cached->updateStatus = item->updateStatus;
+}
+
+void
+item_cache_item_removed (gulong id)
+{
+	GList	*link, *next;
+
+	link = item_cache_find (id);
+	if (link)
+		item_cache_remove_link (link);
+
+	/* comments are removed together with their parent item */
+	for (link = lru.head; link; link = next) {
+		itemPtr	item = (itemPtr)link->data;
+
+		next = link->next;
+		if (item->isComment && item->parentItemId == id)
+			item_cache_remove_link (link);
+	}
+}
+
+void
+item_cache_node_changed (const gchar *nodeId)
+{
+	GList	*link, *next;
+
+	for (link = lru.head; link; link = next) {
+		itemPtr	item = (itemPtr)link->data;
+
+		next = link->next;
+		if (0 == g_strcmp0 (item->nodeId, nodeId) ||
+		    (item->isComment && 0 == g_strcmp0 (item->parentNodeId, nodeId)))
+			item_cache_remove_link (link);
+	}
+}
+
+void
+item_cache_set_size (guint size)
+{
+	maxSize = size;
+
+	while (lru.length > maxSize)
+		item_cache_remove_link (lru.tail);
+}
+
+void
+item_cache_get_stats (guint *cacheHits, guint *cacheMisses)
+{
+	*cacheHits = hits;
+	*cacheMisses = misses;
+}
+
+void
+item_cache_clear (void)
+{
+	while (lru.head)
+		item_cache_remove_link (lru.head);
+
+	if (items) {
+		g_hash_table_destroy (items);
+		items = NULL;
+	}
+}
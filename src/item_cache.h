@@ -0,0 +1,112 @@
+/**
+ * @file item_cache.h  cache of recently used items
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _ITEM_CACHE_H
+#define _ITEM_CACHE_H
+
+#include <glib.h>
+
+#include "item.h"
+
+/* The item cache keeps the least recently used items loaded from
+   the DB, so that the same item loaded for the item list, the item
+   view, duplicate and comment handling is read from the DB only once.
+   Cached items are shared using reference counting (see item_ref()
+   and item_unload()).
+
+   The DB layer keeps the cache consistent by notifying it of all
+   item changes it writes. The cache must only be used from the
+   main thread. */
+
+/** default maximum number of cached items */
+#define ITEM_CACHE_SIZE	500
+
+/**
+ * Looks up the item with the given id and makes it the most
+ * recently used one. Counts a cache hit or miss.
+ *
+ * @param id		the item id
+ *
+ * @returns a new reference to the item (to be released using
+ *          item_unload()) or NULL if the item is not cached
+ */
+itemPtr item_cache_lookup (gulong id);
+
+/**
+ * Adds an item loaded from the DB to the cache. The cache takes
+ * its own reference. Evicts the least recently used item if the
+ * cache is full.
+ *
+ * @param item		the item
+ */
+void item_cache_add (itemPtr item);
+
+/**
+ * To be called after the given item was written to the DB. If the
+ * item is not the cached instance the cached one is dropped.
+ *
+ * @param item		the item
+ */
+void item_cache_item_updated (itemPtr item);
+
+/**
+ * To be called after the state of the given item was written to
+ * the DB. Copies the state to the cached instance.
+ *
+ * @param item		the item
+ */
+void item_cache_item_state_updated (itemPtr item);
+
+/**
+ * To be called after the given item and its comments were removed
+ * from the DB.
+ *
+ * @param id		the item id
+ */
+void item_cache_item_removed (gulong id);
+
+/**
+ * Drops all items of the given node (including comments).
+ *
+ * @param nodeId	the node id
+ */
+void item_cache_node_changed (const gchar *nodeId);
+
+/**
+ * Changes the maximum number of cached items.
+ *
+ * @param size		the new size (0 disables the cache)
+ */
+void item_cache_set_size (guint size);
+
+/**
+ * Query the cache statistics.
+ *
+ * @param hits		returns the number of successful lookups
+ * @param misses	returns the number of failed lookups
+ */
+void item_cache_get_stats (guint *hits, guint *misses);
+
+/**
+ * Drops all cached items.
+ */
+void item_cache_clear (void);
+
+#endif
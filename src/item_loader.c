@@ -20,17 +20,29 @@
 
 #include "item_loader.h"
 
+#include "item.h"
+
 #define ITEM_LOADER_GET_PRIVATE item_loader_get_instance_private
 
 struct ItemLoaderPrivate {
 	fetchCallbackPtr	fetchCallback;		/**< the function to call after each item fetch */
 	gpointer		fetchCallbackData;	/**< user data for the fetch callback */
+	GDestroyNotify		fetchCallbackDataFree;	/**< free function for the user data (or NULL) */
+	mergeCallbackPtr	mergeCallback;		/**< main loop callback of threaded loaders (or NULL) */
+	gboolean		threaded;		/**< TRUE if fetching on a worker thread */
 
 	nodePtr		node;			/**< the node we are loading items for */
 
 	guint		idleId;			/**< fetch callback source id */
+	GCancellable	*cancellable;		/**< cancellable given to item_loader_start() */
 };
 
+/** result of a fetch on a worker thread */
+typedef struct itemLoaderBatch {
+	GSList		*items;		/**< the fetched items */
+	gboolean	more;		/**< result of the fetch callback */
+} *itemLoaderBatchPtr;
+
 enum {
 	ITEM_BATCH_FETCHED,
 	FINISHED,
@@ -53,6 +65,11 @@ item_loader_finalize (GObject *object)
 		il->priv->idleId = 0;
 	}
 
+	g_clear_object (&il->priv->cancellable);
+
+	if (il->priv->fetchCallbackDataFree)
+		(*il->priv->fetchCallbackDataFree)(il->priv->fetchCallbackData);
+
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -101,6 +118,14 @@ item_loader_get_node (ItemLoader *il)
 	return il->priv->node;
 }
 
+static void
+item_loader_finish (ItemLoader *il)
+{
+	g_signal_emit_by_name (il, "finished");
+	g_clear_object (&il->priv->cancellable);
+	g_object_unref (il);	/* reference taken by item_loader_start() */
+}
+
 static gboolean
 item_loader_fetch (gpointer user_data)
 {
@@ -109,20 +134,99 @@ item_loader_fetch (gpointer user_data)
 	gboolean	result;
 
 	result = (*il->priv->fetchCallback)(il->priv->fetchCallbackData, &resultItems);
-	if (result)
-		g_signal_emit_by_name (il, "item-batch-fetched", resultItems);
-	else {
+	if (result) {
+		if (g_cancellable_is_cancelled (il->priv->cancellable))
+			g_slist_free_full (resultItems, (GDestroyNotify)item_unload);
+		else
+			g_signal_emit_by_name (il, "item-batch-fetched", resultItems);
+	} else {
 		il->priv->idleId = 0;
-		g_signal_emit_by_name (il, "finished");
+		item_loader_finish (il);
 	}
 
 	return result;
 }
 
+static void
+item_loader_batch_free (itemLoaderBatchPtr batch)
+{
+	g_slist_free_full (batch->items, (GDestroyNotify)item_unload);
+	g_free (batch);
+}
+
+static void
+item_loader_fetch_thread (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+	ItemLoader		*il = ITEM_LOADER (source_object);
+	itemLoaderBatchPtr	batch;
+
+	batch = g_new0 (struct itemLoaderBatch, 1);
+	batch->more = (*il->priv->fetchCallback)(il->priv->fetchCallbackData, &batch->items);
+
+	g_task_return_pointer (task, batch, (GDestroyNotify)item_loader_batch_free);
+}
+
+static void item_loader_fetch_next (ItemLoader *il);
+
+static void
+item_loader_fetch_done (GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+	ItemLoader		*il = ITEM_LOADER (source_object);
+	itemLoaderBatchPtr	batch;
+	gboolean		more = FALSE;
+
+	/* Returns NULL if cancelled meanwhile, the batch is dropped then */
+	batch = g_task_propagate_pointer (G_TASK (result), NULL);
+	if (batch) {
+		more = batch->more;
+
+		if (il->priv->mergeCallback)
+			(*il->priv->mergeCallback)(il->priv->fetchCallbackData, &batch->items, more);
+
+		if (more) {
+			g_signal_emit_by_name (il, "item-batch-fetched", batch->items);
+			batch->items = NULL;	/* owned by the signal handler */
+		}
+
+		item_loader_batch_free (batch);
+	}
+
+	if (more)
+		item_loader_fetch_next (il);
+	else
+		item_loader_finish (il);
+}
+
+/* Runs the fetch callback on a worker thread, there is only one
+   fetch running per loader so the fetch callback is never run
+   concurrently with itself */
+static void
+item_loader_fetch_next (ItemLoader *il)
+{
+	GTask	*task;
+
+	if (g_cancellable_is_cancelled (il->priv->cancellable)) {
+		item_loader_finish (il);
+		return;
+	}
+
+	task = g_task_new (il, il->priv->cancellable, item_loader_fetch_done, NULL);
+	g_task_run_in_thread (task, item_loader_fetch_thread);
+	g_object_unref (task);
+}
+
 void
-item_loader_start (ItemLoader *il)
+item_loader_start (ItemLoader *il, GCancellable *cancellable)
 {
-	il->priv->idleId = g_idle_add (item_loader_fetch, il);
+	g_object_ref (il);	/* dropped in item_loader_finish() */
+
+	if (cancellable)
+		il->priv->cancellable = g_object_ref (cancellable);
+
+	if (il->priv->threaded)
+		item_loader_fetch_next (il);
+	else
+		il->priv->idleId = g_idle_add (item_loader_fetch, il);
 }
 
 ItemLoader *
@@ -137,3 +241,20 @@ item_loader_new (fetchCallbackPtr fetchCallback, nodePtr node, gpointer fetchCal
 
 	return il;
 }
+
+ItemLoader *
+item_loader_new_threaded (fetchCallbackPtr fetchCallback,
+                          mergeCallbackPtr mergeCallback,
+                          nodePtr node,
+                          gpointer fetchCallbackData,
+                          GDestroyNotify fetchCallbackDataFree)
+{
+	ItemLoader *il;
+
+	il = item_loader_new (fetchCallback, node, fetchCallbackData);
+	il->priv->mergeCallback = mergeCallback;
+	il->priv->fetchCallbackDataFree = fetchCallbackDataFree;
+	il->priv->threaded = TRUE;
+
+	return il;
+}
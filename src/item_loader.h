@@ -21,14 +21,19 @@
 #ifndef _ITEM_LOADER_H
 #define _ITEM_LOADER_H
 
-#include <glib-object.h>
+#include <gio/gio.h>
 
 #include "node.h"
 
 /* ItemLoader concept: an ItemLoader instance runs a fetch callback
    repeatedly collecting the items the fetch callback provides. One
    each fetch when there were items the loader emits a callback with
-   the itemset as parameter for an item view to present. */
+   the itemset as parameter for an item view to present.
+
+   Threaded item loaders run the fetch callback on a worker thread
+   (which must only use a read-only DB connection, see db_reader_new())
+   and emit the signals on the main loop. Loading can be stopped using
+   a GCancellable, after cancellation no more batches are emitted. */
 
 typedef struct ItemLoaderPrivate	ItemLoaderPrivate;
 
@@ -66,7 +71,20 @@ GType item_loader_get_type (void);
 typedef gboolean (*fetchCallbackPtr)(gpointer user_data, GSList **items);
 
 /**
- * Set up a new item loader with a specific fetch function.
+ * Definition of the optional main loop callback of threaded item
+ * loaders. Called with each batch fetched on the worker thread
+ * before it is emitted. To be used for things that need the main
+ * thread (e.g. writing the DB).
+ *
+ * @param user_data	ItemLoader type specific data
+ * @param items		the fetched items (may be modified)
+ * @param more		FALSE if this was the last fetch
+ */
+typedef void (*mergeCallbackPtr)(gpointer user_data, GSList **items, gboolean more);
+
+/**
+ * Set up a new item loader with a specific fetch function
+ * to be run in the main loop.
  *
  * @param fetchCallback	the item fetching function
  * @param node		the node we are loading items for
@@ -76,6 +94,24 @@ typedef gboolean (*fetchCallbackPtr)(gpointer user_data, GSList **items);
  */
 ItemLoader * item_loader_new (fetchCallbackPtr fetchCallback, nodePtr node, gpointer user_data);
 
+/**
+ * Set up a new item loader with a specific fetch function
+ * to be run on a worker thread.
+ *
+ * @param fetchCallback	the item fetching function (run on a worker thread)
+ * @param mergeCallback	main loop callback for each batch (or NULL)
+ * @param node		the node we are loading items for
+ * @param user_data	ItemLoader type specific data
+ * @param user_data_free function to free user_data with the loader (or NULL)
+ *
+ * @returns the new ItemLoader instance
+ */
+ItemLoader * item_loader_new_threaded (fetchCallbackPtr fetchCallback,
+                                       mergeCallbackPtr mergeCallback,
+                                       nodePtr node,
+                                       gpointer user_data,
+                                       GDestroyNotify user_data_free);
+
 /**
  * Returns the node an item loader is loading items for.
  *
@@ -86,10 +122,18 @@ ItemLoader * item_loader_new (fetchCallbackPtr fetchCallback, nodePtr node, gpoi
 nodePtr item_loader_get_node (ItemLoader *il);
 
 /**
- * Starts the item loader to load items with idle priority.
+ * Starts the item loader to load items with idle priority or on
+ * a worker thread. The loader keeps a reference to itself until
+ * it emits the "finished" signal.
  *
- * @param il	the item loader
+ * When the cancellable is triggered no more item batches will be
+ * emitted. Threaded loaders stop fetching, main loop loaders keep
+ * fetching until done as their fetch callback might have side
+ * effects. "finished" is emitted in both cases.
+ *
+ * @param il		the item loader
+ * @param cancellable	a GCancellable (or NULL)
  */
-void item_loader_start (ItemLoader *il);
+void item_loader_start (ItemLoader *il, GCancellable *cancellable);
 
 #endif
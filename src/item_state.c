@@ -126,6 +126,34 @@ item_read_state_changed (itemPtr item, gboolean newState)
 	debug_end_measurement (DEBUG_GUI, "set read status");
 }
 
+static void
+item_state_mark_read_cb (itemPtr item)
+{
+	if (!item->readStatus) {
+		nodePtr node = node_from_id (item->nodeId);
+		if (node) {
+			item_state_set_recount_flag (node);
+			node_source_item_mark_read (node, item, TRUE);
+		}
+
+		debug_start_measurement (DEBUG_GUI);
+
+		GSList *duplicates = db_item_get_duplicate_nodes (item->sourceId);
+		GSList *duplicate = duplicates;
+		while (duplicate) {
+			gchar *nodeId = (gchar *)duplicate->data;
+			nodePtr affectedNode = node_from_id (nodeId);
+			if (affectedNode)
+				item_state_set_recount_flag (affectedNode);
+			g_free (nodeId);
+			duplicate = g_slist_next (duplicate);
+		}
+		g_slist_free(duplicates);
+
+		debug_end_measurement (DEBUG_GUI, "mark read of duplicates");
+	}
+}
+
 /**
  * In difference to all the other item state handling methods
  * item_state_set_all_read does not immediately apply the 
@@ -140,38 +168,7 @@ itemset_mark_read (nodePtr node)
 	itemSetPtr	itemSet;
 
 	itemSet = node_get_itemset (node);
-	GList *iter = itemSet->ids;
-	while (iter) {
-		gulong id = GPOINTER_TO_UINT (iter->data);
-		itemPtr item = item_load (id);
-		if (item) {
-			if (!item->readStatus) {
-				nodePtr node = node_from_id (item->nodeId);
-				if (node) {
-					item_state_set_recount_flag (node);
-					node_source_item_mark_read (node, item, TRUE);
-				}
-
-				debug_start_measurement (DEBUG_GUI);
-
-				GSList *duplicates = db_item_get_duplicate_nodes (item->sourceId);
-				GSList *duplicate = duplicates;
-				while (duplicate) {
-					gchar *nodeId = (gchar *)duplicate->data;
-					nodePtr affectedNode = node_from_id (nodeId);
-					if (affectedNode)
-						item_state_set_recount_flag (affectedNode);
-					g_free (nodeId);
-					duplicate = g_slist_next (duplicate);
-				}
-				g_slist_free(duplicates);
-
-				debug_end_measurement (DEBUG_GUI, "mark read of duplicates");
-			}
-			item_unload (item);
-		}
-		iter = g_list_next (iter);
-	}
+	itemset_foreach (itemSet, item_state_mark_read_cb);
 
 	// FIXME: why not call itemset_free (itemSet); here? Crashes!
 }
@@ -65,6 +65,9 @@ struct ItemListPrivate
 	nodePtr		currentNode;		/*<< the node whose own or its child items are currently displayed */
 	gulong		selectedId;		/*<< the currently selected (and displayed) item id */
 
+	ItemLoader	*loader;		/*<< the item loader of the current search result (or NULL) */
+	GCancellable	*loaderCancellable;	/*<< cancels the current item loader on unloading */
+
 	nodeViewType	viewMode;		/*<< current viewing mode */
 	guint 		loading;		/*<< if >0 prevents selection effects when loading the item list */
 	itemPtr		invalidSelection;	/*<< if set then the next selection might need to do an unselect first */
@@ -125,9 +128,20 @@ itemlist_duplicate_list_free (void)
 	}
 }
 
+static void
+itemlist_cancel_loader (void)
+{
+	if (itemlist->priv->loaderCancellable) {
+		g_cancellable_cancel (itemlist->priv->loaderCancellable);
+		g_clear_object (&itemlist->priv->loaderCancellable);
+	}
+	g_clear_object (&itemlist->priv->loader);
+}
+
 static void
 itemlist_finalize (GObject *object)
 {
+	itemlist_cancel_loader ();
 	itemset_free (itemlist->priv->filter);
 	itemlist_duplicate_list_free ();
 
@@ -186,6 +200,7 @@ itemlist_check_for_deferred_action (void)
 			item = item_load (id);
 			itemview_remove_item (item);
 			feed_list_view_update_node (item->nodeId);
+			item_unload (item);
 		}
 
 		/* check for removals caused by vfolder rules */
@@ -351,6 +366,7 @@ itemlist_unload (gboolean markRead)
 		itemlist_check_for_deferred_action ();
 	}
 
+	itemlist_cancel_loader ();
 	itemlist_set_selected (NULL);
 	itemlist_duplicate_list_free ();
 	itemlist->priv->currentNode = NULL;
@@ -722,9 +738,8 @@ itemlist_item_batch_fetched_cb (ItemLoader *il, GSList *items, gpointer user_dat
 {
 	GSList		*iter;
 
-	if (item_loader_get_node (il) != itemlist->priv->currentNode)
-		return;	/* Bail on loader not matching selection */
-
+	/* No need to check for the loader matching the selection as
+	   loaders are cancelled on unloading and emit no more batches */
 	debug0 (DEBUG_CACHE, "itemlist_item_batch_fetched_cb()");
 
 	iter = items;
@@ -744,9 +759,12 @@ itemlist_item_batch_fetched_cb (ItemLoader *il, GSList *items, gpointer user_dat
 static void
 itemlist_add_loader (ItemLoader *loader)
 {
+	itemlist->priv->loader = loader;
+	itemlist->priv->loaderCancellable = g_cancellable_new ();
+
 	g_signal_connect (G_OBJECT (loader), "item-batch-fetched", G_CALLBACK (itemlist_item_batch_fetched_cb), NULL);
 
-	item_loader_start (loader);
+	item_loader_start (loader, itemlist->priv->loaderCancellable);
 }
 
 void
@@ -757,6 +775,9 @@ itemlist_add_search_result (ItemLoader *loader)
 	/* Ensure that we are in a useful viewing mode (3 paned) */
 	itemlist_unload (FALSE);
 
+	if (!loader)
+		return;	/* search folder still reloading */
+
 	viewMode = itemlist_get_view_mode ();
 	if ((NODE_VIEW_MODE_NORMAL != viewMode) &&
 	    (NODE_VIEW_MODE_WIDE != viewMode))
@@ -35,18 +35,68 @@
 #include "vfolder.h"
 #include "fl_sources/node_source.h"
 
+/** maximum number of items itemset_foreach() keeps loaded at once */
+#define ITEMSET_FOREACH_BATCH_SIZE	100
+
+static GList *
+itemset_load_ids (GList *ids, guint max)
+{
+	GList	*items;
+	GArray	*idArray;
+
+	idArray = g_array_new (FALSE, FALSE, sizeof (gulong));
+	while (ids && idArray->len < max) {
+		gulong id = GPOINTER_TO_UINT (ids->data);
+		g_array_append_val (idArray, id);
+		ids = g_list_next (ids);
+	}
+
+	items = db_items_load_many ((gulong *)idArray->data, idArray->len);
+	g_array_free (idArray, TRUE);
+
+	return items;
+}
+
+GList *
+itemset_load_items (GList *ids)
+{
+	return itemset_load_ids (ids, G_MAXUINT);
+}
+
+static GList *
+itemset_load_headers (GList *ids)
+{
+	GList	*headers;
+	GArray	*idArray;
+
+	idArray = g_array_new (FALSE, FALSE, sizeof (gulong));
+	for (; ids; ids = g_list_next (ids)) {
+		gulong id = GPOINTER_TO_UINT (ids->data);
+		g_array_append_val (idArray, id);
+	}
+
+	headers = db_item_headers_load_many ((gulong *)idArray->data, idArray->len);
+	g_array_free (idArray, TRUE);
+
+	return headers;
+}
+
 void
 itemset_foreach (itemSetPtr itemSet, itemActionFunc callback)
 {
 	GList	*iter = itemSet->ids;
 
-	while(iter) {
-		itemPtr item = item_load (GPOINTER_TO_UINT (iter->data));
-		if (item) {
-			(*callback) (item);
-			item_unload (item);
+	while (iter) {
+		GList *items, *item;
+
+		items = itemset_load_ids (iter, ITEMSET_FOREACH_BATCH_SIZE);
+		iter = g_list_nth (iter, ITEMSET_FOREACH_BATCH_SIZE);
+
+		for (item = items; item; item = g_list_next (item)) {
+			(*callback) ((itemPtr)item->data);
+			item_unload ((itemPtr)item->data);
 		}
-		iter = g_list_next (iter);
+		g_list_free (items);
 	}
 }
 
@@ -62,93 +112,192 @@ itemset_get_max_item_count (itemSetPtr itemSet)
 	return G_MAXUINT;
 }
 
-/**
- * itemset_generic_merge_check: (skip)
- * @items:		existing items
- * @newItem:		new item to merge
- * @maxChecks: 		maximum number of item checks
- * @allowUpdates:	TRUE if item content update is to be
- *      		allowed for existing items
- * @allowStateChanges:	TRUE if item state shall be
- *				overwritten by source
- *
- * Generic merge logic suitable for feeds
- *
- * Returns: TRUE if merging instead of updating is necessary)
- */
+/* Merge index
+
+   To avoid comparing each new item against every existing item the
+   merge builds two hash indices over the existing items: one on the
+   item id and one on title and description hash for items without
+   id. The lookup result is exactly the first item in list order the
+   old linear comparison loop would have matched. The index works on
+   item headers so descriptions do not need to be loaded. */
+
+struct itemSetMergeIndex {
+	GHashTable	*bySourceId;	/*<< item id -> first item with this id */
+	GHashTable	*byContent;	/*<< id-less items keyed by title and description hash */
+	GList		*wildcards;	/*<< id-less items lacking title or description (in list order) */
+	GList		*idless;	/*<< all id-less items (in list order) */
+	GHashTable	*positions;	/*<< item -> list position (lower is earlier) */
+	gint		firstPosition;	/*<< position of the list head */
+};
+
+/* Old merge semantic: missing titles or descriptions do match anything */
 static gboolean
-itemset_generic_merge_check (GList *items, itemPtr newItem, gint maxChecks, gboolean allowUpdates, gboolean allowStateChanges)
+itemset_merge_content_equal (itemHeaderPtr oldItem, itemHeaderPtr newItem, guint *reason)
 {
-	GList		*oldItemIdIter = items;
-	itemPtr		oldItem = NULL;
-	gboolean	found, equal = FALSE;
-	guint		reason = 0;
+	gboolean equal = TRUE;
 
-	/* determine if we should add it... */
-	debug3 (DEBUG_CACHE, "check new item for merging: \"%s\", %i, %i", item_get_title (newItem), allowUpdates, allowStateChanges);
+	if (((oldItem->title != NULL) && (newItem->title != NULL)) &&
+	     (0 != strcmp (oldItem->title, newItem->title))) {
+		equal = FALSE;
+		*reason |= 1;
+	}
 
-	/* compare to every existing item in this feed */
-	found = FALSE;
-	while (oldItemIdIter) {
-		oldItem = (itemPtr)(oldItemIdIter->data);
+	if (((oldItem->descriptionHash != NULL) && (newItem->descriptionHash != NULL)) &&
+	     (0 != strcmp (oldItem->descriptionHash, newItem->descriptionHash))) {
+		equal = FALSE;
+		*reason |= 2;
+	}
 
-		/* try to compare the two items */
+	return equal;
+}
 
-		/* trivial case: one item has id the other doesn't -> they can't be equal */
-		if (((item_get_id (oldItem) == NULL) && (item_get_id (newItem) != NULL)) ||
-		    ((item_get_id (oldItem) != NULL) && (item_get_id (newItem) == NULL))) {
-			/* cannot be equal (different ids) so compare to
-			   next old item */
-			oldItemIdIter = g_list_next (oldItemIdIter);
-		   	continue;
-		}
+static guint
+itemset_merge_content_hash (gconstpointer key)
+{
+	itemHeaderPtr header = (itemHeaderPtr)key;
 
-		/* just for the case there are no ids: compare titles and HTML descriptions */
-		equal = TRUE;
+	return g_str_hash (header->title) * 31 + g_str_hash (header->descriptionHash);
+}
 
-		if (((item_get_title (oldItem) != NULL) && (item_get_title (newItem) != NULL)) &&
-		     (0 != strcmp (item_get_title (oldItem), item_get_title (newItem)))) {
-	    		equal = FALSE;
-			reason |= 1;
-		}
+static gboolean
+itemset_merge_content_key_equal (gconstpointer a, gconstpointer b)
+{
+	itemHeaderPtr header1 = (itemHeaderPtr)a;
+	itemHeaderPtr header2 = (itemHeaderPtr)b;
 
-		if (((item_get_description (oldItem) != NULL) && (item_get_description (newItem) != NULL)) &&
-		     (0 != strcmp (item_get_description(oldItem), item_get_description (newItem)))) {
-	    		equal = FALSE;
-			reason |= 2;
-		}
+	return g_str_equal (header1->title, header2->title) &&
+	       g_str_equal (header1->descriptionHash, header2->descriptionHash);
+}
 
-		/* best case: they both have ids (position important: id check is useless without knowing if the items are different!) */
-		if (item_get_id (oldItem)) {
-			if (0 == strcmp (item_get_id (oldItem), item_get_id (newItem))) {
-				found = TRUE;
+static gint
+itemset_merge_index_position (itemSetMergeIndexPtr index, itemHeaderPtr item)
+{
+	return GPOINTER_TO_INT (g_hash_table_lookup (index->positions, item));
+}
 
-				if (allowStateChanges) {
-					/* found corresponding item, check if they are REALLY equal (eg, read status may have changed) */
-					if(oldItem->readStatus != newItem->readStatus) {
-						equal = FALSE;
-						reason |= 4;
-					}
-					if(oldItem->flagStatus != newItem->flagStatus) {
-						equal = FALSE;
-						reason |= 8;
-					}
-				}
-				break;
-			} else {
-				/* different ids, but the content might be still equal (e.g. empty)
-				   so we need to explicitly unset the equal flag !!!  */
-				equal = FALSE;
-				reason |= 16;
-			}
+/* Adds an item in front of all items already indexed */
+static void
+itemset_merge_index_prepend (itemSetMergeIndexPtr index, itemHeaderPtr item, gint position)
+{
+	g_hash_table_insert (index->positions, item, GINT_TO_POINTER (position));
+
+	if (item->sourceId) {
+		g_hash_table_replace (index->bySourceId, item->sourceId, item);
+		return;
+	}
+
+	index->idless = g_list_prepend (index->idless, item);
+
+	if (!item->title || !item->descriptionHash)
+		index->wildcards = g_list_prepend (index->wildcards, item);
+	else
+		g_hash_table_replace (index->byContent, item, item);
+}
+
+itemSetMergeIndexPtr
+itemset_merge_index_new (GList *items)
+{
+	itemSetMergeIndexPtr	index;
+	GList			*iter;
+	gint			position;
+
+	index = g_new0 (struct itemSetMergeIndex, 1);
+	index->bySourceId = g_hash_table_new (g_str_hash, g_str_equal);
+	index->byContent = g_hash_table_new (itemset_merge_content_hash, itemset_merge_content_key_equal);
+	index->positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	/* Walk backwards so earlier items shadow later ones */
+	position = g_list_length (items);
+	for (iter = g_list_last (items); iter; iter = g_list_previous (iter))
+		itemset_merge_index_prepend (index, (itemHeaderPtr)iter->data, --position);
+
+	return index;
+}
+
+void
+itemset_merge_index_add (itemSetMergeIndexPtr index, itemHeaderPtr item)
+{
+	itemset_merge_index_prepend (index, item, --index->firstPosition);
+}
+
+itemHeaderPtr
+itemset_merge_index_lookup (itemSetMergeIndexPtr index, itemHeaderPtr newItem)
+{
+	itemHeaderPtr	candidate = NULL;
+	GList		*iter;
+	guint		reason = 0;
+
+	/* best case: items with id are found by id only */
+	if (newItem->sourceId)
+		return g_hash_table_lookup (index->bySourceId, newItem->sourceId);
+
+	/* A new item without title or description matches
+	   many items, so fall back to checking all of them */
+	if (!newItem->title || !newItem->descriptionHash) {
+		for (iter = index->idless; iter; iter = g_list_next (iter)) {
+			if (itemset_merge_content_equal ((itemHeaderPtr)iter->data, newItem, &reason))
+				return (itemHeaderPtr)iter->data;
 		}
+		return NULL;
+	}
+
+	candidate = g_hash_table_lookup (index->byContent, newItem);
 
-		if (equal) {
-			found = TRUE;
+	/* Items without title or description might match too, use
+	   whatever comes first in the list */
+	for (iter = index->wildcards; iter; iter = g_list_next (iter)) {
+		itemHeaderPtr wildcard = (itemHeaderPtr)iter->data;
+
+		if (candidate && itemset_merge_index_position (index, candidate) < itemset_merge_index_position (index, wildcard))
 			break;
-		}
 
-		oldItemIdIter = g_list_next (oldItemIdIter);
+		if (itemset_merge_content_equal (wildcard, newItem, &reason))
+			return wildcard;
+	}
+
+	return candidate;
+}
+
+void
+itemset_merge_index_free (itemSetMergeIndexPtr index)
+{
+	g_hash_table_destroy (index->bySourceId);
+	g_hash_table_destroy (index->byContent);
+	g_hash_table_destroy (index->positions);
+	g_list_free (index->wildcards);
+	g_list_free (index->idless);
+	g_free (index);
+}
+
+gboolean
+itemset_generic_merge_check (itemSetMergeIndexPtr index, itemPtr newItem, gboolean allowUpdates, gboolean allowStateChanges)
+{
+	itemHeaderPtr	oldHeader, newHeader;
+	gboolean	found, equal = FALSE;
+	guint		reason = 0;
+
+	/* determine if we should add it... */
+	debug3 (DEBUG_CACHE, "check new item for merging: \"%s\", %i, %i", item_get_title (newItem), allowUpdates, allowStateChanges);
+
+	newHeader = item_header_from_item (newItem);
+	oldHeader = itemset_merge_index_lookup (index, newHeader);
+	found = (NULL != oldHeader);
+
+	if (found) {
+		/* just for the case there are no ids: compare titles and HTML descriptions */
+		equal = itemset_merge_content_equal (oldHeader, newHeader, &reason);
+
+		if (oldHeader->sourceId && allowStateChanges) {
+			/* found corresponding item, check if they are REALLY equal (eg, read status may have changed) */
+			if(oldHeader->readStatus != newItem->readStatus) {
+				equal = FALSE;
+				reason |= 4;
+			}
+			if(oldHeader->flagStatus != newItem->flagStatus) {
+				equal = FALSE;
+				reason |= 8;
+			}
+		}
 	}
 
 	if (!found) {
@@ -157,35 +306,50 @@ itemset_generic_merge_check (GList *items, itemPtr newItem, gint maxChecks, gboo
 		/* if the item was found but has other contents -> update contents */
 		if (!equal) {
 			if (allowUpdates) {
-				/* no item_set_new_status() - we don't treat changed items as new items! */
-				item_set_title (oldItem, item_get_title (newItem));
-
-				/* don't use item_set_description as it does some unwanted length handling
-				   and we want to enforce the new description */
-				g_free (oldItem->description);
-				oldItem->description = newItem->description;
-				newItem->description = NULL;
-
-				oldItem->time = newItem->time;
-				oldItem->updateStatus = TRUE;
-				// FIXME: this does not remove metadata from DB
-				metadata_list_free (oldItem->metadata);
-				oldItem->metadata = newItem->metadata;
-				newItem->metadata = NULL;
-
-				/* Only update item state for feed sources where it is necessary
-				   which means online accounts we sync against, but not normal
-				   online feeds where items have no read status. */
-				if (allowStateChanges) {
-					/* To avoid notification spam from external
-					   sources: never set read items to unread again! */
-					if ((!oldItem->readStatus) && (newItem->readStatus))
-						oldItem->readStatus = newItem->readStatus;
-
-					oldItem->flagStatus = newItem->flagStatus;
-				}
+				/* only now the full item is needed */
+				itemPtr oldItem = item_load (oldHeader->id);
+				if (oldItem) {
+					/* no item_set_new_status() - we don't treat changed items as new items! */
+					item_set_title (oldItem, item_get_title (newItem));
+
+					/* don't use item_set_description as it does some unwanted length handling
+					   and we want to enforce the new description */
+					g_free (oldItem->description);
+					oldItem->description = newItem->description;
+					newItem->description = NULL;
+
+					oldItem->time = newItem->time;
+					oldItem->updateStatus = TRUE;
+					// FIXME: this does not remove metadata from DB
+					metadata_list_free (oldItem->metadata);
+					oldItem->metadata = newItem->metadata;
+					newItem->metadata = NULL;
+
+					/* Only update item state for feed sources where it is necessary
+					   which means online accounts we sync against, but not normal
+					   online feeds where items have no read status. */
+					if (allowStateChanges) {
+						/* To avoid notification spam from external
+						   sources: never set read items to unread again! */
+						if ((!oldItem->readStatus) && (newItem->readStatus))
+							oldItem->readStatus = newItem->readStatus;
+
+						oldItem->flagStatus = newItem->flagStatus;
+					}
+
+					db_item_update (oldItem);
+
+					/* keep the header in sync for subsequent merge checks */
+					g_free (oldHeader->title);
+					oldHeader->title = g_strdup (oldItem->title);
+					g_free (oldHeader->descriptionHash);
+					oldHeader->descriptionHash = g_strdup (newHeader->descriptionHash);
+					oldHeader->time = oldItem->time;
+					oldHeader->readStatus = oldItem->readStatus;
+					oldHeader->flagStatus = oldItem->flagStatus;
 
-				db_item_update (oldItem);
+					item_unload (oldItem);
+				}
 				debug1 (DEBUG_CACHE, "-> item already existing and was updated, reason %x", reason);
 			} else {
 				debug0 (DEBUG_CACHE, "-> item updates not merged because of parser errors");
@@ -195,11 +359,13 @@ itemset_generic_merge_check (GList *items, itemPtr newItem, gint maxChecks, gboo
 		}
 	}
 
+	item_header_free (newHeader);
+
 	return !found;
 }
 
 static gboolean
-itemset_merge_item (itemSetPtr itemSet, GList *items, itemPtr item, gint maxChecks, gboolean allowUpdates)
+itemset_merge_item (itemSetPtr itemSet, itemSetMergeIndexPtr index, GHashTable *duplicates, itemPtr item, gboolean allowUpdates)
 {
 	gboolean	allowStateChanges = FALSE;
 	gboolean	merge;
@@ -213,7 +379,7 @@ itemset_merge_item (itemSetPtr itemSet, GList *items, itemPtr item, gint maxChec
 		allowStateChanges = NODE_SOURCE_TYPE (node)->capabilities & NODE_SOURCE_CAPABILITY_ITEM_STATE_SYNC;
 
 	/* first try to merge with existing item */
-	merge = itemset_generic_merge_check (items, item, maxChecks, allowUpdates, allowStateChanges);
+	merge = itemset_generic_merge_check (index, item, allowUpdates, allowStateChanges);
 
 	/* if it is a new item add it to the item set */
 	if (merge) {
@@ -235,22 +401,18 @@ itemset_merge_item (itemSetPtr itemSet, GList *items, itemPtr item, gint maxChec
 
 		debug3 (DEBUG_UPDATE, "-> added \"%s\" (id=%d) to item set %p...", item_get_title (item), item->id, itemSet);
 
-		/* step 4: duplicate detection, mark read if it is a duplicate */
-		if (item->validGuid) {
-			GSList	*iter, *duplicates;
+		/* step 4: duplicate detection, mark read if it is a duplicate
+		   (the counts were fetched for the whole batch before merging
+		   and are kept up-to-date with the items added since) */
+		if (item->validGuid && item->sourceId) {
+			guint count = GPOINTER_TO_UINT (g_hash_table_lookup (duplicates, item->sourceId)) + 1;
 
-			duplicates = iter = db_item_get_duplicates (item->sourceId);
-			while (iter) {
-				debug1 (DEBUG_UPDATE, "-> duplicate guid exists: #%lu", GPOINTER_TO_UINT (iter->data));
-				iter = g_slist_next (iter);
-			}
-
-			if (g_slist_length (duplicates) > 1) {
+			g_hash_table_insert (duplicates, g_strdup (item->sourceId), GUINT_TO_POINTER (count));
+			if (count > 1) {
+				debug1 (DEBUG_UPDATE, "-> %u items with this guid exist", count);
 				item->readStatus = TRUE;	/* no unread counting... */
 				item->popupStatus = FALSE;	/* no notification... */
 			}
-
-			g_slist_free (duplicates);
 		}
 
 		/* step 5: Check item for new enclosures to download */
@@ -275,8 +437,8 @@ itemset_merge_item (itemSetPtr itemSet, GList *items, itemPtr item, gint maxChec
 static gint
 itemset_sort_by_date (gconstpointer a, gconstpointer b)
 {
-	itemPtr item1 = (itemPtr)a;
-	itemPtr item2 = (itemPtr)b;
+	itemHeaderPtr item1 = (itemHeaderPtr)a;
+	itemHeaderPtr item2 = (itemHeaderPtr)b;
 
 	g_assert(item1 && item2);
 
@@ -302,12 +464,40 @@ itemset_sort_by_date (gconstpointer a, gconstpointer b)
 	return 0;
 }
 
+/* number of newest items the publishing rate is determined from */
+#define ITEMSET_PUBLISH_RATE_ITEMS	10
+
+/* Expects the item headers to be sorted by date (newest first) */
+static void
+itemset_merge_publish_rate (itemSetPtr itemSet, GList *items)
+{
+	GList	*iter;
+	guint	count = 0;
+	gint64	oldest = 0;
+
+	itemSet->newestItemTime = 0;
+	itemSet->publishPeriod = 0;
+
+	for (iter = items; iter && count < ITEMSET_PUBLISH_RATE_ITEMS; iter = g_list_next (iter)) {
+		oldest = ((itemHeaderPtr)iter->data)->time;
+		if (0 == count)
+			itemSet->newestItemTime = oldest;
+		count++;
+	}
+
+	if (count > 1 && itemSet->newestItemTime > oldest)
+		itemSet->publishPeriod = (itemSet->newestItemTime - oldest) / (count - 1);
+}
+
 guint
 itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gboolean markAsRead)
 {
-	GList	*iter, *droppedItems = NULL, *items = NULL;
-	guint	i, max, length, toBeDropped, newCount = 0, flagCount = 0;
-	nodePtr	node;
+	GList			*iter, *droppedIds = NULL, *items = NULL;
+	GSList			*guids = NULL;
+	GHashTable		*duplicates;
+	guint			i, max, length, toBeDropped, newCount = 0, flagCount = 0;
+	nodePtr			node;
+	itemSetMergeIndexPtr	index;
 
 	debug_start_measurement (DEBUG_UPDATE);
 
@@ -322,16 +512,11 @@ itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gbo
 	length = g_list_length (list);
 	max = itemset_get_max_item_count (itemSet);
 
-	/* Preload all items for flag counting and later merging comparison */
-	iter = itemSet->ids;
-	while (iter) {
-		itemPtr item = item_load (GPOINTER_TO_UINT (iter->data));
-		if (item) {
-			items = g_list_append (items, item);
-			if (item->flagStatus)
-				flagCount++;
-		}
-		iter = g_list_next (iter);
+	/* Preload all item headers for flag counting and later merging comparison */
+	items = itemset_load_headers (itemSet->ids);
+	for (iter = items; iter; iter = g_list_next (iter)) {
+		if (((itemHeaderPtr)iter->data)->flagStatus)
+			flagCount++;
 	}
 	debug1(DEBUG_UPDATE, "current cache size: %d", g_list_length(itemSet->ids));
 	debug1(DEBUG_UPDATE, "current cache limit: %d", max);
@@ -383,7 +568,21 @@ itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gbo
 	   Adding them in this order would mean to reverse
 	   their order in the merged list, so merging needs
 	   to be done bottom to top. During this step the
-	   item list (items) may exceed the cache limit. */
+	   item list (items) may exceed the cache limit.
+
+	   All writes from here on are done in one transaction,
+	   and duplicates are counted for all items at once. */
+	db_merge_session_begin ();
+
+	for (iter = list; iter; iter = g_list_next (iter)) {
+		itemPtr item = (itemPtr)iter->data;
+		if (item->validGuid && item->sourceId)
+			guids = g_slist_prepend (guids, item->sourceId);
+	}
+	duplicates = db_items_count_duplicates (guids);
+	g_slist_free (guids);
+
+	index = itemset_merge_index_new (items);
 	iter = g_list_last (list);
 	while (iter) {
 		itemPtr item = (itemPtr)iter->data;
@@ -391,12 +590,18 @@ itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gbo
 		if (markAsRead)
 			item->readStatus = TRUE;
 
-		if (itemset_merge_item (itemSet, items, item, length, allowUpdates)) {
+		if (itemset_merge_item (itemSet, index, duplicates, item, allowUpdates)) {
+			itemHeaderPtr header = item_header_from_item (item);
+
 			newCount++;
-			items = g_list_prepend (items, iter->data);
+			items = g_list_prepend (items, header);
+			itemset_merge_index_add (index, header);
+			item_unload (item);
 		}
 		iter = g_list_previous (iter);
 	}
+	itemset_merge_index_free (index);
+	g_hash_table_destroy (duplicates);
 	g_list_free (list);
 
 	vfolder_foreach (node_update_counters);
@@ -419,30 +624,33 @@ itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gbo
 
 	debug3 (DEBUG_UPDATE, "%u new items, cache limit is %u -> dropping %u items", newCount, max, toBeDropped);
 	items = g_list_sort (items, itemset_sort_by_date);
+	itemset_merge_publish_rate (itemSet, items);
 	iter = g_list_last (items);
 	while (iter) {
-		itemPtr item = (itemPtr) iter->data;
+		itemHeaderPtr item = (itemHeaderPtr) iter->data;
 		if (toBeDropped > 0 && !item->flagStatus) {
-			debug2 (DEBUG_UPDATE, "dropping item nr %u (%s)....", item->id, item_get_title (item));
-			droppedItems = g_list_append (droppedItems, item);
-			/* no unloading here, it's done in itemlist_remove_items() */
+			debug2 (DEBUG_UPDATE, "dropping item nr %u (%s)....", item->id, item->title);
+			droppedIds = g_list_prepend (droppedIds, GUINT_TO_POINTER (item->id));
 			toBeDropped--;
-		} else {
-			item_unload (item);
 		}
 		iter = g_list_previous (iter);
 	}
 
-	if (droppedItems) {
+	if (droppedIds) {
+		/* item unloading is done in itemlist_remove_items() */
+		GList *droppedItems = itemset_load_items (g_list_reverse (droppedIds));
 		itemlist_remove_items (itemSet, droppedItems);
 		g_list_free (droppedItems);
+		g_list_free (droppedIds);
 	}
 
+	db_merge_session_end ();
+
 	/* 5. Sanity check to detect merging bugs */
 	if (g_list_length (items) > itemset_get_max_item_count (itemSet) + flagCount)
 		debug0 (DEBUG_CACHE, "Fatal: Item merging bug! Resulting item list is too long! Cache limit does not work. This is a severe program bug!");
 
-	g_list_free (items);
+	g_list_free_full (items, (GDestroyNotify)item_header_free);
 
 	debug_end_measurement (DEBUG_UPDATE, "merge itemset");
 
@@ -450,17 +658,16 @@ itemset_merge_items (itemSetPtr itemSet, GList *list, gboolean allowUpdates, gbo
 }
 
 gboolean
-itemset_check_item (itemSetPtr itemSet, itemPtr item)
+itemset_check_item_cached (itemSetPtr itemSet, ruleCheckCachePtr cache)
 {
 	gboolean	result = TRUE;
 	GSList		*iter = itemSet->rules;
 
 	while (iter) {
 		rulePtr		rule = (rulePtr) iter->data;
-		ruleCheckFunc	func = rule->ruleInfo->checkFunc;
 		gboolean	ruleResult = FALSE;
 
-		ruleResult = (*func) (rule, item);
+		ruleResult = rule_check (rule, cache);
 		result &= (rule->additive)?ruleResult:!ruleResult;
 		if (itemSet->anyMatch && ruleResult)
 			return TRUE;
@@ -471,6 +678,63 @@ itemset_check_item (itemSetPtr itemSet, itemPtr item)
 	return result;
 }
 
+gboolean
+itemset_check_item (itemSetPtr itemSet, itemPtr item)
+{
+	ruleCheckCachePtr	cache = rule_check_cache_new (item);
+	gboolean		result;
+
+	result = itemset_check_item_cached (itemSet, cache);
+	rule_check_cache_free (cache);
+
+	return result;
+}
+
+gchar *
+itemset_rules_to_sql (itemSetPtr itemSet, GSList **params)
+{
+	GString		*sql = g_string_new (NULL);
+	GSList		*iter = itemSet->rules;
+	gboolean	additive = FALSE;
+
+	while (iter) {
+		rulePtr	rule = (rulePtr) iter->data;
+		gchar	*condition = rule_to_sql (rule, params);
+
+		if (!condition) {
+			g_string_free (sql, TRUE);
+			g_slist_free_full (*params, g_free);
+			*params = NULL;
+			return NULL;
+		}
+
+		if (sql->len)
+			g_string_append (sql, itemSet->anyMatch?" OR ":" AND ");
+
+		/* Negated conditions must never be NULL as NOT NULL is NULL too.
+		   Positive ones are not wrapped to allow SQLite to use indices. */
+		if (rule->additive || itemSet->anyMatch)
+			g_string_append_printf (sql, "(%s)", condition);
+		else
+			g_string_append_printf (sql, "NOT IFNULL((%s), 0)", condition);
+
+		additive |= rule->additive;
+		g_free (condition);
+		iter = g_slist_next (iter);
+	}
+
+	/* Like itemset_check_item() an item matches any rule if one of
+	   the rules matches, no matter the rule logic, and always if
+	   all rules are negative. */
+	if (!sql->len || (itemSet->anyMatch && !additive)) {
+		g_slist_free_full (*params, g_free);
+		*params = NULL;
+		g_string_assign (sql, "1");
+	}
+
+	return g_string_free (sql, FALSE);
+}
+
 void
 itemset_add_rule (itemSetPtr itemSet,
                   const gchar *ruleId,
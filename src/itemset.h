@@ -37,8 +37,71 @@ typedef struct itemSet {
 	
 	GList		*ids;		/*<< the list of item ids */
 	gchar		*nodeId;	/*<< the feed list node id this item set belongs to */
+
+	gint64		newestItemTime;	/*<< set by itemset_merge_items(): date of the newest item (or 0) */
+	gint64		publishPeriod;	/*<< set by itemset_merge_items(): average seconds between the newest items (or 0) */
 } *itemSetPtr;
 
+/* item set merge index (see itemset_merge_items()) */
+
+typedef struct itemSetMergeIndex *itemSetMergeIndexPtr;
+
+/**
+ * itemset_merge_index_new: (skip)
+ * @items:	list of existing item headers
+ *
+ * Builds hash indices to find existing items matching newly
+ * downloaded items without comparing against every item.
+ *
+ * Returns: (transfer full): a new merge index, to be free'd
+ * using itemset_merge_index_free()
+ */
+itemSetMergeIndexPtr itemset_merge_index_new (GList *items);
+
+/**
+ * itemset_merge_index_add: (skip)
+ * @index:	the merge index
+ * @item:	the item header
+ *
+ * Adds an item in front of all existing items of the index.
+ */
+void itemset_merge_index_add (itemSetMergeIndexPtr index, itemHeaderPtr item);
+
+/**
+ * itemset_merge_index_lookup: (skip)
+ * @index:	the merge index
+ * @newItem:	header of a newly downloaded item
+ *
+ * Finds the first existing item the new item is to be merged with.
+ *
+ * Returns: (transfer none) (nullable): header of the matching item
+ */
+itemHeaderPtr itemset_merge_index_lookup (itemSetMergeIndexPtr index, itemHeaderPtr newItem);
+
+/**
+ * itemset_merge_index_free: (skip)
+ * @index:	the merge index
+ *
+ * Frees the merge index. Does not free any item headers.
+ */
+void itemset_merge_index_free (itemSetMergeIndexPtr index);
+
+/**
+ * itemset_generic_merge_check: (skip)
+ * @index:		merge index of existing items
+ * @newItem:		new item to merge
+ * @allowUpdates:	TRUE if item content update is to be
+ *      		allowed for existing items
+ * @allowStateChanges:	TRUE if item state shall be
+ *				overwritten by source
+ *
+ * Generic merge logic suitable for feeds. Updates of existing
+ * items are written to the DB right away.
+ *
+ * Returns: TRUE if merging instead of updating is necessary)
+ */
+gboolean itemset_generic_merge_check (itemSetMergeIndexPtr index, itemPtr newItem, gboolean allowUpdates, gboolean allowStateChanges);
+
 /* item set iterating interface */
 
 typedef void 	(*itemActionFunc)	(itemPtr item);
@@ -52,6 +115,17 @@ typedef void 	(*itemActionFunc)	(itemPtr item);
  */
 void itemset_foreach (itemSetPtr itemSet, itemActionFunc callback);
 
+/**
+ * itemset_load_items: (skip)
+ * @ids:	list of item ids
+ *
+ * Loads all items of the given id list using batched DB access.
+ *
+ * Returns: (transfer full): list of items in id list order, each
+ * to be free'd using item_unload()
+ */
+GList * itemset_load_items (GList *ids);
+
 /**
  * itemset_merge_items: (skip)
  * @itemSet:		the item set to merge into
@@ -60,7 +134,9 @@ void itemset_foreach (itemSetPtr itemSet, itemActionFunc callback);
  * @markAsRead:		TRUE if all new items should be marked as read
  *
  * Merges the given item set into the item set of
- * the given node. Used for node updating.
+ * the given node. Used for node updating. Also determines
+ * the publishing rate of the item set from the dates of
+ * its newest items.
  *
  * Returns: the number of new merged items
  */
@@ -77,6 +153,33 @@ guint itemset_merge_items(itemSetPtr itemSet, GList *items, gboolean allowUpdate
  */
 gboolean itemset_check_item (itemSetPtr itemSet, itemPtr item);
 
+/**
+ * itemset_check_item_cached: (skip)
+ * @itemSet:	the itemSet
+ * @cache:	the rule check cache of the item
+ *
+ * Like itemset_check_item() but shares the case folded item texts
+ * and the rule results of the given cache with other checks of
+ * the same item.
+ *
+ * Returns: TRUE if the item matches the rules of the item set
+ */
+gboolean itemset_check_item_cached (itemSetPtr itemSet, ruleCheckCachePtr cache);
+
+/**
+ * itemset_rules_to_sql: (skip)
+ * @itemSet:	the itemSet
+ * @params:	list to append the values for the placeholders to
+ *
+ * Translates the rules of the given item set into an SQL condition
+ * on the "items" table that matches the same items as
+ * itemset_check_item() does.
+ *
+ * Returns: a new SQL condition string or NULL if at least one
+ *          rule can only be checked in memory
+ */
+gchar * itemset_rules_to_sql (itemSetPtr itemSet, GSList **params);
+
 /**
  * itemset_add_rule: (skip)
  * @itemSet:	the item set
@@ -37,6 +37,7 @@
 #include "db.h"
 #include "dbus.h"
 #include "debug.h"
+#include "feed_pipeline.h"
 #include "feedlist.h"
 #include "social.h"
 #include "update.h"
@@ -177,6 +178,7 @@ on_app_shutdown (GApplication *app, gpointer user_data)
 
 	/* order is important ! */
 	update_deinit ();
+	feed_pipeline_deinit ();
 
 	/* When application is started as a service, it waits 10 seconds for a message.
 	 * If no message arrives, it will shutdown without having created a window. */
@@ -50,6 +50,11 @@
 /* to store the ATOMNsHandler structs for all supported RDF namespace handlers */
 GHashTable	*atom10_nstable = NULL;
 GHashTable	*ns_atom10_ns_uri_table = NULL;
+
+/* element parser lookup tables, set up by atom10_init_feed_handler() */
+static GHashTable	*entryElementHash = NULL;
+static GHashTable	*feedElementHash = NULL;
+
 struct atom10ParserState {
 	gboolean errorDetected;
 };
@@ -487,24 +492,6 @@ atom10_parse_entry (feedParserCtxtPtr ctxt, xmlNodePtr cur)
 	NsHandler		*nsh;
 	parseItemTagFunc	pf;
 	atom10ElementParserFunc func;
-	static GHashTable	*entryElementHash = NULL;
-
-	if (!entryElementHash) {
-		entryElementHash = g_hash_table_new (g_str_hash, g_str_equal);
-
-		g_hash_table_insert (entryElementHash, "author", &atom10_parse_entry_author);
-		g_hash_table_insert (entryElementHash, "category", &atom10_parse_entry_category);
-		g_hash_table_insert (entryElementHash, "content", &atom10_parse_entry_content);
-		g_hash_table_insert (entryElementHash, "contributor", &atom10_parse_entry_contributor);
-		g_hash_table_insert (entryElementHash, "id", &atom10_parse_entry_id);
-		g_hash_table_insert (entryElementHash, "link", &atom10_parse_entry_link);
-		g_hash_table_insert (entryElementHash, "published", &atom10_parse_entry_published);
-		g_hash_table_insert (entryElementHash, "rights", &atom10_parse_entry_rights);
-		/* FIXME: Parse "source" */
-		g_hash_table_insert (entryElementHash, "summary", &atom10_parse_entry_summary);
-		g_hash_table_insert (entryElementHash, "title", &atom10_parse_entry_title);
-		g_hash_table_insert (entryElementHash, "updated", &atom10_parse_entry_updated);
-	}
 
 	ctxt->item = item_new ();
 
@@ -748,97 +735,109 @@ atom10_parse_feed_updated (xmlNodePtr cur, feedParserCtxtPtr ctxt, struct atom10
 	}
 }
 
-/* reads a Atom feed URL and returns a new channel structure (even if
-   the feed could not be read) */
+/* parses a single child element of the feed element, entries are
+   prepended to the context item list */
 static void
-atom10_parse_feed (feedParserCtxtPtr ctxt, xmlNodePtr cur)
+atom10_parse_feed_element (feedParserCtxtPtr ctxt, xmlNodePtr cur)
 {
 	NsHandler		*nsh;
 	parseChannelTagFunc	pf;
 	atom10ElementParserFunc func;
-	static GHashTable	*feedElementHash = NULL;
 
-	if(!feedElementHash) {
-		feedElementHash = g_hash_table_new (g_str_hash, g_str_equal);
+	if (!cur->name || cur->type != XML_ELEMENT_NODE || !cur->ns)
+		return;
 
-		g_hash_table_insert (feedElementHash, "author", &atom10_parse_feed_author);
-		g_hash_table_insert (feedElementHash, "category", &atom10_parse_feed_category);
-		g_hash_table_insert (feedElementHash, "contributor", &atom10_parse_feed_contributor);
-		g_hash_table_insert (feedElementHash, "generator", &atom10_parse_feed_generator);
-		g_hash_table_insert (feedElementHash, "icon", &atom10_parse_feed_icon);
-		g_hash_table_insert (feedElementHash, "id", &atom10_parse_feed_id);
-		g_hash_table_insert (feedElementHash, "link", &atom10_parse_feed_link);
-		g_hash_table_insert (feedElementHash, "logo", &atom10_parse_feed_logo);
-		g_hash_table_insert (feedElementHash, "rights", &atom10_parse_feed_rights);
-		g_hash_table_insert (feedElementHash, "subtitle", &atom10_parse_feed_subtitle);
-		g_hash_table_insert (feedElementHash, "title", &atom10_parse_feed_title);
-		g_hash_table_insert (feedElementHash, "updated", &atom10_parse_feed_updated);
+	/* check if supported namespace should handle the current tag
+	   by trying to determine a namespace handler */
+
+	nsh = NULL;
+
+	if (cur->ns->href)
+		nsh = (NsHandler *)g_hash_table_lookup (ns_atom10_ns_uri_table, (gpointer)cur->ns->href);
+
+	if (cur->ns->prefix && !nsh)
+		nsh = (NsHandler *)g_hash_table_lookup (atom10_nstable, (gpointer)cur->ns->prefix);
+
+	if(nsh) {
+		pf = nsh->parseChannelTag;
+		if(pf)
+			(*pf)(ctxt, cur);
+		return;
 	}
 
-	while (TRUE) {
-		if (xmlStrcmp (cur->name, BAD_CAST"feed")) {
-			g_string_append (ctxt->feed->parseErrors, "<p>Could not find Atom 1.0 header!</p>");
-			break;
-		}
+	/* check namespace of this tag */
+	if (!cur->ns->href) {
+		/* This is an invalid feed... no idea what to do with the current element */
+		debug1 (DEBUG_PARSING, "element with no namespace found in atom feed (%s)!", cur->name);
+		return;
+	}
 
-		/* parse feed contents */
-		cur = cur->xmlChildrenNode;
-		while (cur) {
-		 	if (!cur->name || cur->type != XML_ELEMENT_NODE || !cur->ns) {
-				cur = cur->next;
-				continue;
-			}
+	if (xmlStrcmp (cur->ns->href, ATOM10_NS)) {
+		debug1 (DEBUG_PARSING, "unknown namespace %s found in atom feed!", cur->ns->href);
+		return;
+	}
+	/* At this point, the namespace must be the Atom 1.0 namespace */
 
-			/* check if supported namespace should handle the current tag
-			   by trying to determine a namespace handler */
+	func = g_hash_table_lookup (feedElementHash, cur->name);
+	if (func) {
+		(*func) (cur, ctxt, NULL);
+	} else if (xmlStrEqual (cur->name, BAD_CAST"entry")) {
+		ctxt->item = atom10_parse_entry (ctxt, cur);
+		if (ctxt->item)
+			ctxt->items = g_list_prepend (ctxt->items, ctxt->item);
+	}
+}
 
-			nsh = NULL;
+/* reads a Atom feed URL and returns a new channel structure (even if
+   the feed could not be read) */
+static void
+atom10_parse_feed (feedParserCtxtPtr ctxt, xmlNodePtr cur)
+{
+	if (xmlStrcmp (cur->name, BAD_CAST"feed")) {
+		g_string_append (ctxt->feed->parseErrors, "<p>Could not find Atom 1.0 header!</p>");
+		return;
+	}
 
-			if (cur->ns->href)
-				nsh = (NsHandler *)g_hash_table_lookup (ns_atom10_ns_uri_table, (gpointer)cur->ns->href);
+	/* parse feed contents */
+	for (cur = cur->xmlChildrenNode; cur; cur = cur->next)
+		atom10_parse_feed_element (ctxt, cur);
 
-			if (cur->ns->prefix && !nsh)
-				nsh = (NsHandler *)g_hash_table_lookup (atom10_nstable, (gpointer)cur->ns->prefix);
+	/* The sort is stable, so prepending and sorting once keeps
+	   entries with equal dates in reverse document order */
+	ctxt->items = g_list_sort (ctxt->items, atom10_item_sort_by_date);
 
-			if(nsh) {
-				pf = nsh->parseChannelTag;
-				if(pf)
-					(*pf)(ctxt, cur);
-				cur = cur->next;
-				continue;
-			}
+	/* FIXME: Maybe check to see that the required information was actually provided (persuant to the RFC). */
+}
 
-			/* check namespace of this tag */
-			if (!cur->ns->href) {
-				/* This is an invalid feed... no idea what to do with the current element */
-				debug1 (DEBUG_PARSING, "element with no namespace found in atom feed (%s)!", cur->name);
-				cur = cur->next;
-				continue;
-			}
+/* Same as atom10_parse_feed() but reads the feed from an XML reader
+   positioned on the feed element. Only one child element at a time
+   is expanded into a DOM subtree. */
+static void
+atom10_parse_feed_stream (feedParserCtxtPtr ctxt, xmlTextReaderPtr reader)
+{
+	xmlNodePtr	cur;
+	int		depth, ret;
 
-			if (xmlStrcmp (cur->ns->href, ATOM10_NS)) {
-				debug1 (DEBUG_PARSING, "unknown namespace %s found in atom feed!", cur->ns->href);
-				cur = cur->next;
-				continue;
-			}
-			/* At this point, the namespace must be the Atom 1.0 namespace */
+	if (xmlTextReaderIsEmptyElement (reader))
+		return;
 
-			func = g_hash_table_lookup (feedElementHash, cur->name);
-			if (func) {
-				(*func) (cur, ctxt, NULL);
-			} else if (xmlStrEqual (cur->name, BAD_CAST"entry")) {
-				ctxt->item = atom10_parse_entry (ctxt, cur);
-				if (ctxt->item)
-					ctxt->items = g_list_insert_sorted (ctxt->items, ctxt->item, atom10_item_sort_by_date);
-			}
-			cur = cur->next;
+	depth = xmlTextReaderDepth (reader) + 1;
+	ret = xmlTextReaderRead (reader);
+	while (ret == 1 && xmlTextReaderDepth (reader) >= depth) {
+		if (xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT) {
+			ret = xmlTextReaderRead (reader);
+			continue;
 		}
 
-		/* FIXME: Maybe check to see that the required information was actually provided (persuant to the RFC). */
-		/* after parsing we fill in the infos into the feedPtr structure */
+		cur = xmlTextReaderExpand (reader);
+		if (cur)
+			atom10_parse_feed_element (ctxt, cur);
 
-		break;
+		/* skips the subtree, the reader frees it */
+		ret = xmlTextReaderNext (reader);
 	}
+
+	ctxt->items = g_list_sort (ctxt->items, atom10_item_sort_by_date);
 }
 
 static gboolean
@@ -849,6 +848,13 @@ atom10_format_check (xmlDocPtr doc, xmlNodePtr cur)
 	return xmlStrEqual (cur->name, BAD_CAST"feed") && xmlStrEqual (cur->ns->href, ATOM10_NS);
 }
 
+static gboolean
+atom10_stream_format_check (xmlTextReaderPtr reader)
+{
+	return xmlStrEqual (xmlTextReaderConstLocalName (reader), BAD_CAST"feed") &&
+	       xmlStrEqual (xmlTextReaderConstNamespaceUri (reader), ATOM10_NS);
+}
+
 static void
 atom10_add_ns_handler (NsHandler *handler)
 {
@@ -882,10 +888,49 @@ atom10_init_feed_handler (void)
 		atom10_add_ns_handler (ns_trackback_get_handler ());
 		atom10_add_ns_handler (ns_georss_get_handler ());
 	}
+
+	/* The lookup tables are set up here and not on first use as
+	   the parsers run on multiple threads */
+	if (!entryElementHash) {
+		entryElementHash = g_hash_table_new (g_str_hash, g_str_equal);
+
+		g_hash_table_insert (entryElementHash, "author", &atom10_parse_entry_author);
+		g_hash_table_insert (entryElementHash, "category", &atom10_parse_entry_category);
+		g_hash_table_insert (entryElementHash, "content", &atom10_parse_entry_content);
+		g_hash_table_insert (entryElementHash, "contributor", &atom10_parse_entry_contributor);
+		g_hash_table_insert (entryElementHash, "id", &atom10_parse_entry_id);
+		g_hash_table_insert (entryElementHash, "link", &atom10_parse_entry_link);
+		g_hash_table_insert (entryElementHash, "published", &atom10_parse_entry_published);
+		g_hash_table_insert (entryElementHash, "rights", &atom10_parse_entry_rights);
+		/* FIXME: Parse "source" */
+		g_hash_table_insert (entryElementHash, "summary", &atom10_parse_entry_summary);
+		g_hash_table_insert (entryElementHash, "title", &atom10_parse_entry_title);
+		g_hash_table_insert (entryElementHash, "updated", &atom10_parse_entry_updated);
+	}
+
+	if (!feedElementHash) {
+		feedElementHash = g_hash_table_new (g_str_hash, g_str_equal);
+
+		g_hash_table_insert (feedElementHash, "author", &atom10_parse_feed_author);
+		g_hash_table_insert (feedElementHash, "category", &atom10_parse_feed_category);
+		g_hash_table_insert (feedElementHash, "contributor", &atom10_parse_feed_contributor);
+		g_hash_table_insert (feedElementHash, "generator", &atom10_parse_feed_generator);
+		g_hash_table_insert (feedElementHash, "icon", &atom10_parse_feed_icon);
+		g_hash_table_insert (feedElementHash, "id", &atom10_parse_feed_id);
+		g_hash_table_insert (feedElementHash, "link", &atom10_parse_feed_link);
+		g_hash_table_insert (feedElementHash, "logo", &atom10_parse_feed_logo);
+		g_hash_table_insert (feedElementHash, "rights", &atom10_parse_feed_rights);
+		g_hash_table_insert (feedElementHash, "subtitle", &atom10_parse_feed_subtitle);
+		g_hash_table_insert (feedElementHash, "title", &atom10_parse_feed_title);
+		g_hash_table_insert (feedElementHash, "updated", &atom10_parse_feed_updated);
+	}
+
 	/* prepare feed handler structure */
 	fhp->typeStr = "atom";
 	fhp->feedParser	= atom10_parse_feed;
 	fhp->checkFormat = atom10_format_check;
+	fhp->streamParser = atom10_parse_feed_stream;
+	fhp->checkStreamFormat = atom10_stream_format_check;
 
 	return fhp;
 }
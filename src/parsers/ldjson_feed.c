@@ -63,8 +63,10 @@ ldjson_feed_parse_json_website (JsonNode *node, feedParserCtxtPtr ctxt)
 	    }
 	*/
 
-	if ((tmp = json_get_string (node, "name")))
-		node_set_title (ctxt->subscription->node, tmp);
+	if ((tmp = json_get_string (node, "name"))) {
+		g_free (ctxt->title);
+		ctxt->title = g_strdup (tmp);
+	}
 
 	if ((tmp = json_get_string (node, "url")))
 		subscription_set_homepage (ctxt->subscription, tmp);
@@ -56,81 +56,80 @@ GHashTable *RssToMetadataMapping = NULL;
 GHashTable	*rss_nstable = NULL;	/* duplicate storage: for quick finding... */
 GHashTable	*ns_rss_ns_uri_table = NULL;
 
-/* This function parses the metadata for the channel. This does not
-   parse the items. The items are parsed elsewhere. */
-static void parseChannel(feedParserCtxtPtr ctxt, xmlNodePtr cur) {
+/* This function parses a single metadata tag of the channel. */
+static void parseChannelTag(feedParserCtxtPtr ctxt, xmlNodePtr cur) {
 	gchar			*tmp, *tmp2, *tmp3;
 	NsHandler		*nsh;
 	parseChannelTagFunc	pf;
 
-	g_assert(NULL != cur);
-
-	cur = cur->xmlChildrenNode;
-	while(cur) {
-		if(cur->type != XML_ELEMENT_NODE || cur->name == NULL) {
-			cur = cur->next;
-			continue;
+	if(cur->type != XML_ELEMENT_NODE || cur->name == NULL)
+		return;
+
+	/* check namespace of this tag */
+	if(cur->ns) {
+		if((cur->ns->href && (nsh = (NsHandler *)g_hash_table_lookup(ns_rss_ns_uri_table, (gpointer)cur->ns->href))) ||
+		   (cur->ns->prefix && (nsh = (NsHandler *)g_hash_table_lookup(rss_nstable, (gpointer)cur->ns->prefix)))) {
+			if(NULL != (pf = nsh->parseChannelTag))
+				(*pf)(ctxt, cur);
+			return;
+		} else {
+			/*g_print("unsupported namespace \"%s\"\n", cur->ns->prefix);*/
 		}
+	} /* explicitly no following else !!! */
 
-		/* check namespace of this tag */
-		if(cur->ns) {
-			if((cur->ns->href && (nsh = (NsHandler *)g_hash_table_lookup(ns_rss_ns_uri_table, (gpointer)cur->ns->href))) ||
-			   (cur->ns->prefix && (nsh = (NsHandler *)g_hash_table_lookup(rss_nstable, (gpointer)cur->ns->prefix)))) {
-				if(NULL != (pf = nsh->parseChannelTag))
-					(*pf)(ctxt, cur);
-				cur = cur->next;
-				continue;
-			} else {
-				/*g_print("unsupported namespace \"%s\"\n", cur->ns->prefix);*/
-			}
-		} /* explicitly no following else !!! */
-
-		/* Check for metadata tags */
-		if(NULL != (tmp2 = g_hash_table_lookup(RssToMetadataMapping, cur->name))) {
-			if(NULL != (tmp3 = (gchar *)xmlNodeListGetString(cur->doc, cur->xmlChildrenNode, TRUE))) {
-				ctxt->subscription->metadata = metadata_list_append(ctxt->subscription->metadata, tmp2, tmp3);
-				g_free(tmp3);
-			}
+	/* Check for metadata tags */
+	if(NULL != (tmp2 = g_hash_table_lookup(RssToMetadataMapping, cur->name))) {
+		if(NULL != (tmp3 = (gchar *)xmlNodeListGetString(cur->doc, cur->xmlChildrenNode, TRUE))) {
+			ctxt->subscription->metadata = metadata_list_append(ctxt->subscription->metadata, tmp2, tmp3);
+			g_free(tmp3);
 		}
-		/* check for specific tags */
-		else if(!xmlStrcmp(cur->name, BAD_CAST"pubDate")) {
+	}
+	/* check for specific tags */
+	else if(!xmlStrcmp(cur->name, BAD_CAST"pubDate")) {
  			if(NULL != (tmp = (gchar *)xmlNodeListGetString(cur->doc, cur->xmlChildrenNode, 1))) {
-				ctxt->subscription->metadata = metadata_list_append(ctxt->subscription->metadata, "pubDate", tmp);
-				ctxt->feed->time = date_parse_RFC822 (tmp);
-				g_free(tmp);
-			}
+			ctxt->subscription->metadata = metadata_list_append(ctxt->subscription->metadata, "pubDate", tmp);
+			ctxt->feed->time = date_parse_RFC822 (tmp);
+			g_free(tmp);
 		}
-		else if(!xmlStrcmp(cur->name, BAD_CAST"ttl")) {
+	}
+	else if(!xmlStrcmp(cur->name, BAD_CAST"ttl")) {
  			if(NULL != (tmp = (gchar *)xmlNodeListGetString(cur->doc, cur->xmlChildrenNode, TRUE))) {
-				ctxt->subscription->updateState->timeToLive = atoi (tmp);
-				g_free(tmp);
-			}
+			ctxt->subscription->updateState->timeToLive = atoi (tmp);
+			g_free(tmp);
 		}
-		else if(!xmlStrcmp(cur->name, BAD_CAST"title")) {
+	}
+	else if(!xmlStrcmp(cur->name, BAD_CAST"title")) {
  			if(NULL != (tmp = unhtmlize((gchar *)xmlNodeListGetString(cur->doc, cur->xmlChildrenNode, TRUE)))) {
-				if(ctxt->title)
-					g_free(ctxt->title);
-				ctxt->title = tmp;
-			}
+			if(ctxt->title)
+				g_free(ctxt->title);
+			ctxt->title = tmp;
 		}
-		else if(!xmlStrcmp(cur->name, BAD_CAST"link")) {
+	}
+	else if(!xmlStrcmp(cur->name, BAD_CAST"link")) {
  			if(NULL != (tmp = unhtmlize((gchar *)xmlNodeListGetString(cur->doc, cur->xmlChildrenNode, TRUE)))) {
-				subscription_set_homepage (ctxt->subscription, tmp);
-				g_free(tmp);
-			}
+			subscription_set_homepage (ctxt->subscription, tmp);
+			g_free(tmp);
 		}
-		else if (!xmlStrcmp (cur->name, BAD_CAST"description")) {
+	}
+	else if (!xmlStrcmp (cur->name, BAD_CAST"description")) {
  			tmp = xhtml_extract (cur, 0, NULL);
-			if (tmp) {
-				metadata_list_set (&ctxt->subscription->metadata, "description", tmp);
-				g_free (tmp);
-			}
+		if (tmp) {
+			metadata_list_set (&ctxt->subscription->metadata, "description", tmp);
+			g_free (tmp);
 		}
-
-		cur = cur->next;
 	}
 }
 
+/* This function parses the metadata for the channel. This does not
+   parse the items. The items are parsed elsewhere. */
+static void parseChannel(feedParserCtxtPtr ctxt, xmlNodePtr cur) {
+
+	g_assert(NULL != cur);
+
+	for(cur = cur->xmlChildrenNode; cur; cur = cur->next)
+		parseChannelTag(ctxt, cur);
+}
+
 static gchar* parseTextInput(xmlNodePtr cur) {
 	gchar	*buffer = NULL, *tiLink = NULL, *tiName = NULL, *tiDescription = NULL, *tiTitle = NULL;
 
@@ -198,6 +197,53 @@ static gchar* parseImage(xmlNodePtr cur) {
 	return NULL;
 }
 
+/* Parses a single element of the channel contents: the items and
+   images/textinputs. Items are prepended to the context item list. */
+static void parseChannelContent(feedParserCtxtPtr ctxt, xmlNodePtr cur) {
+	gchar	*tmp;
+
+	if(cur->type != XML_ELEMENT_NODE || NULL == cur->name)
+		return;
+
+	/* save link to channel image */
+	if((!xmlStrcmp(cur->name, BAD_CAST"image"))) {
+		if(NULL != (tmp = parseImage(cur))) {
+			metadata_list_set (&ctxt->subscription->metadata, "imageUrl", tmp);
+			g_free(tmp);
+		}
+
+	} else if((!xmlStrcmp(cur->name, BAD_CAST"textinput")) ||
+	          (!xmlStrcmp(cur->name, BAD_CAST"textInput"))) {
+		/* no matter if we parse Userland or Netscape, there should be
+		   only one text[iI]nput per channel and parsing the rdf:ressource
+		   one should not harm */
+		if(NULL != (tmp = parseTextInput(cur))) {
+			ctxt->subscription->metadata = metadata_list_append(ctxt->subscription->metadata, "textInput", tmp);
+			g_free(tmp);
+		}
+
+	} else if((!xmlStrcmp(cur->name, BAD_CAST"items"))) { /* RSS 1.1 */
+		xmlNodePtr itemNode = cur->xmlChildrenNode;
+		while(itemNode) {
+			if ((!xmlStrcmp(itemNode->name, BAD_CAST"item"))) {
+				if(NULL != (ctxt->item = parseRSSItem(ctxt, itemNode))) {
+					if(0 == ctxt->item->time)
+						ctxt->item->time = ctxt->feed->time;
+					ctxt->items = g_list_prepend(ctxt->items, ctxt->item);
+				}
+			}
+			itemNode = itemNode->next;
+		}
+	} else if((!xmlStrcmp(cur->name, BAD_CAST"item"))) { /* RSS 1.0, 2.0 */
+		/* collect channel items */
+		if(NULL != (ctxt->item = parseRSSItem(ctxt, cur))) {
+			if(0 == ctxt->item->time)
+				ctxt->item->time = ctxt->feed->time;
+			ctxt->items = g_list_prepend(ctxt->items, ctxt->item);
+		}
+	}
+}
+
 /**
  * Parses given data as an RSS/RDF channel
  *
@@ -205,7 +251,6 @@ static gchar* parseImage(xmlNodePtr cur) {
  * @param cur		the root node of the XML document
  */
 static void rss_parse(feedParserCtxtPtr ctxt, xmlNodePtr cur) {
-	gchar		*tmp;
 	short 		rdf = 0;
 	int 		error = 0;
 
@@ -254,52 +299,119 @@ static void rss_parse(feedParserCtxtPtr ctxt, xmlNodePtr cur) {
 
 		/* parse channel contents */
 		while(cur) {
-			if(cur->type != XML_ELEMENT_NODE || NULL == cur->name) {
-				cur = cur->next;
-				continue;
-			}
+			parseChannelContent(ctxt, cur);
+			cur = cur->next;
+		}
 
-			/* save link to channel image */
-			if((!xmlStrcmp(cur->name, BAD_CAST"image"))) {
-				if(NULL != (tmp = parseImage(cur))) {
-					metadata_list_set (&ctxt->subscription->metadata, "imageUrl", tmp);
-					g_free(tmp);
-				}
+		ctxt->items = g_list_reverse(ctxt->items);
+	}
+}
 
-			} else if((!xmlStrcmp(cur->name, BAD_CAST"textinput")) ||
-			          (!xmlStrcmp(cur->name, BAD_CAST"textInput"))) {
-				/* no matter if we parse Userland or Netscape, there should be
-				   only one text[iI]nput per channel and parsing the rdf:ressource
-				   one should not harm */
-				if(NULL != (tmp = parseTextInput(cur))) {
-					ctxt->subscription->metadata = metadata_list_append(ctxt->subscription->metadata, "textInput", tmp);
-					g_free(tmp);
-				}
+/* Expands the current reader node into a subtree (discarding
+   the previous one) and returns it or NULL on errors. */
+static xmlNodePtr rss_stream_expand(xmlTextReaderPtr reader) {
+	xmlNodePtr cur = xmlTextReaderExpand(reader);
 
-			} else if((!xmlStrcmp(cur->name, BAD_CAST"items"))) { /* RSS 1.1 */
-				xmlNodePtr itemNode = cur->xmlChildrenNode;
-				while(itemNode) {
-					if ((!xmlStrcmp(itemNode->name, BAD_CAST"item"))) {
-						if(NULL != (ctxt->item = parseRSSItem(ctxt, itemNode))) {
-							if(0 == ctxt->item->time)
-								ctxt->item->time = ctxt->feed->time;
-							ctxt->items = g_list_append(ctxt->items, ctxt->item);
-						}
-					}
-					itemNode = itemNode->next;
-				}
-			} else if((!xmlStrcmp(cur->name, BAD_CAST"item"))) { /* RSS 1.0, 2.0 */
-				/* collect channel items */
-				if(NULL != (ctxt->item = parseRSSItem(ctxt, cur))) {
-					if(0 == ctxt->item->time)
-						ctxt->item->time = ctxt->feed->time;
-					ctxt->items = g_list_append(ctxt->items, ctxt->item);
-				}
+	if(cur && cur->type == XML_ELEMENT_NODE && cur->name)
+		return cur;
+
+	return NULL;
+}
+
+/**
+ * Parses an RSS/RDF channel from an XML reader positioned on the
+ * root element. Only one channel child is expanded into a DOM
+ * subtree at a time, the memory use does not grow with the feed size.
+ *
+ * @param ctxt		the feed parser context
+ * @param reader	the XML reader
+ */
+static void rss_parse_stream(feedParserCtxtPtr ctxt, xmlTextReaderPtr reader) {
+	const xmlChar	*name = xmlTextReaderConstLocalName(reader);
+	xmlNodePtr	cur;
+	short		rdf = 0, channel = 0;
+	int		depth, ret;
+
+	ctxt->feed->time = time(NULL);
+
+	if(!xmlStrcmp(name, BAD_CAST"rss")) {
+		rdf = 0;
+	} else if(!xmlStrcmp(name, BAD_CAST"rdf") ||
+	          !xmlStrcmp(name, BAD_CAST"RDF")) {
+		rdf = 1;
+	} else if(!xmlStrcmp(name, BAD_CAST"Channel")) {
+		/* the root element is the channel */
+		rdf = 0;
+		channel = 1;
+	} else {
+		g_string_append(ctxt->feed->parseErrors, "<p>Could not find RDF/RSS header!</p>");
+		return;
+	}
+
+	if(xmlTextReaderIsEmptyElement(reader))
+		return;
+
+	/* Walk the children of the root element. Nodes are consumed
+	   with xmlTextReaderNext() which frees the expanded subtrees. */
+	depth = xmlTextReaderDepth(reader) + 1;
+	ret = xmlTextReaderRead(reader);
+	while(ret == 1 && xmlTextReaderDepth(reader) >= depth) {
+		if(xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+			ret = xmlTextReaderRead(reader);
+			continue;
+		}
 
+		name = xmlTextReaderConstLocalName(reader);
+
+		if(depth == xmlTextReaderDepth(reader) && !channel &&
+		   (!xmlStrcmp(name, BAD_CAST"channel") || !xmlStrcmp(name, BAD_CAST"Channel"))) {
+			if(rdf) {
+				/* RDF: the items are siblings of the channel */
+				if(NULL != (cur = rss_stream_expand(reader)))
+					parseChannel(ctxt, cur);
+				ret = xmlTextReaderNext(reader);
+			} else {
+				/* RSS: descend into the channel */
+				channel = 1;
+				if(xmlTextReaderIsEmptyElement(reader))
+					break;
+				depth++;
+				ret = xmlTextReaderRead(reader);
+			}
+			continue;
+		}
+
+		if(depth == xmlTextReaderDepth(reader) && (rdf || channel)) {
+			if(NULL != (cur = rss_stream_expand(reader))) {
+				if(!rdf)
+					parseChannelTag(ctxt, cur);
+				parseChannelContent(ctxt, cur);
 			}
-			cur = cur->next;
 		}
+
+		ret = xmlTextReaderNext(reader);
 	}
+
+	ctxt->items = g_list_reverse(ctxt->items);
+}
+
+static gboolean rss_stream_format_check(xmlTextReaderPtr reader) {
+	const xmlChar	*name = xmlTextReaderConstLocalName(reader);
+	const xmlChar	*href = xmlTextReaderConstNamespaceUri(reader);
+
+	if(!xmlStrcmp(name, BAD_CAST"rss") ||
+	   !xmlStrcmp(name, BAD_CAST"rdf") ||
+	   !xmlStrcmp(name, BAD_CAST"RDF")) {
+		return TRUE;
+	}
+
+	/* RSS 1.1 */
+	if((NULL != href) &&
+	   !xmlStrcmp(name, BAD_CAST"Channel") &&
+	   !xmlStrcmp(href, BAD_CAST"http://purl.org/net/rss1.1#"))
+	   	return TRUE;
+
+	return FALSE;
 }
 
 static gboolean rss_format_check(xmlDocPtr doc, xmlNodePtr cur) {
@@ -376,6 +488,8 @@ rss_init_feed_handler (void)
 	fhp->typeStr = "rss";
 	fhp->feedParser	= rss_parse;
 	fhp->checkFormat = rss_format_check;
+	fhp->streamParser = rss_parse_stream;
+	fhp->checkStreamFormat = rss_stream_format_check;
 
 	return fhp;
 }
@@ -23,8 +23,11 @@
 #include <string.h>
 
 #include "common.h"
+#include "db.h"
 #include "debug.h"
+#include "feedlist.h"
 #include "metadata.h"
+#include "text_matcher.h"
 
 #define ITEM_MATCH_RULE_ID		"exact"
 #define ITEM_TITLE_MATCH_RULE_ID	"exact_title"
@@ -33,9 +36,20 @@
 #define FEED_SOURCE_MATCH_RULE_ID	"feed_source"
 #define PARENT_FOLDER_MATCH_RULE_ID	"parent_folder"
 
+/* maximum number of node ids a feed list rule is translated to */
+#define RULE_SQL_MAX_NODES		500
+
 /** list of available search folder rules */
 static GSList *ruleFunctions = NULL;
 
+/* The case folded values of all item text rules are searched in a
+   single pass with a shared text matcher. The matcher is rebuilt on
+   first use after the set of values changed. */
+G_LOCK_DEFINE_STATIC (textMatcher);
+static GHashTable	*textRuleValues = NULL;		/**< case folded value -> number of rules */
+static textMatcherPtr	textMatcher = NULL;		/**< NULL if to be rebuilt */
+static const gchar	**textMatcherValues = NULL;	/**< the values in pattern order */
+
 static void rule_init (void);
 
 GSList *
@@ -72,26 +86,209 @@ rule_new (const gchar *ruleId,
 	return NULL;
 }
 
+/* shared text matcher */
+
+static gboolean
+rule_is_item_text (rulePtr rule)
+{
+	const gchar *ruleId = rule->ruleInfo->ruleId;
+
+	return (g_str_equal (ruleId, ITEM_MATCH_RULE_ID) ||
+	        g_str_equal (ruleId, ITEM_TITLE_MATCH_RULE_ID) ||
+	        g_str_equal (ruleId, ITEM_DESC_MATCH_RULE_ID));
+}
+
+static void
+rule_text_matcher_invalidate (void)
+{
+	if (textMatcher)
+		text_matcher_free (textMatcher);
+	textMatcher = NULL;
+}
+
+static void
+rule_text_value_add (rulePtr rule)
+{
+	guint	count;
+
+	/* empty values match every text and are not searched */
+	if (!rule_is_item_text (rule) || !*rule->valueCaseFolded)
+		return;
+
+	G_LOCK (textMatcher);
+	if (!textRuleValues)
+		textRuleValues = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	count = GPOINTER_TO_UINT (g_hash_table_lookup (textRuleValues, rule->valueCaseFolded));
+	if (0 == count)
+		rule_text_matcher_invalidate ();
+	g_hash_table_insert (textRuleValues, g_strdup (rule->valueCaseFolded), GUINT_TO_POINTER (count + 1));
+	G_UNLOCK (textMatcher);
+}
+
+static void
+rule_text_value_remove (rulePtr rule)
+{
+	guint	count;
+
+	if (!textRuleValues || !rule->valueCaseFolded || !rule_is_item_text (rule) || !*rule->valueCaseFolded)
+		return;
+
+	G_LOCK (textMatcher);
+	count = GPOINTER_TO_UINT (g_hash_table_lookup (textRuleValues, rule->valueCaseFolded));
+	if (count > 1) {
+		g_hash_table_insert (textRuleValues, g_strdup (rule->valueCaseFolded), GUINT_TO_POINTER (count - 1));
+	} else {
+		/* the matcher references the value */
+		rule_text_matcher_invalidate ();
+		g_hash_table_remove (textRuleValues, rule->valueCaseFolded);
+	}
+	G_UNLOCK (textMatcher);
+}
+
+/* Returns a set of all case folded text rule values contained
+   in the given text, or NULL if there is no text. */
+static GHashTable *
+rule_text_matcher_scan (const gchar *text)
+{
+	GHashTable	*matches;
+	gchar		*textCaseFolded;
+	gboolean	*found;
+	guint		i, count;
+
+	if (!text)
+		return NULL;
+
+	matches = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	textCaseFolded = g_utf8_casefold (text, -1);
+
+	G_LOCK (textMatcher);
+	if (!textMatcher) {
+		GHashTableIter	iter;
+		gpointer	value;
+
+		count = textRuleValues?g_hash_table_size (textRuleValues):0;
+		g_free (textMatcherValues);
+		textMatcherValues = g_new (const gchar *, count + 1);
+
+		i = 0;
+		if (textRuleValues) {
+			g_hash_table_iter_init (&iter, textRuleValues);
+			while (g_hash_table_iter_next (&iter, &value, NULL))
+				textMatcherValues[i++] = (const gchar *)value;
+		}
+
+		textMatcher = text_matcher_new (textMatcherValues, count);
+		debug1 (DEBUG_CACHE, "compiled text matcher for %u search rule values", count);
+	}
+
+	count = text_matcher_get_count (textMatcher);
+	found = g_new0 (gboolean, count + 1);
+	if (text_matcher_scan (textMatcher, textCaseFolded, found)) {
+		for (i = 0; i < count; i++) {
+			if (found[i])
+				g_hash_table_add (matches, g_strdup (textMatcherValues[i]));
+		}
+	}
+	G_UNLOCK (textMatcher);
+
+	g_free (found);
+	g_free (textCaseFolded);
+
+	return matches;
+}
+
 void
 rule_set_value (rulePtr rule, const gchar *value)
 {
+	rule_text_value_remove (rule);
+
 	if (rule->value)
 		g_free (rule->value);
 	if (rule->valueCaseFolded)
 		g_free (rule->valueCaseFolded);
+	g_free (rule->resultKey);
 
 	rule->value = common_strreplace (g_strdup (value), "'", "");
 	rule->valueCaseFolded = g_utf8_casefold (rule->value, -1);
+	rule->resultKey = g_strdup_printf ("%s\n%s", rule->ruleInfo->ruleId, rule->value);
+
+	rule_text_value_add (rule);
 }
 
 void
 rule_free (rulePtr rule)
 {
+	rule_text_value_remove (rule);
+
 	g_free (rule->value);
 	g_free (rule->valueCaseFolded);
+	g_free (rule->resultKey);
 	g_free (rule);
 }
 
+/* rule check cache */
+
+ruleCheckCachePtr
+rule_check_cache_new (itemPtr item)
+{
+	ruleCheckCachePtr cache = g_new0 (struct ruleCheckCache, 1);
+
+	cache->item = item;
+	/* keys are owned by the rules */
+	cache->results = g_hash_table_new (g_str_hash, g_str_equal);
+
+	return cache;
+}
+
+void
+rule_check_cache_free (ruleCheckCachePtr cache)
+{
+	g_hash_table_destroy (cache->results);
+	if (cache->titleMatches)
+		g_hash_table_destroy (cache->titleMatches);
+	if (cache->descriptionMatches)
+		g_hash_table_destroy (cache->descriptionMatches);
+	g_free (cache);
+}
+
+static GHashTable *
+rule_check_cache_get_title_matches (ruleCheckCachePtr cache)
+{
+	if (!cache->titleScanned) {
+		cache->titleMatches = rule_text_matcher_scan (cache->item->title);
+		cache->titleScanned = TRUE;
+	}
+
+	return cache->titleMatches;
+}
+
+static GHashTable *
+rule_check_cache_get_description_matches (ruleCheckCachePtr cache)
+{
+	if (!cache->descriptionScanned) {
+		cache->descriptionMatches = rule_text_matcher_scan (cache->item->description);
+		cache->descriptionScanned = TRUE;
+	}
+
+	return cache->descriptionMatches;
+}
+
+gboolean
+rule_check (rulePtr rule, ruleCheckCachePtr cache)
+{
+	ruleCheckFunc	func = rule->ruleInfo->checkFunc;
+	gpointer	result;
+
+	if (g_hash_table_lookup_extended (cache->results, rule->resultKey, NULL, &result))
+		return GPOINTER_TO_INT (result);
+
+	result = GINT_TO_POINTER ((*func) (rule, cache));
+	g_hash_table_insert (cache->results, rule->resultKey, result);
+
+	return GPOINTER_TO_INT (result);
+}
+
 /* case insensitive strcmp helper function
 
    To avoid half of the g_utf8_casefold we expect the 2nd value to be already
@@ -113,45 +310,49 @@ rule_strcasecmp (const gchar *a, const gchar *bCaseFold)
 /* rule conditions */
 
 static gboolean
-rule_check_item_title (rulePtr rule, itemPtr item)
+rule_check_item_title (rulePtr rule, ruleCheckCachePtr cache)
 {
-	return (item->title && rule_strcasecmp (item->title, rule->valueCaseFolded));
+	GHashTable *matches = rule_check_cache_get_title_matches (cache);
+
+	return (matches && (!*rule->valueCaseFolded || g_hash_table_contains (matches, rule->valueCaseFolded)));
 }
 
 static gboolean
-rule_check_item_description (rulePtr rule, itemPtr item)
+rule_check_item_description (rulePtr rule, ruleCheckCachePtr cache)
 {
-	return (item->description && rule_strcasecmp (item->description, rule->valueCaseFolded));
+	GHashTable *matches = rule_check_cache_get_description_matches (cache);
+
+	return (matches && (!*rule->valueCaseFolded || g_hash_table_contains (matches, rule->valueCaseFolded)));
 }
 
 static gboolean
-rule_check_item_all (rulePtr rule, itemPtr item)
+rule_check_item_all (rulePtr rule, ruleCheckCachePtr cache)
 {
-	return rule_check_item_title (rule, item) || rule_check_item_description (rule, item);
+	return rule_check_item_title (rule, cache) || rule_check_item_description (rule, cache);
 }
 
 static gboolean
-rule_check_item_is_unread (rulePtr rule, itemPtr item)
+rule_check_item_is_unread (rulePtr rule, ruleCheckCachePtr cache)
 {
-	return (0 == item->readStatus);
+	return (0 == cache->item->readStatus);
 }
 
 static gboolean
-rule_check_item_is_flagged (rulePtr rule, itemPtr item)
+rule_check_item_is_flagged (rulePtr rule, ruleCheckCachePtr cache)
 {
-	return (1 == item->flagStatus);
+	return (1 == cache->item->flagStatus);
 }
 
 static gboolean
-rule_check_item_has_enc (rulePtr rule, itemPtr item)
+rule_check_item_has_enc (rulePtr rule, ruleCheckCachePtr cache)
 {
-	return item->hasEnclosure;
+	return cache->item->hasEnclosure;
 }
 
 static gboolean
-rule_check_item_category (rulePtr rule, itemPtr item)
+rule_check_item_category (rulePtr rule, ruleCheckCachePtr cache)
 {
-	GSList	*iter = metadata_list_get_values (item->metadata, "category");
+	GSList	*iter = metadata_list_get_values (cache->item->metadata, "category");
 
 	while (iter) {
 		if (g_str_equal (rule->value, (gchar *)iter->data))
@@ -164,9 +365,9 @@ rule_check_item_category (rulePtr rule, itemPtr item)
 }
 
 static gboolean
-rule_check_feed_title (rulePtr rule, itemPtr item)
+rule_check_feed_title (rulePtr rule, ruleCheckCachePtr cache)
 {
-	nodePtr feedNode = node_from_id (item->parentNodeId);
+	nodePtr feedNode = node_from_id (cache->item->parentNodeId);
 
 	if (!feedNode)
 		return FALSE;
@@ -175,9 +376,9 @@ rule_check_feed_title (rulePtr rule, itemPtr item)
 }
 
 static gboolean
-rule_check_feed_source (rulePtr rule, itemPtr item)
+rule_check_feed_source (rulePtr rule, ruleCheckCachePtr cache)
 {
-	nodePtr feedNode = node_from_id (item->parentNodeId);
+	nodePtr feedNode = node_from_id (cache->item->parentNodeId);
 	if (!feedNode)
 		return FALSE;
 
@@ -185,9 +386,9 @@ rule_check_feed_source (rulePtr rule, itemPtr item)
 }
 
 static gboolean
-rule_check_parent_folder (rulePtr rule, itemPtr item)
+rule_check_parent_folder (rulePtr rule, ruleCheckCachePtr cache)
 {
-	nodePtr node = node_from_id (item->parentNodeId);
+	nodePtr node = node_from_id (cache->item->parentNodeId);
 	if (!node)
 		return FALSE;
 
@@ -196,10 +397,193 @@ rule_check_parent_folder (rulePtr rule, itemPtr item)
 	return (node && rule_strcasecmp (node->title, rule->valueCaseFolded));
 }
 
+/* SQL conditions
+
+   The conditions must evaluate to exactly the same result as the
+   check functions above. Text search uses the casefold_contains()
+   SQL function registered in db.c which does the same as
+   rule_strcasecmp(). */
+
+/* Returns TRUE if the value only has characters the index tokenizer
+   folds exactly like g_utf8_casefold() */
+static gboolean
+rule_sql_search_index_usable (const gchar *valueCaseFolded)
+{
+	const gchar	*c;
+
+	for (c = valueCaseFolded; *c; c++)
+		if (!g_ascii_isprint (*c))
+			return FALSE;
+
+	return TRUE;
+}
+
+/* Returns a condition selecting the candidate items from the full
+   text search index or an empty string if the index can't be used.
+   The trigram index finds substrings of at least 3 characters, the
+   candidates still need to be checked with the exact condition.
+   The index holds the raw case folded texts, so it returns a
+   superset of the items the exact condition selects. */
+static gchar *
+rule_sql_search_index (const gchar *columns, const gchar *valueCaseFolded, GSList **params)
+{
+	gchar	*phrase;
+
+	if (!db_search_index_available () || g_utf8_strlen (valueCaseFolded, -1) < 3 ||
+	    !rule_sql_search_index_usable (valueCaseFolded))
+		return g_strdup ("");
+
+	phrase = common_strreplace (g_strdup (valueCaseFolded), "\"", "\"\"");
+	*params = g_slist_append (*params, g_strdup_printf ("{%s} : \"%s\"", columns, phrase));
+	g_free (phrase);
+
+	return g_strdup ("items.item_id IN (SELECT rowid FROM items_fts WHERE items_fts MATCH ?) AND ");
+}
+
+static gchar *
+rule_sql_item_title (rulePtr rule, GSList **params)
+{
+	gchar	*index, *sql;
+
+	index = rule_sql_search_index ("title", rule->valueCaseFolded, params);
+	*params = g_slist_append (*params, g_strdup (rule->valueCaseFolded));
+	sql = g_strdup_printf ("%scasefold_contains(items.title, ?)", index);
+	g_free (index);
+
+	return sql;
+}
+
+static gchar *
+rule_sql_item_description (rulePtr rule, GSList **params)
+{
+	gchar	*index, *sql;
+
+	index = rule_sql_search_index ("description", rule->valueCaseFolded, params);
+	*params = g_slist_append (*params, g_strdup (rule->valueCaseFolded));
+	sql = g_strdup_printf ("%scasefold_contains(items.description, ?)", index);
+	g_free (index);
+
+	return sql;
+}
+
+static gchar *
+rule_sql_item_all (rulePtr rule, GSList **params)
+{
+	gchar	*index, *sql;
+
+	index = rule_sql_search_index ("title description", rule->valueCaseFolded, params);
+	*params = g_slist_append (*params, g_strdup (rule->valueCaseFolded));
+	*params = g_slist_append (*params, g_strdup (rule->valueCaseFolded));
+	sql = g_strdup_printf ("%s(casefold_contains(items.title, ?) OR casefold_contains(items.description, ?))", index);
+	g_free (index);
+
+	return sql;
+}
+
+static gchar *
+rule_sql_item_is_unread (rulePtr rule, GSList **params)
+{
+	return g_strdup ("items.read = 0");
+}
+
+static gchar *
+rule_sql_item_is_flagged (rulePtr rule, GSList **params)
+{
+	return g_strdup ("items.marked = 1");
+}
+
+static gchar *
+rule_sql_item_has_enc (rulePtr rule, GSList **params)
+{
+	return g_strdup ("EXISTS (SELECT 1 FROM metadata WHERE metadata.item_id = items.item_id AND metadata.key = 'enclosure')");
+}
+
+static gchar *
+rule_sql_item_category (rulePtr rule, GSList **params)
+{
+	gchar	*index, *sql;
+
+	index = rule_sql_search_index ("category", rule->valueCaseFolded, params);
+	*params = g_slist_append (*params, g_strdup (rule->value));
+	sql = g_strdup_printf ("%sEXISTS (SELECT 1 FROM metadata WHERE metadata.item_id = items.item_id AND metadata.key = 'category' AND metadata.value = ?)", index);
+	g_free (index);
+
+	return sql;
+}
+
+typedef struct ruleSqlNodes {
+	rulePtr		rule;
+	GSList		*ids;		/* ids of matching nodes */
+	guint		count;
+} *ruleSqlNodesPtr;
+
+static void
+rule_sql_collect_nodes (nodePtr node, gpointer user_data)
+{
+	ruleSqlNodesPtr		nodes = (ruleSqlNodesPtr)user_data;
+	ruleCheckCachePtr	cache;
+	struct item		item;
+
+	/* The feed list rules only look at the parent node of an item,
+	   so check a dummy item of every node */
+	memset (&item, 0, sizeof (item));
+	item.parentNodeId = node->id;
+	cache = rule_check_cache_new (&item);
+	if (rule_check (nodes->rule, cache)) {
+		nodes->ids = g_slist_append (nodes->ids, g_strdup (node->id));
+		nodes->count++;
+	}
+	rule_check_cache_free (cache);
+
+	if (node->children)
+		node_foreach_child_data (node, rule_sql_collect_nodes, user_data);
+}
+
+/* Feed list rules depend on the feed list and not on the item,
+   they are translated into the list of matching node ids */
+static gchar *
+rule_sql_feed_list (rulePtr rule, GSList **params)
+{
+	struct ruleSqlNodes	nodes = { rule, NULL, 0 };
+	GString			*sql;
+	guint			i;
+
+	feedlist_foreach_data (rule_sql_collect_nodes, &nodes);
+
+	if (0 == nodes.count)
+		return g_strdup ("0");
+
+	if (nodes.count > RULE_SQL_MAX_NODES) {
+		g_slist_free_full (nodes.ids, g_free);
+		return NULL;
+	}
+
+	sql = g_string_new ("items.parent_node_id IN (?");
+	for (i = 1; i < nodes.count; i++)
+		g_string_append (sql, ",?");
+	g_string_append (sql, ")");
+
+	*params = g_slist_concat (*params, nodes.ids);
+
+	return g_string_free (sql, FALSE);
+}
+
+gchar *
+rule_to_sql (rulePtr rule, GSList **params)
+{
+	ruleSqlFunc	func = rule->ruleInfo->sqlFunc;
+
+	if (!func)
+		return NULL;
+
+	return (*func) (rule, params);
+}
+
 /* rule initialization */
 
 static void
 rule_info_add (ruleCheckFunc checkFunc,
+          ruleSqlFunc sqlFunc,
           const gchar *ruleId,
           gchar *title,
           gchar *positive,
@@ -215,6 +599,7 @@ rule_info_add (ruleCheckFunc checkFunc,
 	ruleInfo->negative = negative;
 	ruleInfo->needsParameter = needsParameter;
 	ruleInfo->checkFunc = checkFunc;
+	ruleInfo->sqlFunc = sqlFunc;
 	ruleFunctions = g_slist_append (ruleFunctions, ruleInfo);
 }
 
@@ -223,19 +608,19 @@ rule_init (void)
 {
 	debug_enter ("rule_init");
 
-	/*            in-memory check function	feedlist.opml rule id         		  rule menu label       	positive menu option    negative menu option    has param */
-	/*            ========================================================================================================================================================================================*/
-
-	rule_info_add (rule_check_item_all,		ITEM_MATCH_RULE_ID,		_("Item"),			_("does contain"),	_("does not contain"),	TRUE);
-	rule_info_add (rule_check_item_title,		ITEM_TITLE_MATCH_RULE_ID,	_("Item title"),		_("does contain"),	_("does not contain"),	TRUE);
-	rule_info_add (rule_check_item_description,	ITEM_DESC_MATCH_RULE_ID,	_("Item body"),			_("does contain"),	_("does not contain"),	TRUE);
-	rule_info_add (rule_check_item_is_unread,	"unread",			_("Read status"),		_("is unread"),		_("is read"),		FALSE);
-	rule_info_add (rule_check_item_is_flagged,	"flagged",			_("Flag status"),		_("is flagged"),	_("is unflagged"),	FALSE);
-	rule_info_add (rule_check_item_has_enc,		"enclosure",			_("Podcast"),			_("included"),		_("not included"),	FALSE);
-	rule_info_add (rule_check_item_category,	"category",			_("Category"),			_("is set"),		_("is not set"),	TRUE);
-	rule_info_add (rule_check_feed_title,		FEED_TITLE_MATCH_RULE_ID,	_("Feed title"),		_("does contain"),	_("does not contain"),	TRUE);
-	rule_info_add (rule_check_feed_source,		FEED_SOURCE_MATCH_RULE_ID,	_("Feed source"),		_("does contain"),	_("does not contain"),	TRUE);
-	rule_info_add (rule_check_parent_folder,	PARENT_FOLDER_MATCH_RULE_ID,	_("Parent folder title"),	_("does contain"),	_("does not contain"),	TRUE);
+	/*            in-memory check function	SQL condition			feedlist.opml rule id         		  rule menu label       	positive menu option    negative menu option    has param */
+	/*            ================================================================================================================================================================================================================*/
+
+	rule_info_add (rule_check_item_all,		rule_sql_item_all,		ITEM_MATCH_RULE_ID,		_("Item"),			_("does contain"),	_("does not contain"),	TRUE);
+	rule_info_add (rule_check_item_title,		rule_sql_item_title,		ITEM_TITLE_MATCH_RULE_ID,	_("Item title"),		_("does contain"),	_("does not contain"),	TRUE);
+	rule_info_add (rule_check_item_description,	rule_sql_item_description,	ITEM_DESC_MATCH_RULE_ID,	_("Item body"),			_("does contain"),	_("does not contain"),	TRUE);
+	rule_info_add (rule_check_item_is_unread,	rule_sql_item_is_unread,	"unread",			_("Read status"),		_("is unread"),		_("is read"),		FALSE);
+	rule_info_add (rule_check_item_is_flagged,	rule_sql_item_is_flagged,	"flagged",			_("Flag status"),		_("is flagged"),	_("is unflagged"),	FALSE);
+	rule_info_add (rule_check_item_has_enc,		rule_sql_item_has_enc,		"enclosure",			_("Podcast"),			_("included"),		_("not included"),	FALSE);
+	rule_info_add (rule_check_item_category,	rule_sql_item_category,		"category",			_("Category"),			_("is set"),		_("is not set"),	TRUE);
+	rule_info_add (rule_check_feed_title,		rule_sql_feed_list,		FEED_TITLE_MATCH_RULE_ID,	_("Feed title"),		_("does contain"),	_("does not contain"),	TRUE);
+	rule_info_add (rule_check_feed_source,		rule_sql_feed_list,		FEED_SOURCE_MATCH_RULE_ID,	_("Feed source"),		_("does contain"),	_("does not contain"),	TRUE);
+	rule_info_add (rule_check_parent_folder,	rule_sql_feed_list,		PARENT_FOLDER_MATCH_RULE_ID,	_("Parent folder title"),	_("does contain"),	_("does not contain"),	TRUE);
 
 	debug_exit ("rule_init");
 }
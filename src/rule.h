@@ -34,6 +34,7 @@ typedef struct ruleInfo {
 	gboolean	needsParameter;	/**< some rules may require no parameter... */
 
 	gpointer	checkFunc;	/**< the item check function */
+	gpointer	sqlFunc;	/**< the SQL condition builder (optional) */
 } *ruleInfoPtr;
 
 /** structure to store a rule instance */
@@ -42,10 +43,24 @@ typedef struct rule {
 	gchar		*valueCaseFolded;	/* the value of the rule prepared by g_utf8_casefold() */
 	ruleInfoPtr	ruleInfo;		/* info structure about rule check function */
 	gboolean	additive;		/* is the rule positive logic */
+	gchar		*resultKey;		/* rule id and value, identical for rules with the same result */
 } *rulePtr;
 
+/** per item cache of the values and results shared by all rule checks */
+typedef struct ruleCheckCache {
+	itemPtr		item;			/**< the item to check */
+	gboolean	titleScanned;		/**< TRUE if titleMatches is set */
+	GHashTable	*titleMatches;		/**< text rule values contained in the item title (NULL if no title) */
+	gboolean	descriptionScanned;	/**< TRUE if descriptionMatches is set */
+	GHashTable	*descriptionMatches;	/**< text rule values contained in the item description (NULL if no description) */
+	GHashTable	*results;		/**< memoized rule results (rule result key -> result) */
+} *ruleCheckCachePtr;
+
 /** function type used to check items */
-typedef gboolean (*ruleCheckFunc)	(rulePtr rule, itemPtr item);
+typedef gboolean (*ruleCheckFunc)	(rulePtr rule, ruleCheckCachePtr cache);
+
+/** function type used to build SQL conditions equivalent to a check function */
+typedef gchar *	(*ruleSqlFunc)		(rulePtr rule, GSList **params);
 
 /**
  * Returns a list of rule infos. To be used for rule editor
@@ -75,6 +90,53 @@ rulePtr rule_new (const gchar *ruleId, const gchar *value, gboolean additive);
  */
 void rule_set_value (rulePtr rule, const gchar *value);
 
+/**
+ * Creates a rule check cache for the given item. All rules checked
+ * with the same cache share a single scan of the item title and
+ * description for the values of all text rules, and rules with the
+ * same id and value are evaluated only once. The item
+ * must not be changed while the cache is in use.
+ *
+ * @param item		the item to check
+ *
+ * @returns a new rule check cache (to be free'd using rule_check_cache_free())
+ */
+ruleCheckCachePtr rule_check_cache_new (itemPtr item);
+
+/**
+ * Free's the given rule check cache
+ *
+ * @param cache		the cache to free
+ */
+void rule_check_cache_free (ruleCheckCachePtr cache);
+
+/**
+ * Checks the item of the given cache against the given rule. The
+ * logic (positive or negative) of the rule is not applied.
+ *
+ * @param rule		the rule
+ * @param cache		the rule check cache of the item
+ *
+ * @returns TRUE if the rule check function matches the item
+ */
+gboolean rule_check (rulePtr rule, ruleCheckCachePtr cache);
+
+/**
+ * Translates the given rule into an SQL condition on the "items"
+ * table which is true for all items the check function of the rule
+ * returns TRUE for. The logic (positive or negative) of the rule
+ * is not applied.
+ *
+ * @param rule		the rule
+ * @param params	list to append the values for the '?'
+ *			placeholders of the condition to (strings to
+ *			be free'd with g_free)
+ *
+ * @returns a new SQL condition string, NULL if the rule can
+ *          only be checked in memory
+ */
+gchar * rule_to_sql (rulePtr rule, GSList **params);
+
 /**
  * Free's the given rule structure
  *
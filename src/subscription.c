@@ -32,6 +32,7 @@
 #include "metadata.h"
 #include "net.h"
 #include "subscription_icon.h"
+#include "update_scheduler.h"
 #include "ui/auth_dialog.h"
 #include "ui/feed_list_view.h"
 #include "ui/itemview.h"
@@ -129,6 +130,8 @@ subscription_reset_update_counter (subscriptionPtr subscription, guint64 *now)
 
 	subscription->updateState->lastPoll = *now;
 	debug2 (DEBUG_UPDATE, "Resetting last poll counter of %s to %lld.", subscription->source, subscription->updateState->lastPoll);
+
+	update_scheduler_reschedule (subscription);
 }
 
 /**
@@ -225,23 +228,104 @@ subscription_process_update_result (const struct updateResult * const result, gp
 
 	subscription->updateJob = NULL;
 
-	/* 2. call subscription type specific processing */
+	/* 2. generic update state postprocessing (the result is not
+	      available anymore when processing is done asynchronously) */
+	update_state_set_lastmodified (subscription->updateState, update_state_get_lastmodified (result->updateState));
+	update_state_set_cookies (subscription->updateState, update_state_get_cookies (result->updateState));
+	update_state_set_etag (subscription->updateState, update_state_get_etag (result->updateState));
+	update_state_set_cache_maxage (subscription->updateState, update_state_get_cache_maxage (result->updateState));
+	subscription->updateState->lastPoll = g_get_real_time();
+	update_scheduler_reschedule (subscription);
+
+	/* 3. call subscription type specific processing */
+	if (processing && SUBSCRIPTION_TYPE (subscription)->process_update_result_async) {
+		/* subscription_update_processed() will be called when done */
+		SUBSCRIPTION_TYPE (subscription)->process_update_result_async (subscription, result, flags);
+		return;
+	}
+
 	if (processing)
 		SUBSCRIPTION_TYPE (subscription)->process_update_result (subscription, result, flags);
 
-	/* 3. call favicon updating only after subscription processing
+	subscription_update_processed (subscription, processing);
+}
+
+/* Learns the update interval from the result of the last update:
+   while a feed publishes it is polled twice per publishing period,
+   while it is silent the interval is doubled with every update
+   without new items, but never beyond the silence or the publishing
+   period, whichever is longer. Publisher hints (syn:updatePeriod,
+   ttl) and the configured bounds limit the result. */
+static void
+subscription_adapt_update_interval (subscriptionPtr subscription, gboolean newItems)
+{
+	updateStatePtr	state = subscription->updateState;
+	gint		minInterval, maxInterval;
+	gint64		interval, limit = 0, hint = 0;
+
+	conf_get_int_value (ADAPTIVE_UPDATE_MIN_INTERVAL, &minInterval);
+	conf_get_int_value (ADAPTIVE_UPDATE_MAX_INTERVAL, &maxInterval);
+	minInterval = MAX (minInterval, 1);
+	maxInterval = MAX (maxInterval, minInterval);
+
+	interval = subscription->adaptiveInterval;
+	if (interval <= 0) {
+		gint defaultInterval;
+
+		conf_get_int_value (DEFAULT_UPDATE_INTERVAL, &defaultInterval);
+		interval = defaultInterval;
+	}
+	interval = CLAMP (interval, minInterval, maxInterval);
+
+	if (newItems) {
+		if (state->publishPeriod > 0)
+			interval = state->publishPeriod / 120;
+		else
+			interval /= 2;
+	} else {
+		if (state->publishPeriod > 0)
+			limit = state->publishPeriod / 60;
+		if (state->newestItemTime > 0)
+			limit = MAX (limit, (g_get_real_time () / G_USEC_PER_SEC - state->newestItemTime) / 60);
+
+		if (limit > 0)
+			interval = MAX (interval, MIN (interval * 2, limit));
+		else
+			interval *= 2;
+	}
+
+	if (state->synPeriod > 0)
+		hint = state->synPeriod / MAX (state->synFrequency, 1);
+	hint = MAX (hint, state->timeToLive);
+	interval = MAX (interval, hint);
+
+	interval = CLAMP (interval, minInterval, maxInterval);
+	if (interval == subscription->adaptiveInterval)
+		return;
+
+	debug3 (DEBUG_UPDATE, "Adaptive update interval of %s changes from %d to %d minutes", subscription->source, subscription->adaptiveInterval, (gint)interval);
+	subscription->adaptiveInterval = (gint)interval;
+	update_scheduler_reschedule (subscription);
+	feedlist_schedule_save ();
+}
+
+void
+subscription_update_processed (subscriptionPtr subscription, gboolean processing)
+{
+	nodePtr		node = subscription->node;
+
+	/* Only successful and "not modified" updates tell about the publishing frequency */
+	if (subscription->httpErrorCode >= 200 && subscription->httpErrorCode < 400)
+		subscription_adapt_update_interval (subscription, processing && node->newCount > 0);
+
+	/* 4. call favicon updating only after subscription processing
 	      to ensure we have valid baseUrl for feed nodes...
 
 	      check creation date and update favicon if older than one month */
 	if (g_get_real_time() > (subscription->updateState->lastFaviconPoll + ONE_MONTH_MICROSECONDS))
 		subscription_icon_update (subscription);
 
-	/* 4. generic postprocessing */
-	update_state_set_lastmodified (subscription->updateState, update_state_get_lastmodified (result->updateState));
-	update_state_set_cookies (subscription->updateState, update_state_get_cookies (result->updateState));
-	update_state_set_etag (subscription->updateState, update_state_get_etag (result->updateState));
-	subscription->updateState->lastPoll = g_get_real_time();
-
+	/* 5. UI and DB postprocessing */
 	// FIXME: use signal here
 	itemview_update_node_info (subscription->node);
 	itemview_update ();
@@ -350,9 +434,16 @@ subscription_set_update_interval (subscriptionPtr subscription, gint interval)
 				   interval... */
 	}
 	subscription->updateInterval = interval;
+	update_scheduler_reschedule (subscription);
 	feedlist_schedule_save ();
 }
 
+gint
+subscription_get_adaptive_update_interval (subscriptionPtr subscription)
+{
+	return subscription->adaptiveInterval;
+}
+
 guint
 subscription_get_default_update_interval (subscriptionPtr subscription)
 {
@@ -507,6 +598,10 @@ subscription_import (xmlNodePtr xml, gboolean trusted)
 		subscription_set_update_interval (subscription, common_parse_long (intervalStr, -1));
 		xmlFree (intervalStr);
 
+		intervalStr = xmlGetProp (xml, BAD_CAST "adaptiveInterval");
+		subscription->adaptiveInterval = common_parse_long (intervalStr, 0);
+		xmlFree (intervalStr);
+
 		/* no proxy flag */
 		tmp = xmlGetProp (xml, BAD_CAST "dontUseProxy");
 		if (tmp && !xmlStrcmp (tmp, BAD_CAST "true"))
@@ -539,6 +634,12 @@ subscription_export (subscriptionPtr subscription, xmlNodePtr xml, gboolean trus
 	if(trusted) {
 		xmlNewProp (xml, BAD_CAST"updateInterval", BAD_CAST interval);
 
+		if (subscription->adaptiveInterval > 0) {
+			gchar *adaptiveInterval = g_strdup_printf ("%d", subscription->adaptiveInterval);
+			xmlNewProp (xml, BAD_CAST"adaptiveInterval", BAD_CAST adaptiveInterval);
+			g_free (adaptiveInterval);
+		}
+
 		if (subscription->updateOptions->dontUseProxy)
 			xmlNewProp (xml, BAD_CAST"dontUseProxy", BAD_CAST"true");
 
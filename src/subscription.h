@@ -62,6 +62,7 @@ typedef struct subscription {
 
 	gint		updateInterval;		/**< user defined update interval in minutes */
 	guint		defaultInterval;	/**< optional update interval as specified by the feed in minutes */
+	gint		adaptiveInterval;	/**< update interval learned from the publishing frequency in minutes (or 0) */
 
 	GSList		*metadata;		/**< metadata list assigned to this subscription */
 
@@ -130,6 +131,18 @@ void subscription_to_xml (subscriptionPtr subscription, xmlNodePtr xml);
  */
 void subscription_update (subscriptionPtr subscription, guint flags);
 
+/**
+ * Finishes the processing of a subscription update result: updates
+ * the favicon if necessary, saves the subscription and triggers the
+ * UI notifications. Called automatically after synchronous result
+ * processing, subscription types implementing asynchronous result
+ * processing must call it when they are done.
+ *
+ * @param subscription	the subscription
+ * @param processing	TRUE if the update result was processed
+ */
+void subscription_update_processed (subscriptionPtr subscription, gboolean processing);
+
 /**
  * Called when auto updating. Checks whether the subscription
  * needs to be updated (according to it's update interval) and
@@ -182,6 +195,17 @@ guint subscription_get_default_update_interval(subscriptionPtr subscription);
  */
 void subscription_set_default_update_interval(subscriptionPtr subscription, guint interval);
 
+/**
+ * Get the update interval learned from the publishing frequency
+ * of the given subscription. It is used instead of the global
+ * default update interval when adaptive updating is enabled.
+ *
+ * @param subscription	the subscription
+ *
+ * @returns the adaptive update interval (in minutes) or 0 if unknown
+ */
+gint subscription_get_adaptive_update_interval (subscriptionPtr subscription);
+
 /**
  * Reset the update counter for the given subscription.
  *
@@ -61,6 +61,18 @@ typedef struct subscriptionType {
 	 */
 	void (*process_update_result)(subscriptionPtr subscription, const struct updateResult * const result, updateFlags flags);
 
+	/*
+	 * Optional asynchronous variant of process_update_result. If
+	 * implemented it is used instead of process_update_result and
+	 * must call subscription_update_processed() when done. The
+	 * result is only valid during the call.
+	 *
+	 * @param subscription	the subscription that was updated
+	 * @param result	the update result
+	 * @param flags		the update flags
+	 */
+	void (*process_update_result_async)(subscriptionPtr subscription, const struct updateResult * const result, updateFlags flags);
+
 } *subscriptionTypePtr;
 
 #define SUBSCRIPTION_TYPE(subscription)	(subscription->type)
@@ -0,0 +1,184 @@
+/**
+ * @file item_cache.c  Test cases for the item cache
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <glib.h>
+
+#include "item.h"
+#include "item_cache.h"
+
+static itemPtr
+tc_item_new (gulong id, const gchar *nodeId)
+{
+	itemPtr item = item_new ();
+
+	item->id = id;
+	item->nodeId = g_strdup (nodeId);
+	item->parentNodeId = g_strdup (nodeId);
+
+	return item;
+}
+
+/* Adds a new item to the cache, only the cache keeps a reference */
+static void
+tc_add (gulong id, const gchar *nodeId)
+{
+	itemPtr item = tc_item_new (id, nodeId);
+
+	item_cache_add (item);
+	item_unload (item);
+}
+
+static gboolean
+tc_cached (gulong id)
+{
+	itemPtr item = item_cache_lookup (id);
+
+	if (!item)
+		return FALSE;
+
+	item_unload (item);
+	return TRUE;
+}
+
+static void
+tc_lru (void)
+{
+	guint	hits, misses;
+
+	item_cache_clear ();
+	item_cache_set_size (3);
+
+	tc_add (1, "node");
+	tc_add (2, "node");
+	tc_add (3, "node");
+
+	/* using 1 makes 2 the least recently used item */
+	g_assert_true (tc_cached (1));
+	tc_add (4, "node");
+
+	g_assert_false (tc_cached (2));
+	g_assert_true (tc_cached (1));
+	g_assert_true (tc_cached (3));
+	g_assert_true (tc_cached (4));
+
+	item_cache_get_stats (&hits, &misses);
+	g_assert_cmpuint (hits, ==, 4);
+	g_assert_cmpuint (misses, ==, 1);
+
+	item_cache_set_size (1);
+	g_assert_true (tc_cached (4));
+	g_assert_false (tc_cached (1));
+	g_assert_false (tc_cached (3));
+
+	item_cache_clear ();
+	item_cache_set_size (ITEM_CACHE_SIZE);
+}
+
+static void
+tc_shared (void)
+{
+	itemPtr	item, cached;
+
+	item_cache_clear ();
+
+	item = tc_item_new (1, "node");
+	item_cache_add (item);
+	g_assert_cmpuint (item->refCount, ==, 2);
+
+	/* lookups share the cached instance */
+	cached = item_cache_lookup (1);
+	g_assert_true (cached == item);
+	g_assert_cmpuint (item->refCount, ==, 3);
+	item_unload (cached);
+
+	/* the cache keeps the item alive for the next user */
+	item_unload (item);
+	cached = item_cache_lookup (1);
+	g_assert_nonnull (cached);
+	g_assert_cmpuint (cached->refCount, ==, 2);
+	item_unload (cached);
+
+	item_cache_clear ();
+}
+
+static void
+tc_write_through (void)
+{
+	itemPtr	item, copy, cached;
+
+	item_cache_clear ();
+
+	item = tc_item_new (1, "node");
+	item_cache_add (item);
+
+	/* state changes of other instances are copied */
+	copy = tc_item_new (1, "node");
+	copy->readStatus = TRUE;
+	copy->flagStatus = TRUE;
+	item_cache_item_state_updated (copy);
+	g_assert_true (item->readStatus);
+	g_assert_true (item->flagStatus);
+
+	/* writing the cached instance keeps it */
+	item_cache_item_updated (item);
+	g_assert_true (tc_cached (1));
+
+	/* writing another instance drops the cached one */
+	item_cache_item_updated (copy);
+	g_assert_false (tc_cached (1));
+	g_assert_cmpuint (item->refCount, ==, 1);
+
+	item_unload (copy);
+	item_unload (item);
+
+	/* removing an item drops its comments */
+	tc_add (1, "node");
+	cached = tc_item_new (2, "comments");
+	cached->isComment = TRUE;
+	cached->parentItemId = 1;
+	item_cache_add (cached);
+	item_unload (cached);
+	tc_add (3, "node");
+
+	item_cache_item_removed (1);
+	g_assert_false (tc_cached (1));
+	g_assert_false (tc_cached (2));
+	g_assert_true (tc_cached (3));
+
+	/* node changes drop all items of the node */
+	tc_add (4, "other");
+	item_cache_node_changed ("node");
+	g_assert_false (tc_cached (3));
+	g_assert_true (tc_cached (4));
+
+	item_cache_clear ();
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/item_cache/lru", &tc_lru);
+	g_test_add_func ("/item_cache/shared", &tc_shared);
+	g_test_add_func ("/item_cache/write_through", &tc_write_through);
+
+	return g_test_run();
+}
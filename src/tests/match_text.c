@@ -0,0 +1,136 @@
+/**
+ * @file match_text.c  Test cases for the multi pattern text matcher
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "text_matcher.h"
+
+typedef struct tc {
+	const gchar	*patterns[8];	/* NULL terminated */
+	const gchar	*text;
+	gboolean	expected[8];
+} *tcPtr;
+
+struct tc tc_simple	= { { "feed", "liferea", NULL }, "liferea reads feeds", { TRUE, TRUE } };
+struct tc tc_none	= { { "rss", "atom", NULL }, "nothing to see", { FALSE, FALSE } };
+struct tc tc_overlap	= { { "he", "she", "his", "hers", NULL }, "ushers", { TRUE, TRUE, FALSE, TRUE } };
+struct tc tc_suffix	= { { "abcd", "bc", "c", NULL }, "xabcx", { FALSE, TRUE, TRUE } };
+struct tc tc_utf8	= { { "straße", "ß", "über", NULL }, "die straße über", { TRUE, TRUE, TRUE } };
+struct tc tc_empty	= { { "a", NULL }, "", { FALSE } };
+
+static void
+tc_match (gconstpointer user_data)
+{
+	tcPtr		tc = (tcPtr)user_data;
+	textMatcherPtr	matcher;
+	gboolean	found[8] = { FALSE };
+	guint		i, count = 0;
+
+	while (tc->patterns[count])
+		count++;
+
+	matcher = text_matcher_new (tc->patterns, count);
+	g_assert_cmpuint (text_matcher_get_count (matcher), ==, count);
+	text_matcher_scan (matcher, tc->text, found);
+	for (i = 0; i < count; i++)
+		g_assert_cmpint (found[i], ==, tc->expected[i]);
+	text_matcher_free (matcher);
+}
+
+/* Compares the matcher with strstr() on random texts from a small
+   alphabet, so that patterns overlap and share prefixes a lot */
+static void
+tc_random (void)
+{
+	GRand	*rand = g_rand_new_with_seed (1);
+	guint	round;
+
+	for (round = 0; round < 2000; round++) {
+		GPtrArray	*patterns = g_ptr_array_new_with_free_func (g_free);
+		textMatcherPtr	matcher;
+		gboolean	*found;
+		gchar		*text[2];
+		guint		i, j, count, newly;
+
+		count = g_rand_int_range (rand, 0, 20);
+		for (i = 0; i < count; i++) {
+			gchar	*pattern = g_strnfill (g_rand_int_range (rand, 1, 6), 'a');
+			gboolean duplicate = FALSE;
+
+			for (j = 0; pattern[j]; j++)
+				pattern[j] = 'a' + g_rand_int_range (rand, 0, 3);
+			for (j = 0; j < patterns->len; j++)
+				duplicate |= g_str_equal (pattern, g_ptr_array_index (patterns, j));
+
+			if (duplicate)
+				g_free (pattern);
+			else
+				g_ptr_array_add (patterns, pattern);
+		}
+
+		for (i = 0; i < 2; i++) {
+			text[i] = g_strnfill (g_rand_int_range (rand, 0, 40), 'a');
+			for (j = 0; text[i][j]; j++)
+				text[i][j] = 'a' + g_rand_int_range (rand, 0, 3);
+		}
+
+		/* scanning two texts with the same result array
+		   must find the patterns of both texts */
+		matcher = text_matcher_new ((const gchar **)patterns->pdata, patterns->len);
+		found = g_new0 (gboolean, patterns->len + 1);
+		newly = text_matcher_scan (matcher, text[0], found);
+		newly += text_matcher_scan (matcher, text[1], found);
+
+		count = 0;
+		for (i = 0; i < patterns->len; i++) {
+			const gchar *pattern = g_ptr_array_index (patterns, i);
+			gboolean expected = (strstr (text[0], pattern) || strstr (text[1], pattern));
+
+			g_assert_cmpint (found[i], ==, expected);
+			count += expected?1:0;
+		}
+		g_assert_cmpuint (newly, ==, count);
+
+		text_matcher_free (matcher);
+		g_free (found);
+		g_free (text[0]);
+		g_free (text[1]);
+		g_ptr_array_free (patterns, TRUE);
+	}
+
+	g_rand_free (rand);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_data_func ("/match_text/simple", &tc_simple, &tc_match);
+	g_test_add_data_func ("/match_text/none", &tc_none, &tc_match);
+	g_test_add_data_func ("/match_text/overlap", &tc_overlap, &tc_match);
+	g_test_add_data_func ("/match_text/suffix", &tc_suffix, &tc_match);
+	g_test_add_data_func ("/match_text/utf8", &tc_utf8, &tc_match);
+	g_test_add_data_func ("/match_text/empty", &tc_empty, &tc_match);
+	g_test_add_func ("/match_text/random", &tc_random);
+
+	return g_test_run();
+}
@@ -0,0 +1,469 @@
+/**
+ * @file merge_items.c  Test cases for item merging
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "conf.h"
+#include "db.h"
+#include "item.h"
+#include "item_cache.h"
+#include "itemset.h"
+
+typedef struct tc {
+	guint		oldCount;	/* number of existing items */
+	guint		newCount;	/* number of downloaded items */
+	guint		idlessRatio;	/* every n-th item has no id */
+	guint		seed;
+	gboolean	allowUpdates;	/* merge the downloaded items with updates */
+} *tcPtr;
+
+struct tc tc_small	= { 10, 10, 3, 1 };
+struct tc tc_ids	= { 5000, 500, 0, 2 };
+struct tc tc_idless	= { 2000, 300, 1, 3 };
+struct tc tc_mixed	= { 5000, 500, 4, 4 };
+struct tc tc_updates	= { 3000, 1000, 4, 5, TRUE };
+struct tc tc_no_updates	= { 3000, 1000, 4, 6, FALSE };
+
+/* Item state merge rules checked with itemset_generic_merge_check() */
+typedef struct tcState {
+	gboolean	allowUpdates;
+	gboolean	allowStateChanges;
+	gboolean	oldRead, oldFlag;	/* state of the existing item */
+	const gchar	*newTitle;		/* title of the downloaded item */
+	gboolean	newRead, newFlag;	/* state of the downloaded item */
+	const gchar	*expectedTitle;		/* resulting item in the DB */
+	gboolean	expectedRead, expectedFlag;
+} *tcStatePtr;
+
+struct tcState tc_state_ignored		= { TRUE, FALSE, FALSE, FALSE, "Title", TRUE, TRUE, "Title", FALSE, FALSE };
+struct tcState tc_state_read		= { TRUE, TRUE, FALSE, FALSE, "Title", TRUE, FALSE, "Title", TRUE, FALSE };
+struct tcState tc_state_never_unread	= { TRUE, TRUE, TRUE, FALSE, "Title", FALSE, FALSE, "Title", TRUE, FALSE };
+struct tcState tc_state_flag		= { TRUE, TRUE, FALSE, FALSE, "Title", FALSE, TRUE, "Title", FALSE, TRUE };
+struct tcState tc_state_unflag		= { TRUE, TRUE, FALSE, TRUE, "Title", FALSE, FALSE, "Title", FALSE, FALSE };
+struct tcState tc_state_no_updates	= { FALSE, TRUE, FALSE, FALSE, "Title", TRUE, TRUE, "Title", FALSE, FALSE };
+struct tcState tc_content		= { TRUE, FALSE, TRUE, TRUE, "New title", FALSE, FALSE, "New title", TRUE, TRUE };
+struct tcState tc_content_no_updates	= { FALSE, FALSE, FALSE, FALSE, "New title", FALSE, FALSE, "Title", FALSE, FALSE };
+struct tcState tc_content_and_state	= { TRUE, TRUE, FALSE, TRUE, "New title", TRUE, FALSE, "New title", TRUE, FALSE };
+
+/* temporary directory for the DB used by the merge test cases */
+static gchar *tmpDir = NULL;
+
+/* The linear merge comparison loop as used before the merge index
+   was introduced. The index must find exactly the same items. */
+static itemPtr
+reference_find (GList *items, itemPtr newItem)
+{
+	GList	*iter;
+
+	for (iter = items; iter; iter = g_list_next (iter)) {
+		itemPtr		oldItem = (itemPtr)iter->data;
+		gboolean	equal = TRUE;
+
+		if (((item_get_id (oldItem) == NULL) && (item_get_id (newItem) != NULL)) ||
+		    ((item_get_id (oldItem) != NULL) && (item_get_id (newItem) == NULL)))
+			continue;
+
+		if (((item_get_title (oldItem) != NULL) && (item_get_title (newItem) != NULL)) &&
+		     (0 != strcmp (item_get_title (oldItem), item_get_title (newItem))))
+			equal = FALSE;
+
+		if (((item_get_description (oldItem) != NULL) && (item_get_description (newItem) != NULL)) &&
+		     (0 != strcmp (item_get_description (oldItem), item_get_description (newItem))))
+			equal = FALSE;
+
+		if (item_get_id (oldItem)) {
+			if (0 == strcmp (item_get_id (oldItem), item_get_id (newItem)))
+				return oldItem;
+			continue;
+		}
+
+		if (equal)
+			return oldItem;
+	}
+
+	return NULL;
+}
+
+/* Creates items from a small value range so that there are many
+   duplicate ids, titles and descriptions as well as missing titles */
+static itemPtr
+tc_random_item (GRand *rand, guint idlessRatio)
+{
+	itemPtr item = item_new ();
+
+	if (0 == idlessRatio || 0 != g_rand_int_range (rand, 0, idlessRatio))
+		item->sourceId = g_strdup_printf ("id-%d", g_rand_int_range (rand, 0, 8000));
+
+	if (g_rand_int_range (rand, 0, 20))
+		item->title = g_strdup_printf ("Title %d", g_rand_int_range (rand, 0, 400));
+
+	if (g_rand_int_range (rand, 0, 50))
+		item->description = g_strdup_printf ("<p>Description %d</p>", g_rand_int_range (rand, 0, 400));
+
+	return item;
+}
+
+static void
+tc_merge_index (gconstpointer user_data)
+{
+	tcPtr			tc = (tcPtr)user_data;
+	GRand			*rand = g_rand_new_with_seed (tc->seed);
+	GList			*items = NULL, *headers = NULL, *newItems = NULL, *iter;
+	GHashTable		*headerToItem;
+	itemSetMergeIndexPtr	index;
+	guint			i;
+
+	headerToItem = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (i = 0; i < tc->oldCount; i++) {
+		itemPtr item = tc_random_item (rand, tc->idlessRatio);
+		itemHeaderPtr header = item_header_from_item (item);
+
+		/* items in the cache always have a description */
+		if (!item->description)
+			item->description = g_strdup ("");
+		if (!header->descriptionHash)
+			header->descriptionHash = item_get_description_hash ("");
+
+		items = g_list_prepend (items, item);
+		headers = g_list_prepend (headers, header);
+		g_hash_table_insert (headerToItem, header, item);
+	}
+	for (i = 0; i < tc->newCount; i++)
+		newItems = g_list_prepend (newItems, tc_random_item (rand, tc->idlessRatio));
+
+	index = itemset_merge_index_new (headers);
+
+	/* Same order as itemset_merge_items(): bottom to top, newly
+	   added items are put in front of the existing items */
+	for (iter = g_list_last (newItems); iter; iter = g_list_previous (iter)) {
+		itemPtr		newItem = (itemPtr)iter->data;
+		itemPtr		expected = reference_find (items, newItem);
+		itemHeaderPtr	newHeader = item_header_from_item (newItem);
+		itemHeaderPtr	found = itemset_merge_index_lookup (index, newHeader);
+
+		g_assert_true (expected == (found?g_hash_table_lookup (headerToItem, found):NULL));
+
+		if (!expected) {
+			items = g_list_prepend (items, newItem);
+			headers = g_list_prepend (headers, newHeader);
+			g_hash_table_insert (headerToItem, newHeader, newItem);
+			itemset_merge_index_add (index, newHeader);
+		} else {
+			item_header_free (newHeader);
+			item_unload (newItem);
+		}
+	}
+
+	itemset_merge_index_free (index);
+	g_hash_table_destroy (headerToItem);
+	g_list_free_full (headers, (GDestroyNotify)item_header_free);
+	g_list_free_full (items, (GDestroyNotify)item_unload);
+	g_list_free (newItems);
+	g_rand_free (rand);
+}
+
+/* Like tc_random_item() but with the title and description every
+   item in the DB has, and with a random state */
+static itemPtr
+tc_random_db_item (GRand *rand, guint idlessRatio)
+{
+	itemPtr item = tc_random_item (rand, idlessRatio);
+
+	if (!item->title)
+		item->title = g_strdup ("Title");
+	if (!item->description)
+		item->description = g_strdup ("");
+
+	item->readStatus = g_rand_boolean (rand);
+	item->flagStatus = g_rand_boolean (rand);
+
+	return item;
+}
+
+/* Copies everything the merge decides on, the copies are
+   used to track the expected contents of the item set */
+static itemPtr
+tc_item_clone (itemPtr item)
+{
+	itemPtr clone = item_new ();
+
+	clone->sourceId = g_strdup (item->sourceId);
+	clone->title = g_strdup (item->title);
+	clone->description = g_strdup (item->description);
+	clone->readStatus = item->readStatus;
+	clone->flagStatus = item->flagStatus;
+
+	return clone;
+}
+
+/* Merges a batch of random items using itemset_merge_items() and
+   applies the expected merge decisions to the expected item list */
+static void
+tc_merge_batch (itemSetPtr itemSet, GList **expected, GRand *rand, guint count, guint idlessRatio, gboolean allowUpdates)
+{
+	GList		*list = NULL, *iter;
+	GHashTable	*added;
+	GHashTableIter	hiter;
+	gpointer	clone, item;
+	guint		i, expectedNew = 0;
+
+	for (i = 0; i < count; i++)
+		list = g_list_prepend (list, tc_random_db_item (rand, idlessRatio));
+
+	/* Same order as itemset_merge_items(): bottom to top, newly
+	   added items are put in front of the existing items. Without
+	   node state changes are not allowed, so only the contents of
+	   existing items are updated. */
+	added = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (iter = g_list_last (list); iter; iter = g_list_previous (iter)) {
+		itemPtr	newItem = (itemPtr)iter->data;
+		itemPtr	newClone = tc_item_clone (newItem);
+		itemPtr	oldItem = reference_find (*expected, newClone);
+
+		if (!oldItem) {
+			*expected = g_list_prepend (*expected, newClone);
+			g_hash_table_insert (added, newClone, item_ref (newItem));
+			expectedNew++;
+			continue;
+		}
+
+		if (allowUpdates &&
+		    (g_strcmp0 (oldItem->title, newClone->title) ||
+		     g_strcmp0 (oldItem->description, newClone->description))) {
+			g_free (oldItem->title);
+			oldItem->title = g_strdup (newClone->title);
+			g_free (oldItem->description);
+			oldItem->description = g_strdup (newClone->description);
+		}
+		item_unload (newClone);
+	}
+
+	g_assert_cmpuint (itemset_merge_items (itemSet, list, allowUpdates, FALSE), ==, expectedNew);
+
+	/* the ids are only known after writing to the DB */
+	g_hash_table_iter_init (&hiter, added);
+	while (g_hash_table_iter_next (&hiter, &clone, &item)) {
+		((itemPtr)clone)->id = ((itemPtr)item)->id;
+		item_unload ((itemPtr)item);
+	}
+	g_hash_table_destroy (added);
+}
+
+/* Checks the item set and the items in the DB against the expected items */
+static void
+tc_check_db (itemSetPtr itemSet, GList *expected)
+{
+	GList	*items, *iter;
+
+	g_assert_cmpuint (g_list_length (itemSet->ids), ==, g_list_length (expected));
+
+	/* load from the DB and not the cache */
+	item_cache_clear ();
+	items = itemset_load_items (itemSet->ids);
+	g_assert_cmpuint (g_list_length (items), ==, g_list_length (expected));
+
+	for (iter = items; iter; iter = g_list_next (iter), expected = g_list_next (expected)) {
+		itemPtr	item = (itemPtr)iter->data;
+		itemPtr	expectedItem = (itemPtr)expected->data;
+
+		g_assert_cmpuint (item->id, ==, expectedItem->id);
+		g_assert_cmpstr (item->sourceId, ==, expectedItem->sourceId);
+		g_assert_cmpstr (item->title, ==, expectedItem->title);
+		g_assert_cmpstr (item->description, ==, expectedItem->description);
+		g_assert_cmpint (item->readStatus, ==, expectedItem->readStatus);
+		g_assert_cmpint (item->flagStatus, ==, expectedItem->flagStatus);
+	}
+
+	g_list_free_full (items, (GDestroyNotify)item_unload);
+}
+
+static void
+tc_merge_items (gconstpointer user_data)
+{
+	tcPtr		tc = (tcPtr)user_data;
+	GRand		*rand = g_rand_new_with_seed (tc->seed);
+	itemSetPtr	itemSet = g_new0 (struct itemSet, 1);
+	GList		*expected = NULL;
+	gchar		*nodeId;
+
+	/* no such node exists, so item state changes are not allowed */
+	nodeId = g_strdup_printf ("merge-items-%u", tc->seed);
+	itemSet->nodeId = nodeId;
+
+	tc_merge_batch (itemSet, &expected, rand, tc->oldCount, tc->idlessRatio, TRUE);
+	tc_check_db (itemSet, expected);
+
+	tc_merge_batch (itemSet, &expected, rand, tc->newCount, tc->idlessRatio, tc->allowUpdates);
+	tc_check_db (itemSet, expected);
+
+	g_list_free_full (expected, (GDestroyNotify)item_unload);
+	itemset_free (itemSet);
+	g_free (nodeId);
+	g_rand_free (rand);
+}
+
+static itemPtr
+tc_state_item (const gchar *sourceId, const gchar *title, gboolean read, gboolean flag)
+{
+	itemPtr item = item_new ();
+
+	item->sourceId = g_strdup (sourceId);
+	item->title = g_strdup (title);
+	item->description = g_strdup ("<p>Description</p>");
+	item->readStatus = read;
+	item->flagStatus = flag;
+
+	return item;
+}
+
+static void
+tc_merge_state (gconstpointer user_data)
+{
+	tcStatePtr		tc = (tcStatePtr)user_data;
+	itemSetMergeIndexPtr	index;
+	GList			*headers;
+	itemPtr			item;
+	gulong			id;
+
+	item = tc_state_item ("state-id", "Title", tc->oldRead, tc->oldFlag);
+	item->nodeId = g_strdup ("merge-state");
+	item->parentNodeId = g_strdup ("merge-state");
+	db_item_update (item);
+	id = item->id;
+	item_unload (item);
+
+	headers = db_item_headers_load_many (&id, 1);
+	index = itemset_merge_index_new (headers);
+
+	/* existing items are never added again... */
+	item = tc_state_item ("state-id", tc->newTitle, tc->newRead, tc->newFlag);
+	g_assert_false (itemset_generic_merge_check (index, item, tc->allowUpdates, tc->allowStateChanges));
+	item_unload (item);
+
+	/* ...but unknown items are */
+	item = tc_state_item ("other-id", "Title", FALSE, FALSE);
+	g_assert_true (itemset_generic_merge_check (index, item, tc->allowUpdates, tc->allowStateChanges));
+	item_unload (item);
+
+	itemset_merge_index_free (index);
+	g_list_free_full (headers, (GDestroyNotify)item_header_free);
+
+	item_cache_clear ();
+	item = item_load (id);
+	g_assert_nonnull (item);
+	g_assert_cmpstr (item->title, ==, tc->expectedTitle);
+	g_assert_cmpint (item->readStatus, ==, tc->expectedRead);
+	g_assert_cmpint (item->flagStatus, ==, tc->expectedFlag);
+	item_unload (item);
+}
+
+static void
+tc_remove_dir (const gchar *path)
+{
+	GDir		*dir;
+	const gchar	*name;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir) {
+		while ((name = g_dir_read_name (dir))) {
+			gchar *child = g_build_filename (path, name, NULL);
+
+			if (g_file_test (child, G_FILE_TEST_IS_DIR))
+				tc_remove_dir (child);
+			else
+				g_remove (child);
+			g_free (child);
+		}
+		g_dir_close (dir);
+	}
+	g_rmdir (path);
+}
+
+/* Sets up a temporary DB, the settings are kept in memory using
+   the schema compiled into the test directory */
+static void
+tc_db_init (void)
+{
+	gchar	*convertFile;
+
+	tmpDir = g_dir_make_tmp ("liferea-merge-items-XXXXXX", NULL);
+	g_assert_nonnull (tmpDir);
+
+	/* must be set before GLib determines the user directories */
+	g_setenv ("XDG_DATA_HOME", tmpDir, TRUE);
+	g_setenv ("XDG_CACHE_HOME", tmpDir, TRUE);
+	g_setenv ("XDG_CONFIG_HOME", tmpDir, TRUE);
+	g_setenv ("GSETTINGS_BACKEND", "memory", TRUE);
+	g_setenv ("GSETTINGS_SCHEMA_DIR", TEST_SCHEMA_DIR, TRUE);
+
+	/* there is nothing to migrate from gconf */
+	convertFile = g_build_filename (tmpDir, "gsettings-data-convert", NULL);
+	g_file_set_contents (convertFile, "[State]\nconverted=net.sf.liferea\n", -1, NULL);
+	g_free (convertFile);
+
+	conf_init ();
+	db_init ();
+}
+
+static void
+tc_db_deinit (void)
+{
+	item_cache_clear ();
+	db_deinit ();
+	conf_deinit ();
+	tc_remove_dir (tmpDir);
+	g_free (tmpDir);
+}
+
+int
+main (int argc, char *argv[])
+{
+	gint	result;
+
+	g_test_init (&argc, &argv, NULL);
+	tc_db_init ();
+
+	g_test_add_data_func ("/merge_items/small", &tc_small, &tc_merge_index);
+	g_test_add_data_func ("/merge_items/ids", &tc_ids, &tc_merge_index);
+	g_test_add_data_func ("/merge_items/idless", &tc_idless, &tc_merge_index);
+	g_test_add_data_func ("/merge_items/mixed", &tc_mixed, &tc_merge_index);
+
+	g_test_add_data_func ("/merge_items/merge/updates", &tc_updates, &tc_merge_items);
+	g_test_add_data_func ("/merge_items/merge/no_updates", &tc_no_updates, &tc_merge_items);
+
+	g_test_add_data_func ("/merge_items/state/ignored", &tc_state_ignored, &tc_merge_state);
+	g_test_add_data_func ("/merge_items/state/read", &tc_state_read, &tc_merge_state);
+	g_test_add_data_func ("/merge_items/state/never_unread", &tc_state_never_unread, &tc_merge_state);
+	g_test_add_data_func ("/merge_items/state/flag", &tc_state_flag, &tc_merge_state);
+	g_test_add_data_func ("/merge_items/state/unflag", &tc_state_unflag, &tc_merge_state);
+	g_test_add_data_func ("/merge_items/state/no_updates", &tc_state_no_updates, &tc_merge_state);
+	g_test_add_data_func ("/merge_items/content/update", &tc_content, &tc_merge_state);
+	g_test_add_data_func ("/merge_items/content/no_updates", &tc_content_no_updates, &tc_merge_state);
+	g_test_add_data_func ("/merge_items/content/and_state", &tc_content_and_state, &tc_merge_state);
+
+	result = g_test_run ();
+
+	tc_db_deinit ();
+
+	return result;
+}
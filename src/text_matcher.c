@@ -0,0 +1,154 @@
+/**
+ * @file text_matcher.c  multi pattern substring matching
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "text_matcher.h"
+
+#include <string.h>
+
+#define TEXT_MATCHER_NONE	G_MAXUINT32
+
+/* The automaton is stored as a complete transition table with 256
+   entries per state, so scanning takes exactly one lookup per byte.
+   The number of states is bounded by the total pattern length. */
+struct textMatcher {
+	guint		count;		/**< number of patterns */
+	guint		states;		/**< number of states */
+	guint32		*delta;		/**< transition table (states * 256) */
+	gint		*pattern;	/**< pattern ending in a state or -1 */
+	guint32		*output;	/**< next state on the failure chain with a pattern */
+};
+
+textMatcherPtr
+text_matcher_new (const gchar **patterns, guint count)
+{
+	textMatcherPtr	matcher;
+	guint32		*fail, *queue;
+	guint		i, max = 1, head = 0, tail = 0;
+
+	for (i = 0; i < count; i++)
+		max += strlen (patterns[i]);
+
+	matcher = g_new0 (struct textMatcher, 1);
+	matcher->count = count;
+	matcher->states = 1;
+	matcher->delta = g_new0 (guint32, max * 256);
+	matcher->pattern = g_new (gint, max);
+	matcher->output = g_new (guint32, max);
+	matcher->pattern[0] = -1;
+	matcher->output[0] = TEXT_MATCHER_NONE;
+
+	/* 1. Build the trie of all patterns (0 means no child yet
+	      as no transition leads back to the root in a trie) */
+	for (i = 0; i < count; i++) {
+		const guchar	*c;
+		guint32		state = 0;
+
+		for (c = (const guchar *)patterns[i]; *c; c++) {
+			if (!matcher->delta[state * 256 + *c]) {
+				guint32 new = matcher->states++;
+				matcher->pattern[new] = -1;
+				matcher->output[new] = TEXT_MATCHER_NONE;
+				matcher->delta[state * 256 + *c] = new;
+			}
+			state = matcher->delta[state * 256 + *c];
+		}
+
+		g_assert (state != 0);
+		matcher->pattern[state] = i;
+	}
+
+	/* 2. Add failure transitions in breadth first order, so the
+	      failure state of each state is already complete */
+	fail = g_new0 (guint32, matcher->states);
+	queue = g_new (guint32, matcher->states);
+	queue[tail++] = 0;
+	while (head < tail) {
+		guint32	state = queue[head++];
+		guint	c;
+
+		for (c = 0; c < 256; c++) {
+			guint32 child = matcher->delta[state * 256 + c];
+
+			if (child) {
+				/* trie child: its failure state is where the
+				   failure state of the parent continues */
+				if (0 == state)
+					fail[child] = 0;
+				else
+					fail[child] = matcher->delta[fail[state] * 256 + c];
+
+				if (-1 != matcher->pattern[fail[child]])
+					matcher->output[child] = fail[child];
+				else
+					matcher->output[child] = matcher->output[fail[child]];
+
+				queue[tail++] = child;
+			} else if (0 != state) {
+				matcher->delta[state * 256 + c] = matcher->delta[fail[state] * 256 + c];
+			}
+		}
+	}
+	g_free (queue);
+	g_free (fail);
+
+	matcher->delta = g_renew (guint32, matcher->delta, matcher->states * 256);
+
+	return matcher;
+}
+
+guint
+text_matcher_get_count (textMatcherPtr matcher)
+{
+	return matcher->count;
+}
+
+guint
+text_matcher_scan (textMatcherPtr matcher, const gchar *text, gboolean *found)
+{
+	const guchar	*c;
+	guint32		state = 0;
+	guint		result = 0;
+
+	for (c = (const guchar *)text; *c; c++) {
+		guint32	match;
+
+		state = matcher->delta[state * 256 + *c];
+
+		/* Report all patterns ending here. If a pattern was found
+		   before the rest of its output chain was reported too. */
+		match = (-1 != matcher->pattern[state])?state:matcher->output[state];
+		while (TEXT_MATCHER_NONE != match && !found[matcher->pattern[match]]) {
+			found[matcher->pattern[match]] = TRUE;
+			result++;
+			match = matcher->output[match];
+		}
+	}
+
+	return result;
+}
+
+void
+text_matcher_free (textMatcherPtr matcher)
+{
+	g_free (matcher->delta);
+	g_free (matcher->pattern);
+	g_free (matcher->output);
+	g_free (matcher);
+}
@@ -0,0 +1,74 @@
+/**
+ * @file text_matcher.h  multi pattern substring matching
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _TEXT_MATCHER_H
+#define _TEXT_MATCHER_H
+
+#include <glib.h>
+
+/* A text matcher finds all occurrences of many patterns in a single
+   pass over a text (Aho-Corasick automaton). Patterns and texts are
+   compared byte-wise, so both need to be case folded beforehand for
+   case insensitive matching. */
+
+typedef struct textMatcher *textMatcherPtr;
+
+/**
+ * Compiles a text matcher for the given patterns. The patterns
+ * are identified by their position in the array.
+ *
+ * @param patterns	array of distinct non-empty patterns
+ * @param count		number of patterns
+ *
+ * @returns a new text matcher (to be free'd using text_matcher_free())
+ */
+textMatcherPtr text_matcher_new (const gchar **patterns, guint count);
+
+/**
+ * Returns the number of patterns of the given matcher.
+ *
+ * @param matcher	the text matcher
+ *
+ * @returns number of patterns
+ */
+guint text_matcher_get_count (textMatcherPtr matcher);
+
+/**
+ * Searches all patterns in the given text.
+ *
+ * @param matcher	the text matcher
+ * @param text		the text to search
+ * @param found		array with one entry per pattern, set to TRUE for
+ *			all patterns contained in the text (other entries
+ *			are not changed). Must be initialized with FALSE,
+ *			but may be reused for scanning several texts.
+ *
+ * @returns the number of entries newly set to TRUE
+ */
+guint text_matcher_scan (textMatcherPtr matcher, const gchar *text, gboolean *found);
+
+/**
+ * Free's the given text matcher.
+ *
+ * @param matcher	the text matcher
+ */
+void text_matcher_free (textMatcherPtr matcher);
+
+#endif
@@ -33,6 +33,7 @@
 #include "common.h"
 #include "conf.h"
 #include "date.h"
+#include "db.h"
 #include "debug.h"
 #include "feed.h"
 #include "feedlist.h"
@@ -49,6 +50,9 @@
 #include "ui/popup_menu.h"
 #include "ui/ui_common.h"
 
+/* Maximum number of cached wide view teasers, a multiple of the rows fitting on screen */
+#define ITEM_LIST_VIEW_MAX_TEASERS	500
+
 /*
  * Important performance considerations: Early versions had performance problems
  * with the item list loading because of the following two problems:
@@ -59,13 +63,18 @@
  * To avoid both problems we merge against a visible tree store only for single
  * items that are added/removed by background updates and load complete feeds or
  * collections of feeds only by adding items to a new unattached tree store.
+ *
+ * Additionally the tree store only keeps the raw item values. Date strings
+ * and the wide view markup are rendered by cell data functions which are
+ * only called for visible rows. The wide view teasers need the item
+ * description, they are loaded in batches for the visible rows only and
+ * kept in a cache of limited size.
  */
 
 /* Enumeration of the columns in the itemstore. */
 enum is_columns {
 	IS_TIME,		/*<< Time of item creation */
-	IS_TIME_STR,		/*<< Time of item creation as a string*/
-	IS_LABEL,		/*<< Displayed name */
+	IS_LABEL,		/*<< Displayed name (escaped item title) */
 	IS_STATEICON,		/*<< Pixbuf reference to the item's state icon */
 	IS_NR,			/*<< Item id, to lookup item ptr from parent feed */
 	IS_PARENT,		/*<< Parent node pointer */
@@ -122,12 +131,15 @@ struct _ItemListView {
 
 	GtkTreeView	*treeview;
 	GtkWidget 	*ilscrolledwindow;	/*<< The complete ItemListView widget */
-	GSList		*item_ids;		/*<< list of all currently known item ids */
+	GHashTable	*item_ids;		/*<< hash of all currently known item ids (item id -> GtkTreeIter) */
 
 	gboolean	batch_mode;		/*<< TRUE if we are in batch adding mode */
 	GtkTreeStore	*batch_itemstore;	/*<< GtkTreeStore prepared unattached and to be set on update() */
 
 	GHashTable	*columns;               /*<< Named GtkTreeViewColumns */
+	GHashTable	*teasers;		/*<< Wide view teasers of recently rendered items (item id -> teaser) */
+	GHashTable	*pendingTeasers;	/*<< Ids of rendered items whose teaser is to be loaded */
+	guint		teaserLoadId;		/*<< Idle source loading the pending teasers */
 
 	gboolean	wideView;		/*<< TRUE if date has to be rendered into headline column (because date column is invisible) */
 };
@@ -143,8 +155,12 @@ item_list_view_finalize (GObject *object)
 	g_signal_handlers_disconnect_by_data (G_OBJECT (ilv->treeview), object);
 
 	g_hash_table_destroy (ilv->columns);
+	if (ilv->teaserLoadId)
+		g_source_remove (ilv->teaserLoadId);
+	g_hash_table_destroy (ilv->teasers);
+	g_hash_table_destroy (ilv->pendingTeasers);
 
-	g_slist_free (ilv->item_ids);
+	g_hash_table_destroy (ilv->item_ids);
 	if (ilv->batch_itemstore)
 		g_object_unref (ilv->batch_itemstore);
 	if (ilv->ilscrolledwindow)
@@ -173,47 +189,36 @@ item_list_view_iter_to_id (ItemListView *ilv, GtkTreeIter *iter)
 gboolean
 item_list_view_contains_id (ItemListView *ilv, gulong id)
 {
-	return (NULL != g_slist_find (ilv->item_ids, GUINT_TO_POINTER (id)));
+	return g_hash_table_contains (ilv->item_ids, GUINT_TO_POINTER (id));
+}
+
+/* Returns the tree store all known items are in. In batch mode
+   this is the unattached batch_itemstore, otherwise the store
+   attached to the GtkTreeView. */
+static GtkTreeStore *
+item_list_view_get_item_store (ItemListView *ilv)
+{
+	if (ilv->batch_mode)
+		return ilv->batch_itemstore;
+
+	return GTK_TREE_STORE (gtk_tree_view_get_model (ilv->treeview));
 }
 
+/* The item id hash keeps the GtkTreeIter of every item. This works
+   because GtkTreeStore iters persist as long as the row exists, also
+   when rows are sorted, inserted or removed. Only clearing the store
+   invalidates them and then the hash is cleared too. */
 static gboolean
 item_list_view_id_to_iter (ItemListView *ilv, gulong id, GtkTreeIter *iter)
 {
-	gboolean        valid;
-	GtkTreeIter		old_iter;
-	GtkTreeModel    *model;
+	GtkTreeIter	*known;
 
-	/* Problem here is batch insertion using batch_itemstore
-	   so the item can be in the GtkTreeView attached store or
-	    in the batch_itemstore */
-
-	if (item_list_view_contains_id (ilv, id)) {
-		/* First search the tree view */
-		model = gtk_tree_view_get_model (ilv->treeview);
-		valid = gtk_tree_model_get_iter_first (model, &old_iter);
-		while (valid) {
-		        gulong current_id = item_list_view_iter_to_id (ilv, &old_iter);
-	                if(current_id == id) {
-				*iter = old_iter;
-	                        return TRUE;
-			}
-	                valid = gtk_tree_model_iter_next (model, &old_iter);
-		}
+	known = g_hash_table_lookup (ilv->item_ids, GUINT_TO_POINTER (id));
+	if (!known)
+		return FALSE;
 
-		/* Next search the batch store */
-		model = GTK_TREE_MODEL (ilv->batch_itemstore);
-		valid = gtk_tree_model_get_iter_first (model, &old_iter);
-		while (valid) {
-			gulong current_id;
-			gtk_tree_model_get (model, &old_iter, IS_NR, &current_id, -1);
-	                if(current_id == id) {
-				*iter = old_iter;
-	                        return TRUE;
-			}
-	                valid = gtk_tree_model_iter_next (model, &old_iter);
-		}
-	}
-	return FALSE;
+	*iter = *known;
+	return TRUE;
 }
 
 static gint
@@ -289,7 +294,6 @@ item_list_view_create_tree_store (void)
 {
 	return gtk_tree_store_new (ITEMSTORE_LEN,
 	                    G_TYPE_INT64,	/* IS_TIME */
-	                    G_TYPE_STRING, 	/* IS_TIME_STR */
 	                    G_TYPE_STRING,	/* IS_LABEL */
 	                    G_TYPE_ICON,	/* IS_STATEICON */
 	                    G_TYPE_ULONG,	/* IS_NR */
@@ -397,16 +401,19 @@ item_list_view_remove_item (ItemListView *ilv, itemPtr item)
 	if (item_list_view_id_to_iter (ilv, item->id, &iter)) {
 		/* Using the GtkTreeIter check if it is currently selected. If yes,
 		   scroll down by one in the sorted GtkTreeView to ensure something
-		   is selected after removing the GtkTreeIter */
-		if (gtk_tree_selection_iter_is_selected (gtk_tree_view_get_selection (ilv->treeview), &iter))
+		   is selected after removing the GtkTreeIter. In batch mode the
+		   iter belongs to the batch store which is not yet displayed. */
+		if (!ilv->batch_mode &&
+		    gtk_tree_selection_iter_is_selected (gtk_tree_view_get_selection (ilv->treeview), &iter))
 			ui_common_treeview_move_cursor (ilv->treeview, 1);
 
-		gtk_tree_store_remove (GTK_TREE_STORE (gtk_tree_view_get_model (ilv->treeview)), &iter);
+		gtk_tree_store_remove (item_list_view_get_item_store (ilv), &iter);
 	} else {
 		g_warning ("Fatal: item to be removed not found in item id list!");
 	}
 
-	ilv->item_ids = g_slist_remove (ilv->item_ids, GUINT_TO_POINTER (item->id));
+	g_hash_table_remove (ilv->item_ids, GUINT_TO_POINTER (item->id));
+	g_hash_table_remove (ilv->teasers, GUINT_TO_POINTER (item->id));
 }
 
 /* cleans up the item list, sets up the iter hash when called for the first time */
@@ -433,10 +440,10 @@ item_list_view_clear (ItemListView *ilv)
 
 	if (itemstore)
 		gtk_tree_store_clear (itemstore);
-	if (ilv->item_ids)
-		g_slist_free (ilv->item_ids);
 
-	ilv->item_ids = NULL;
+	g_hash_table_remove_all (ilv->item_ids);
+	g_hash_table_remove_all (ilv->teasers);
+	g_hash_table_remove_all (ilv->pendingTeasers);
 
 	/* enable batch mode for following item adds */
 	ilv->batch_mode = TRUE;
@@ -468,7 +475,7 @@ static void
 item_list_view_update_item_internal (ItemListView *ilv, itemPtr item, GtkTreeIter *iter, nodePtr node)
 {
 	GtkTreeStore	*itemstore;
-	gchar		*title, *time_str;
+	gchar		*title;
 	const GIcon	*state_icon;
 	gint		state = 0;
 
@@ -477,42 +484,24 @@ item_list_view_update_item_internal (ItemListView *ilv, itemPtr item, GtkTreeIte
 	if (!item->readStatus)
 		state += 1;
 
-	time_str = (0 != item->time) ? date_format ((time_t)item->time, NULL) : g_strdup ("");
-
+	/* The date string and the wide view markup are only rendered
+	   for visible rows, see the cell data functions below */
 	title = item->title && strlen (item->title) ? item->title : _("*** No title ***");
 	title = g_strstrip (g_markup_escape_text (title, -1));
 
-	if (ilv->wideView) {
-		const gchar *important = _(" <span background='red' color='black'> important </span> ");
-		gchar *teaser = item_get_teaser (item);
-		gchar *tmp = title;
-
-		title = g_strdup_printf ("<span weight='%s' size='larger'>%s</span>%s\n<span weight='%s'>%s%s</span><span size='smaller' weight='ultralight'> — %s</span>",
-		                         item->readStatus?"normal":"ultrabold",
-		                         title,
-		                         item->flagStatus?important:"",
-		                         item->readStatus?"ultralight":"light",
-		                         teaser?teaser:"",
-		                         teaser?"…":"",
-					 time_str);
-		g_free (tmp);
-		g_free (teaser);
-	}
+	/* the description might have changed */
+	g_hash_table_remove (ilv->teasers, GUINT_TO_POINTER (item->id));
 
 	state_icon = item->flagStatus ? icon_get (ICON_FLAG) :
 	             !item->readStatus ? icon_get (ICON_UNREAD) :
 		     NULL;
 
-	if (ilv->batch_mode)
-		itemstore = ilv->batch_itemstore;
-	else
-		itemstore = GTK_TREE_STORE (gtk_tree_view_get_model (ilv->treeview));
+	itemstore = item_list_view_get_item_store (ilv);
 
         if (NULL == node) {
                 gtk_tree_store_set (itemstore, iter,
 		            IS_LABEL, title,
 	                    IS_TIME, item->time,
-			    IS_TIME_STR, time_str,
                             IS_NR, item->id,
 			    IS_STATEICON, state_icon,
 			    ITEMSTORE_ALIGN, item_list_title_alignment (title),
@@ -525,7 +514,6 @@ item_list_view_update_item_internal (ItemListView *ilv, itemPtr item, GtkTreeIte
                 gtk_tree_store_set (itemstore, iter,
 		            IS_LABEL, title,
                             IS_TIME, item->time,
-			    IS_TIME_STR, time_str,
                             IS_NR, item->id,
 			    IS_STATEICON, state_icon,
                             IS_PARENT, node,
@@ -538,6 +526,135 @@ item_list_view_update_item_internal (ItemListView *ilv, itemPtr item, GtkTreeIte
                             -1);
         }
 
+	g_free (title);
+}
+
+/* Cell data functions rendering the derived columns. GtkTreeView calls
+   them only for rows being displayed, so loading large item lists does
+   not need to format dates or wide view markup for all items. */
+
+static void
+item_list_view_date_cell_data_func (GtkTreeViewColumn *column, GtkCellRenderer *renderer,
+                                    GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data)
+{
+	gint64	time;
+	gint	weight;
+	gchar	*time_str;
+
+	gtk_tree_model_get (model, iter, IS_TIME, &time, ITEMSTORE_WEIGHT, &weight, -1);
+	time_str = (0 != time) ? date_format (time, NULL) : g_strdup ("");
+	g_object_set (renderer, "text", time_str, "weight", weight, NULL);
+	g_free (time_str);
+}
+
+/* Loads the teasers of all rows rendered since the last run with
+   a single batch load and rerenders these rows */
+static gboolean
+item_list_view_load_teasers (gpointer user_data)
+{
+	ItemListView	*ilv = ITEM_LIST_VIEW (user_data);
+	GHashTableIter	hiter;
+	GArray		*ids;
+	GList		*items, *iter;
+	gpointer	key;
+	guint		i;
+
+	ilv->teaserLoadId = 0;
+
+	ids = g_array_new (FALSE, FALSE, sizeof (gulong));
+	g_hash_table_iter_init (&hiter, ilv->pendingTeasers);
+	while (g_hash_table_iter_next (&hiter, &key, NULL)) {
+		gulong id = GPOINTER_TO_UINT (key);
+		g_array_append_val (ids, id);
+	}
+	g_hash_table_remove_all (ilv->pendingTeasers);
+
+	/* Keep only the teasers of the recently rendered rows */
+	if (g_hash_table_size (ilv->teasers) + ids->len > ITEM_LIST_VIEW_MAX_TEASERS)
+		g_hash_table_remove_all (ilv->teasers);
+
+	items = db_items_load_many ((gulong *)ids->data, ids->len);
+	for (iter = items; iter; iter = g_list_next (iter)) {
+		itemPtr	item = (itemPtr)iter->data;
+		gchar	*teaser = item_get_teaser (item);
+
+		g_hash_table_insert (ilv->teasers, GUINT_TO_POINTER (item->id), teaser?teaser:g_strdup (""));
+		item_unload (item);
+	}
+	g_list_free (items);
+
+	for (i = 0; i < ids->len; i++) {
+		gulong		id = g_array_index (ids, gulong, i);
+		GtkTreeIter	treeIter;
+		GtkTreePath	*path;
+
+		/* also remember items that do not exist anymore */
+		if (!g_hash_table_contains (ilv->teasers, GUINT_TO_POINTER (id)))
+			g_hash_table_insert (ilv->teasers, GUINT_TO_POINTER (id), g_strdup (""));
+
+		if (ilv->batch_mode || !item_list_view_id_to_iter (ilv, id, &treeIter))
+			continue;
+
+		path = gtk_tree_model_get_path (gtk_tree_view_get_model (ilv->treeview), &treeIter);
+		gtk_tree_model_row_changed (gtk_tree_view_get_model (ilv->treeview), path, &treeIter);
+		gtk_tree_path_free (path);
+	}
+
+	g_array_free (ids, TRUE);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Returns the teaser of the given item or NULL if it still needs
+   to be loaded, the row is rerendered once it is available */
+static const gchar *
+item_list_view_get_teaser (ItemListView *ilv, gulong id)
+{
+	const gchar *teaser = g_hash_table_lookup (ilv->teasers, GUINT_TO_POINTER (id));
+
+	if (!teaser) {
+		g_hash_table_add (ilv->pendingTeasers, GUINT_TO_POINTER (id));
+		if (!ilv->teaserLoadId)
+			ilv->teaserLoadId = g_idle_add (item_list_view_load_teasers, ilv);
+	}
+
+	return teaser;
+}
+
+static void
+item_list_view_wide_headline_cell_data_func (GtkTreeViewColumn *column, GtkCellRenderer *renderer,
+                                             GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data)
+{
+	ItemListView	*ilv = ITEM_LIST_VIEW (user_data);
+	const gchar	*important = _(" <span background='red' color='black'> important </span> ");
+	const gchar	*teaser;
+	gchar		*title, *time_str, *markup;
+	gulong		id;
+	gint64		time;
+	guint		state;
+	gfloat		align;
+	gboolean	read, flagged;
+
+	gtk_tree_model_get (model, iter, IS_LABEL, &title, IS_TIME, &time, IS_NR, &id,
+	                    IS_STATE, &state, ITEMSTORE_ALIGN, &align, -1);
+	read = !(state & 1);
+	flagged = (state & 2);
+
+	teaser = item_list_view_get_teaser (ilv, id);
+	time_str = (0 != time) ? date_format (time, NULL) : g_strdup ("");
+
+	markup = g_strdup_printf ("<span weight='%s' size='larger'>%s</span>%s\n<span weight='%s'>%s%s</span><span size='smaller' weight='ultralight'> — %s</span>",
+	                          read?"normal":"ultrabold",
+	                          title?title:"",
+	                          flagged?important:"",
+	                          read?"ultralight":"light",
+	                          teaser?teaser:"",
+	                          (teaser && *teaser)?"…":"",
+	                          time_str);
+
+	g_object_set (renderer, "markup", markup, "xalign", align, NULL);
+
+	g_free (markup);
 	g_free (time_str);
 	g_free (title);
 }
@@ -811,6 +928,9 @@ item_list_view_create (gboolean wide)
 	ilv->wideView = wide;
 
 	ilv->columns = g_hash_table_new (g_str_hash, g_str_equal);
+	ilv->teasers = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+	ilv->pendingTeasers = g_hash_table_new (g_direct_hash, g_direct_equal);
+	ilv->item_ids = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)gtk_tree_iter_free);
 
 	ilv->ilscrolledwindow = gtk_scrolled_window_new (NULL, NULL);
 	g_object_ref_sink (ilv->ilscrolledwindow);
@@ -846,10 +966,17 @@ item_list_view_create (gboolean wide)
 	g_hash_table_insert (ilv->columns, "favicon", column);
 
 	renderer = gtk_cell_renderer_text_new ();
-	headline_column = gtk_tree_view_column_new_with_attributes (_("Headline"), renderer,
-	                                                   "markup", IS_LABEL,
-							   "xalign", ITEMSTORE_ALIGN,
-							   NULL);
+	if (wide) {
+		headline_column = gtk_tree_view_column_new ();
+		gtk_tree_view_column_set_title (headline_column, _("Headline"));
+		gtk_tree_view_column_pack_start (headline_column, renderer, TRUE);
+		gtk_tree_view_column_set_cell_data_func (headline_column, renderer, item_list_view_wide_headline_cell_data_func, ilv, NULL);
+	} else {
+		headline_column = gtk_tree_view_column_new_with_attributes (_("Headline"), renderer,
+		                                                   "markup", IS_LABEL,
+								   "xalign", ITEMSTORE_ALIGN,
+								   NULL);
+	}
 	gtk_tree_view_column_set_expand (headline_column, TRUE);
 	g_hash_table_insert (ilv->columns, "headline", headline_column);
 	g_object_set (headline_column, "resizable", TRUE, NULL);
@@ -868,10 +995,10 @@ item_list_view_create (gboolean wide)
 	g_hash_table_insert (ilv->columns, "enclosure", column);
 
 	renderer = gtk_cell_renderer_text_new ();
-	column = gtk_tree_view_column_new_with_attributes (_("Date"), renderer,
-		                                           "text", IS_TIME_STR,
-	                                                   "weight", ITEMSTORE_WEIGHT,
-							   NULL);
+	column = gtk_tree_view_column_new ();
+	gtk_tree_view_column_set_title (column, _("Date"));
+	gtk_tree_view_column_pack_start (column, renderer, TRUE);
+	gtk_tree_view_column_set_cell_data_func (column, renderer, item_list_view_date_cell_data_func, NULL, NULL);
 	gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_GROW_ONLY);
 	g_hash_table_insert (ilv->columns, "date", column);
 	gtk_tree_view_column_set_sort_column_id(column, IS_TIME);
@@ -917,7 +1044,7 @@ item_list_view_add_item_to_tree_store (ItemListView *ilv, GtkTreeStore *itemstor
 
 	if (!exists) {
 		gtk_tree_store_prepend (itemstore, &iter, NULL);
-		ilv->item_ids = g_slist_prepend (ilv->item_ids, GUINT_TO_POINTER (item->id));
+		g_hash_table_insert (ilv->item_ids, GUINT_TO_POINTER (item->id), gtk_tree_iter_copy (&iter));
 	}
 
 	item_list_view_update_item_internal (ilv, item, &iter, node);
@@ -381,7 +381,8 @@ subscription_prop_dialog_load (SubscriptionPropDialog *spd,
 {
 	gint 		interval;
 	gint		default_update_interval;
-	gint		defaultInterval, spinSetInterval;
+	gint		defaultInterval, spinSetInterval, adaptiveInterval;
+	gboolean	adaptiveUpdate;
 	gchar 		*defaultIntervalStr;
 	nodePtr		node = subscription->node;
 	feedPtr		feed = (feedPtr)node->data;
@@ -430,6 +431,20 @@ subscription_prop_dialog_load (SubscriptionPropDialog *spd,
 	else
 		defaultIntervalStr = g_strdup (_("This feed specifies no default update interval."));
 
+	/* and about the interval learned by adaptive updating */
+	conf_get_bool_value (ADAPTIVE_UPDATE, &adaptiveUpdate);
+	adaptiveInterval = subscription_get_adaptive_update_interval (subscription);
+	if (adaptiveUpdate && adaptiveInterval > 0) {
+		gchar *adaptiveIntervalStr = g_strdup_printf (ngettext ("Based on its publishing frequency it is currently updated every %d minute when using the default update interval.",
+		                                                        "Based on its publishing frequency it is currently updated every %d minutes when using the default update interval.",
+		                                                        adaptiveInterval), adaptiveInterval);
+		gchar *tmp = defaultIntervalStr;
+
+		defaultIntervalStr = g_strdup_printf ("%s\n%s", tmp, adaptiveIntervalStr);
+		g_free (adaptiveIntervalStr);
+		g_free (tmp);
+	}
+
 	gtk_label_set_text (GTK_LABEL (liferea_dialog_lookup (spd->ui_data.dialog, "feedUpdateInfo")), defaultIntervalStr);
 	g_free (defaultIntervalStr);
 
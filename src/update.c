@@ -37,6 +37,7 @@
 
 #include "auth_activatable.h"
 #include "common.h"
+#include "conf.h"
 #include "debug.h"
 #include "net.h"
 #include "plugins_engine.h"
@@ -48,13 +49,39 @@
 #define WEXITSTATUS(x) (x)
 #endif
 
-/** global update job list, used for lookups when cancelling */
-static GSList	*jobs = NULL;
+/** global update job registry (owner -> GQueue of jobs), used for lookups when cancelling */
+static GHashTable	*jobs = NULL;
 
-static GAsyncQueue *pendingHighPrioJobs = NULL;
-static GAsyncQueue *pendingJobs = NULL;
+/** number of registered subscription jobs (not having FEED_REQ_NO_FEED) */
+static guint		numberOfFeedJobs = 0;
+
+/* Jobs are scheduled with a global limit of parallel jobs and a limit
+   of parallel jobs per host. Normal priority jobs are queued per host
+   and the hosts are served round robin, so that a single host with
+   many subscriptions cannot starve or be hammered by the others. */
+
+/** per host scheduling state */
+typedef struct updateHost {
+	updateHostStats	stats;		/**< live statistics, stats.host is the hash key */
+	GQueue		*pending;	/**< pending normal priority jobs */
+	gboolean	ready;		/**< TRUE if the host is in the round robin queue */
+	guint		runCompleted;	/**< number of jobs finished since the queue last ran empty */
+} *updateHostPtr;
+
+static GHashTable *hosts = NULL;		/**< host name -> updateHost */
+static GQueue *readyHosts = NULL;		/**< hosts with pending jobs to serve round robin */
+static GQueue *pendingHighPrioJobs = NULL;
 static guint numberOfActiveJobs = 0;
-#define MAX_ACTIVE_JOBS	5
+static guint numberOfQueuedJobs = 0;
+static guint numberOfCompletedJobs = 0;
+static guint numberOfRunCompletedJobs = 0;	/**< jobs finished since the queue last ran empty */
+static guint dequeueSourceId = 0;
+
+#define DEFAULT_MAX_ACTIVE_JOBS		12
+#define DEFAULT_MAX_ACTIVE_JOBS_PER_HOST	2
+
+static gint maxActiveJobs = DEFAULT_MAX_ACTIVE_JOBS;
+static gint maxActiveJobsPerHost = DEFAULT_MAX_ACTIVE_JOBS_PER_HOST;
 
 /* update state interface */
 
@@ -292,14 +319,42 @@ update_job_get_state (updateJobPtr job)
 }
 
 static void
-update_job_show_count_foreach_func (gpointer data, gpointer user_data)
+update_job_register (updateJobPtr job)
 {
-	updateJobPtr	job = (updateJobPtr)data;
-	guint		*count = (guint *)user_data;
+	GQueue	*ownerJobs;
+
+	ownerJobs = g_hash_table_lookup (jobs, job->owner);
+	if (!ownerJobs) {
+		ownerJobs = g_queue_new ();
+		g_hash_table_insert (jobs, job->owner, ownerJobs);
+	}
+
+	g_queue_push_tail (ownerJobs, job);
+	job->ownerLink = ownerJobs->tail;
 
 	// Count all subscription jobs (ignore HTML5 and favicon requests)
 	if (!(job->flags & FEED_REQ_NO_FEED))
-		(*count)++;
+		numberOfFeedJobs++;
+}
+
+static void
+update_job_unregister (updateJobPtr job)
+{
+	GQueue	*ownerJobs;
+
+	if (!jobs || !job->ownerLink)
+		return;	/* we must be in shutdown */
+
+	ownerJobs = g_hash_table_lookup (jobs, job->owner);
+	g_assert (NULL != ownerJobs);
+
+	g_queue_delete_link (ownerJobs, job->ownerLink);
+	job->ownerLink = NULL;
+	if (g_queue_is_empty (ownerJobs))
+		g_hash_table_remove (jobs, job->owner);
+
+	if (!(job->flags & FEED_REQ_NO_FEED))
+		numberOfFeedJobs--;
 }
 
 static guint maxcount = 0;
@@ -307,8 +362,7 @@ static guint maxcount = 0;
 void
 update_jobs_get_count (guint *count, guint *max)
 {
-	*count = 0;
-	g_slist_foreach (jobs, update_job_show_count_foreach_func, count);
+	*count = numberOfFeedJobs;
 
 	if (*count > maxcount)
 		maxcount = *count;
@@ -322,7 +376,7 @@ update_job_free (updateJobPtr job)
 	if (!job)
 		return;
 
-	jobs = g_slist_remove (jobs, job);
+	update_job_unregister (job);
 
 	g_object_unref (job->request);
 	update_result_free (job->result);
@@ -556,40 +610,194 @@ update_job_run (updateJobPtr job)
 	}
 }
 
+/* scheduler implementation */
+
+static void
+update_host_free (gpointer data)
+{
+	updateHostPtr host = (updateHostPtr)data;
+
+	g_queue_free (host->pending);
+	g_free ((gchar *)host->stats.host);
+	g_free (host);
+}
+
+/* Returns the host part of URLs (including the port) or an empty
+   string for local commands and files. */
+static gchar *
+update_get_host_name (const gchar *source)
+{
+	const gchar	*start, *end, *at;
+
+	if ('|' == *source || !strstr (source, "://") || !strncmp (source, "file://", 7))
+		return g_strdup ("");
+
+	start = strstr (source, "://") + 3;
+	end = start + strcspn (start, "/?#");
+
+	/* skip user info */
+	at = memchr (start, '@', end - start);
+	if (at)
+		start = at + 1;
+
+	return g_ascii_strdown (start, end - start);
+}
+
+static updateHostPtr
+update_get_host (const gchar *source)
+{
+	updateHostPtr	host;
+	gchar		*name;
+
+	name = update_get_host_name (source);
+	host = g_hash_table_lookup (hosts, name);
+	if (!host) {
+		host = g_new0 (struct updateHost, 1);
+		host->stats.host = name;
+		host->pending = g_queue_new ();
+		g_hash_table_insert (hosts, name, host);
+	} else {
+		g_free (name);
+	}
+
+	return host;
+}
+
 static gboolean
-update_dequeue_job (gpointer user_data)
+update_host_can_run (updateHostPtr host)
 {
-	updateJobPtr job;
+	/* local files and commands are not subject to the host limit */
+	if (0 == *(host->stats.host))
+		return TRUE;
 
-	if (!pendingJobs)
-		return FALSE;	/* we must be in shutdown */
+	return host->stats.active < (guint)maxActiveJobsPerHost;
+}
+
+static void
+update_host_make_ready (updateHostPtr host)
+{
+	if (host->ready || g_queue_is_empty (host->pending))
+		return;
 
-	if (numberOfActiveJobs >= MAX_ACTIVE_JOBS)
-		return FALSE;	/* we'll be called again when a job finishes */
+	host->ready = TRUE;
+	g_queue_push_tail (readyHosts, host);
+}
 
+static updateJobPtr
+update_next_job (void)
+{
+	updateJobPtr	job = NULL;
+	updateHostPtr	host;
+	GList		*iter;
+
+	/* High priority jobs go first, but still obey the host limit */
+	for (iter = pendingHighPrioJobs->head; iter; iter = iter->next) {
+		job = (updateJobPtr)iter->data;
+		if (update_host_can_run (job->host)) {
+			g_queue_delete_link (pendingHighPrioJobs, iter);
+			return job;
+		}
+	}
 
-	job = (updateJobPtr)g_async_queue_try_pop(pendingHighPrioJobs);
+	/* Serve hosts round robin. Hosts that reached their limit leave
+	   the round robin queue until one of their jobs finishes. */
+	while ((host = (updateHostPtr)g_queue_pop_head (readyHosts))) {
+		host->ready = FALSE;
+		if (!update_host_can_run (host))
+			continue;
 
-	if (!job)
-		job = (updateJobPtr)g_async_queue_try_pop(pendingJobs);
+		job = (updateJobPtr)g_queue_pop_head (host->pending);
+		update_host_make_ready (host);
+		return job;
+	}
 
-	if(!job)
-		return FALSE;	/* no request at the moment */
+	return NULL;
+}
 
-	numberOfActiveJobs++;
+static void
+update_print_host_stats (const updateHostStats *stats)
+{
+	debug5 (DEBUG_UPDATE, "host \"%s\": %u completed, wait time %" G_GINT64_FORMAT "ms total, %" G_GINT64_FORMAT "ms avg, %" G_GINT64_FORMAT "ms max",
+	        stats->host,
+	        stats->completed,
+	        stats->waitTime,
+	        stats->completed?stats->waitTime / stats->completed:0,
+	        stats->maxWaitTime);
+}
 
-	job->state = REQUEST_STATE_PROCESSING;
+/* Prints the statistics once after the queue ran empty, only
+   listing the hosts that had jobs since the last report */
+static void
+update_print_stats (void)
+{
+	GHashTableIter	iter;
+	gpointer	value;
 
-	debug1 (DEBUG_UPDATE, "processing request (%s)", job->request->source);
-	if (job->callback == NULL) {
-		update_process_finished_job (job);
-	} else {
-		update_job_run (job);
+	if (0 == numberOfRunCompletedJobs)
+		return;
+
+	debug2 (DEBUG_UPDATE, "update queue empty, %u jobs completed (%u since startup)", numberOfRunCompletedJobs, numberOfCompletedJobs);
+	numberOfRunCompletedJobs = 0;
+
+	g_hash_table_iter_init (&iter, hosts);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		updateHostPtr host = (updateHostPtr)value;
+
+		if (host->runCompleted)
+			update_print_host_stats (&host->stats);
+		host->runCompleted = 0;
 	}
+}
+
+static gboolean
+update_dequeue_job (gpointer user_data)
+{
+	updateJobPtr	job;
+	gint64		wait;
+
+	dequeueSourceId = 0;
+
+	if (!hosts)
+		return FALSE;	/* we must be in shutdown */
+
+	while (numberOfActiveJobs < (guint)maxActiveJobs) {
+		job = update_next_job ();
+		if (!job)
+			break;	/* no request at the moment, or all hosts busy */
+
+		numberOfQueuedJobs--;
+		numberOfActiveJobs++;
+		job->host->stats.queued--;
+		job->host->stats.active++;
+
+		wait = (g_get_monotonic_time () - job->queued) / 1000;
+		job->host->stats.waitTime += wait;
+		if (wait > job->host->stats.maxWaitTime)
+			job->host->stats.maxWaitTime = wait;
+
+		job->state = REQUEST_STATE_PROCESSING;
+
+		debug3 (DEBUG_UPDATE, "processing request (%s) after %" G_GINT64_FORMAT "ms, %u jobs active", job->request->source, wait, numberOfActiveJobs);
+		if (job->callback == NULL) {
+			update_process_finished_job (job);
+		} else {
+			update_job_run (job);
+		}
+	}
+
+	if (0 == numberOfActiveJobs && 0 == numberOfQueuedJobs)
+		update_print_stats ();
 
 	return FALSE;
 }
 
+static void
+update_schedule_dequeue (void)
+{
+	if (!dequeueSourceId)
+		dequeueSourceId = g_idle_add (update_dequeue_job, NULL);
+}
+
 updateJobPtr
 update_execute_request (gpointer owner,
                         UpdateRequest *request,
@@ -598,36 +806,53 @@ update_execute_request (gpointer owner,
 			updateFlags flags)
 {
 	updateJobPtr job;
-	gint count;
 
 	g_assert (request->options != NULL);
 	g_assert (request->source != NULL);
 
 	job = update_job_new (owner, request, callback, user_data, flags);
 	job->state = REQUEST_STATE_PENDING;
-	jobs = g_slist_append (jobs, job);
+	job->host = update_get_host (request->source);
+	job->queued = g_get_monotonic_time ();
+	update_job_register (job);
+
+	numberOfQueuedJobs++;
+	job->host->stats.queued++;
 
 	if (flags & FEED_REQ_PRIORITY_HIGH) {
-		g_async_queue_push (pendingHighPrioJobs, (gpointer)job);
+		g_queue_push_tail (pendingHighPrioJobs, job);
 	} else {
-		g_async_queue_push (pendingJobs, (gpointer)job);
+		g_queue_push_tail (job->host->pending, job);
+		update_host_make_ready (job->host);
 	}
 
-	g_idle_add (update_dequeue_job, NULL);
+	update_schedule_dequeue ();
 	return job;
 }
 
+void
+update_jobs_get_stats (guint *queued, guint *active, guint *completed)
+{
+	*queued = numberOfQueuedJobs;
+	*active = numberOfActiveJobs;
+	*completed = numberOfCompletedJobs;
+}
+
 void
 update_job_cancel_by_owner (gpointer owner)
 {
-	GSList	*iter = jobs;
+	GQueue	*ownerJobs;
+	GList	*iter;
 
-	while (iter) {
-		updateJobPtr job = (updateJobPtr)iter->data;
-		if (job->owner == owner)
-			job->callback = NULL;
-		iter = g_slist_next (iter);
-	}
+	if (!jobs)
+		return;	/* we must be in shutdown */
+
+	ownerJobs = g_hash_table_lookup (jobs, owner);
+	if (!ownerJobs)
+		return;
+
+	for (iter = ownerJobs->head; iter; iter = iter->next)
+		((updateJobPtr)iter->data)->callback = NULL;
 }
 
 static gboolean
@@ -665,7 +890,15 @@ update_process_finished_job (updateJobPtr job)
 
 	g_assert(numberOfActiveJobs > 0);
 	numberOfActiveJobs--;
-	g_idle_add (update_dequeue_job, NULL);
+	numberOfCompletedJobs++;
+	numberOfRunCompletedJobs++;
+	if (job->host) {
+		job->host->stats.active--;
+		job->host->stats.completed++;
+		job->host->runCompleted++;
+		update_host_make_ready (job->host);
+		update_schedule_dequeue ();
+	}
 
 	/* Handling abandoned requests (e.g. after feed deletion) */
 	if (job->callback == NULL) {
@@ -690,25 +923,51 @@ update_process_finished_job (updateJobPtr job)
 void
 update_init (void)
 {
-	pendingJobs = g_async_queue_new ();
-	pendingHighPrioJobs = g_async_queue_new ();
+	conf_get_int_value (MAX_ACTIVE_UPDATES, &maxActiveJobs);
+	conf_get_int_value (MAX_HOST_UPDATES, &maxActiveJobsPerHost);
+	if (maxActiveJobs < 1)
+		maxActiveJobs = DEFAULT_MAX_ACTIVE_JOBS;
+	if (maxActiveJobsPerHost < 1)
+		maxActiveJobsPerHost = DEFAULT_MAX_ACTIVE_JOBS_PER_HOST;
+
+	debug2 (DEBUG_UPDATE, "update scheduler: %d parallel jobs, %d per host", maxActiveJobs, maxActiveJobsPerHost);
+
+	jobs = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_queue_free);
+	hosts = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, update_host_free);
+	readyHosts = g_queue_new ();
+	pendingHighPrioJobs = g_queue_new ();
 }
 
 void
 update_deinit (void)
 {
-	GSList	*iter = jobs;
+	GHashTableIter	hiter;
+	gpointer	value;
+	GList		*iter;
 
 	/* Cancel all jobs, to avoid async callbacks accessing the GUI */
-	while (iter) {
-		updateJobPtr job = (updateJobPtr)iter->data;
-		job->callback = NULL;
-		iter = g_slist_next (iter);
+	g_hash_table_iter_init (&hiter, jobs);
+	while (g_hash_table_iter_next (&hiter, NULL, &value)) {
+		for (iter = ((GQueue *)value)->head; iter; iter = iter->next) {
+			updateJobPtr job = (updateJobPtr)iter->data;
+			job->callback = NULL;
+			job->host = NULL;
+			job->ownerLink = NULL;
+		}
 	}
 
-	g_async_queue_unref (pendingJobs);
-	g_async_queue_unref (pendingHighPrioJobs);
+	if (dequeueSourceId)
+		g_source_remove (dequeueSourceId);
+	dequeueSourceId = 0;
+
+	g_queue_free (pendingHighPrioJobs);
+	g_queue_free (readyHosts);
+	g_hash_table_destroy (hosts);
+	pendingHighPrioJobs = NULL;
+	readyHosts = NULL;
+	hosts = NULL;
 
-	g_slist_free (jobs);
+	g_hash_table_destroy (jobs);
 	jobs = NULL;
+	numberOfFeedJobs = 0;
 }
@@ -53,6 +53,7 @@ typedef enum {
 
 struct updateJob;
 struct updateResult;
+struct updateHost;
 
 typedef guint32 updateFlags;
 
@@ -85,6 +86,8 @@ typedef struct updateState {
 	gint		synFrequency;		/**< syn:updateFrequency */
 	gint		synPeriod;		/**< syn:updatePeriod */
 	gint		timeToLive;		/**< ttl */
+	gint64		newestItemTime;		/**< date of the newest item as of the last merge (or 0) */
+	gint64		publishPeriod;		/**< average seconds between the newest items as of the last merge (or 0) */
 } *updateStatePtr;
 
 G_BEGIN_DECLS
@@ -128,8 +131,21 @@ typedef struct updateJob {
 	gpointer		user_data;	/**< result processing user data */
 	updateFlags		flags;		/**< request and result processing flags */
 	gint			state;		/**< State of the job (enum request_state) */
+	struct updateHost	*host;		/**< scheduling state of the source host */
+	gint64			queued;		/**< monotonic time the job was queued at */
+	GList			*ownerLink;	/**< link in the job registry of the owner */
 } *updateJobPtr;
 
+/** live scheduling statistics for a single source host */
+typedef struct updateHostStats {
+	const gchar	*host;		/**< host name, empty for local files and commands */
+	guint		queued;		/**< number of jobs waiting for execution */
+	guint		active;		/**< number of jobs currently processed */
+	guint		completed;	/**< number of jobs finished since startup */
+	gint64		waitTime;	/**< accumulated queue wait time of all started jobs (in ms) */
+	gint64		maxWaitTime;	/**< longest queue wait time of a single job (in ms) */
+} updateHostStats;
+
 /**
  * Create new update state
  */
@@ -282,6 +298,17 @@ gint update_job_get_state (updateJobPtr job);
 */
 void update_jobs_get_count (guint *count, guint *maxcount);
 
+/**
+ * update_jobs_get_stats:
+ *
+ * Query live statistics of the update job scheduler
+ *
+ * @queued:	ref to pass back nr of jobs waiting for execution
+ * @active:	ref to pass back nr of jobs currently processed
+ * @completed:	ref to pass back nr of jobs finished since startup
+ */
+void update_jobs_get_stats (guint *queued, guint *active, guint *completed);
+
 G_END_DECLS
 
 #endif
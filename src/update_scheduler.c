@@ -0,0 +1,473 @@
+/**
+ * @file update_scheduler.c  deadline ordered subscription auto updating
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "update_scheduler.h"
+
+#include "conf.h"
+#include "debug.h"
+#include "feedlist.h"
+#include "net_monitor.h"
+#include "update.h"
+#include "fl_sources/node_source.h"
+
+/* Polling interval for node sources in seconds */
+#define UPDATE_SCHEDULER_SOURCE_INTERVAL	10
+
+/* Delay in seconds before retrying a subscription that was due but
+   could not be updated (e.g. because an update is still running) */
+#define UPDATE_SCHEDULER_RETRY_INTERVAL		60
+
+/* Upper limit for the per subscription due time jitter in seconds */
+#define UPDATE_SCHEDULER_MAX_JITTER		120
+
+/* Maximum number of subscriptions started per wakeup. If more are due
+   (e.g. after startup or a long suspend) the rest is spread over the
+   next seconds instead of flooding the update queue at once. */
+#define UPDATE_SCHEDULER_BATCH_SIZE		10
+
+/* Maximum time to sleep in seconds. Due times are wall clock times
+   (just like the last poll time), so wake up now and then to catch
+   up with system suspend and clock changes. */
+#define UPDATE_SCHEDULER_MAX_SLEEP		300
+
+/** a scheduled node */
+typedef struct schedulerEntry {
+	gchar		*nodeId;	/**< id of the scheduled node (also the hash key) */
+	gint64		due;		/**< wall clock time (in µs) the node is due */
+	guint		pos;		/**< position in the heap */
+	gboolean	isSource;	/**< TRUE for node source roots polled periodically */
+} *schedulerEntryPtr;
+
+static GPtrArray	*heap = NULL;		/**< min-heap of entries ordered by due time */
+static GHashTable	*entries = NULL;	/**< node id -> entry */
+static guint		timerId = 0;
+static gint64		timerDue = 0;		/**< due time the timer was set up for */
+static gboolean		running = FALSE;	/**< TRUE while processing due entries */
+static gint		defaultInterval = -1;	/**< cached global update interval (in minutes) */
+static gboolean		adaptiveUpdate = FALSE;	/**< cached adaptive updating preference */
+static gint		adaptiveMin = 1;	/**< cached lower bound of learned intervals (in minutes) */
+static gint		adaptiveMax = G_MAXINT;	/**< cached upper bound of learned intervals (in minutes) */
+static gboolean		settingsConnected = FALSE;	/**< TRUE once the preference change handlers are set up */
+
+#define HEAP_ENTRY(i) ((schedulerEntryPtr)g_ptr_array_index (heap, (i)))
+
+static void
+update_scheduler_entry_free (gpointer data)
+{
+	schedulerEntryPtr entry = (schedulerEntryPtr)data;
+
+	g_free (entry->nodeId);
+	g_free (entry);
+}
+
+/* min-heap implementation */
+
+static void
+update_scheduler_heap_swap (guint i, guint j)
+{
+	gpointer tmp = heap->pdata[i];
+
+	heap->pdata[i] = heap->pdata[j];
+	heap->pdata[j] = tmp;
+	HEAP_ENTRY (i)->pos = i;
+	HEAP_ENTRY (j)->pos = j;
+}
+
+static void
+update_scheduler_heap_sift_up (guint pos)
+{
+	while (pos > 0 && HEAP_ENTRY ((pos - 1) / 2)->due > HEAP_ENTRY (pos)->due) {
+		update_scheduler_heap_swap (pos, (pos - 1) / 2);
+		pos = (pos - 1) / 2;
+	}
+}
+
+static void
+update_scheduler_heap_sift_down (guint pos)
+{
+	while (TRUE) {
+		guint	smallest = pos;
+		guint	child = 2 * pos + 1;
+
+		if (child < heap->len && HEAP_ENTRY (child)->due < HEAP_ENTRY (smallest)->due)
+			smallest = child;
+		child++;
+		if (child < heap->len && HEAP_ENTRY (child)->due < HEAP_ENTRY (smallest)->due)
+			smallest = child;
+
+		if (smallest == pos)
+			break;
+
+		update_scheduler_heap_swap (pos, smallest);
+		pos = smallest;
+	}
+}
+
+static void
+update_scheduler_heap_remove (schedulerEntryPtr entry)
+{
+	guint	pos = entry->pos;
+	guint	last = heap->len - 1;
+
+	if (pos != last)
+		update_scheduler_heap_swap (pos, last);
+	g_ptr_array_remove_index (heap, last);
+
+	if (pos != last) {
+		update_scheduler_heap_sift_up (pos);
+		update_scheduler_heap_sift_down (pos);
+	}
+
+	g_hash_table_remove (entries, entry->nodeId);
+}
+
+/* timer handling */
+
+static gboolean update_scheduler_wakeup_cb (gpointer user_data);
+
+/* Ensures the timer fires when the first entry is due */
+static void
+update_scheduler_arm (void)
+{
+	gint64	delay;
+
+	if (running)
+		return;		/* re-armed when processing is done */
+
+	if (!heap->len)
+		return;		/* a pending timer will find nothing to do */
+
+	if (timerId && timerDue == HEAP_ENTRY (0)->due)
+		return;
+
+	if (timerId)
+		g_source_remove (timerId);
+
+	timerDue = HEAP_ENTRY (0)->due;
+	delay = (timerDue - g_get_real_time () + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC;
+	delay = CLAMP (delay, 0, UPDATE_SCHEDULER_MAX_SLEEP);
+
+	timerId = g_timeout_add_seconds ((guint)delay, update_scheduler_wakeup_cb, NULL);
+}
+
+/* entry handling */
+
+/* Returns TRUE if the node is a subscription whose update interval
+   is handled by the scheduler */
+static gboolean
+update_scheduler_is_subscription (nodePtr node)
+{
+	nodePtr root = feedlist_get_root ();
+
+	return root && node->subscription && node->source &&
+	       node->source == root->source && node->source->root != node;
+}
+
+/* Returns TRUE if the node is the root of a node source that is
+   triggered periodically */
+static gboolean
+update_scheduler_is_source (nodePtr node)
+{
+	nodePtr root = feedlist_get_root ();
+
+	return root && node->source && node->source->root == node && node != root;
+}
+
+/* Calculates the wall clock time the subscription is due next,
+   returns -1 if it is not to be updated automatically */
+static gint64
+update_scheduler_get_due (subscriptionPtr subscription)
+{
+	gint	interval, maxAge, jitter;
+
+	interval = subscription_get_update_interval (subscription);
+	if (-1 == interval) {
+		interval = defaultInterval;
+
+		/* The learned interval replaces the default one, but
+		   only as long as automatic updating is enabled at all */
+		if (adaptiveUpdate && interval > 0 && subscription_get_adaptive_update_interval (subscription) > 0)
+			interval = CLAMP ((gint)subscription_get_adaptive_update_interval (subscription), adaptiveMin, adaptiveMax);
+	}
+
+	if (-2 >= interval || 0 == interval)
+		return -1;	/* don't update this subscription */
+
+	/* Never poll more often than the server allows */
+	maxAge = update_state_get_cache_maxage (subscription->updateState);
+	if (maxAge > interval)
+		interval = maxAge;
+
+	/* A stable per subscription delay of up to 10% of the interval, so
+	   that subscriptions polled at the same time drift apart */
+	jitter = g_str_hash (subscription->node->id) % (MIN (interval * 6, UPDATE_SCHEDULER_MAX_JITTER) + 1);
+
+	return (gint64)subscription->updateState->lastPoll + ((gint64)interval * 60 + jitter) * G_USEC_PER_SEC;
+}
+
+/* Inserts, moves or (for a negative due time) removes the entry of a node */
+static void
+update_scheduler_set (nodePtr node, gboolean isSource, gint64 due)
+{
+	schedulerEntryPtr	entry;
+	gint64			oldDue;
+
+	entry = (schedulerEntryPtr)g_hash_table_lookup (entries, node->id);
+
+	if (due < 0) {
+		if (entry)
+			update_scheduler_heap_remove (entry);
+		return;
+	}
+
+	if (!entry) {
+		entry = g_new0 (struct schedulerEntry, 1);
+		entry->nodeId = g_strdup (node->id);
+		entry->isSource = isSource;
+		entry->due = due;
+		entry->pos = heap->len;
+		g_ptr_array_add (heap, entry);
+		g_hash_table_insert (entries, entry->nodeId, entry);
+		update_scheduler_heap_sift_up (entry->pos);
+	} else {
+		oldDue = entry->due;
+		entry->due = due;
+		if (due < oldDue)
+			update_scheduler_heap_sift_up (entry->pos);
+		else
+			update_scheduler_heap_sift_down (entry->pos);
+	}
+
+	update_scheduler_arm ();
+}
+
+static void
+update_scheduler_add_node_internal (nodePtr node, gint64 now)
+{
+	GSList	*iter;
+
+	if (update_scheduler_is_source (node)) {
+		/* the node source handles its children */
+		update_scheduler_set (node, TRUE, now);
+		return;
+	}
+
+	if (update_scheduler_is_subscription (node))
+		update_scheduler_set (node, FALSE, update_scheduler_get_due (node->subscription));
+
+	for (iter = node->children; iter; iter = g_slist_next (iter))
+		update_scheduler_add_node_internal ((nodePtr)iter->data, now);
+}
+
+static gboolean
+update_scheduler_wakeup_cb (gpointer user_data)
+{
+	schedulerEntryPtr	entry;
+	nodePtr			node;
+	gint64			now;
+	guint			count = 0;
+
+	timerId = 0;
+
+	if (!network_monitor_is_online ()) {
+		/* update_scheduler_wakeup() is called when getting online */
+		debug0 (DEBUG_UPDATE, "no update processing because we are offline!");
+		return FALSE;
+	}
+
+	now = g_get_real_time ();
+	running = TRUE;
+
+	while (heap->len > 0 && count < UPDATE_SCHEDULER_BATCH_SIZE) {
+		entry = HEAP_ENTRY (0);
+		if (entry->due > now)
+			break;
+
+		/* lazily drop nodes that are gone or have moved to a node source */
+		node = node_from_id (entry->nodeId);
+		if (!node || (entry->isSource?!update_scheduler_is_source (node):!update_scheduler_is_subscription (node))) {
+			debug1 (DEBUG_UPDATE, "update scheduler: dropping node %s", entry->nodeId);
+			update_scheduler_heap_remove (entry);
+			continue;
+		}
+
+		count++;
+
+		if (entry->isSource) {
+			entry->due = now + UPDATE_SCHEDULER_SOURCE_INTERVAL * G_USEC_PER_SEC;
+			update_scheduler_heap_sift_down (0);
+			node_source_auto_update (node);
+		} else {
+			/* Starting the update resets the last poll time and
+			   thereby reschedules the subscription. */
+			subscription_update (node->subscription, 0);
+
+			entry = (schedulerEntryPtr)g_hash_table_lookup (entries, node->id);
+			if (entry && entry->due <= now) {
+				entry->due = now + UPDATE_SCHEDULER_RETRY_INTERVAL * G_USEC_PER_SEC;
+				update_scheduler_heap_sift_down (entry->pos);
+			}
+		}
+	}
+
+	running = FALSE;
+
+	if (count)
+		debug2 (DEBUG_UPDATE, "update scheduler: started %u due nodes, %u nodes scheduled", count, heap->len);
+
+	if (count == UPDATE_SCHEDULER_BATCH_SIZE && heap->len > 0 && HEAP_ENTRY (0)->due <= now) {
+		/* spread the remaining due subscriptions */
+		timerDue = HEAP_ENTRY (0)->due;
+		timerId = g_timeout_add_seconds (1, update_scheduler_wakeup_cb, NULL);
+	} else {
+		update_scheduler_arm ();
+	}
+
+	return FALSE;
+}
+
+static void
+update_scheduler_load_settings (void)
+{
+	conf_get_int_value (DEFAULT_UPDATE_INTERVAL, &defaultInterval);
+	conf_get_bool_value (ADAPTIVE_UPDATE, &adaptiveUpdate);
+	conf_get_int_value (ADAPTIVE_UPDATE_MIN_INTERVAL, &adaptiveMin);
+	conf_get_int_value (ADAPTIVE_UPDATE_MAX_INTERVAL, &adaptiveMax);
+	adaptiveMin = MAX (adaptiveMin, 1);
+	adaptiveMax = MAX (adaptiveMax, adaptiveMin);
+}
+
+static void
+update_scheduler_settings_changed_cb (GSettings *settings, gchar *key, gpointer user_data)
+{
+	debug1 (DEBUG_UPDATE, "update scheduler: \"%s\" changed, rescheduling all subscriptions", key);
+	update_scheduler_reschedule_all ();
+}
+
+/* public interface */
+
+void
+update_scheduler_init (void)
+{
+	g_assert (NULL == heap);
+
+	heap = g_ptr_array_new ();
+	entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, update_scheduler_entry_free);
+
+	/* Handlers stay connected, but do nothing after deinit */
+	if (!settingsConnected) {
+		conf_signal_connect ("changed::" DEFAULT_UPDATE_INTERVAL, G_CALLBACK (update_scheduler_settings_changed_cb), NULL);
+		conf_signal_connect ("changed::" ADAPTIVE_UPDATE, G_CALLBACK (update_scheduler_settings_changed_cb), NULL);
+		conf_signal_connect ("changed::" ADAPTIVE_UPDATE_MIN_INTERVAL, G_CALLBACK (update_scheduler_settings_changed_cb), NULL);
+		conf_signal_connect ("changed::" ADAPTIVE_UPDATE_MAX_INTERVAL, G_CALLBACK (update_scheduler_settings_changed_cb), NULL);
+		settingsConnected = TRUE;
+	}
+
+	update_scheduler_load_settings ();
+
+	update_scheduler_add_node_internal (feedlist_get_root (), g_get_real_time ());
+
+	debug1 (DEBUG_UPDATE, "update scheduler: %u nodes scheduled", heap->len);
+}
+
+void
+update_scheduler_deinit (void)
+{
+	if (!heap)
+		return;
+
+	if (timerId)
+		g_source_remove (timerId);
+	timerId = 0;
+
+	g_ptr_array_free (heap, TRUE);
+	heap = NULL;
+	g_hash_table_destroy (entries);
+	entries = NULL;
+}
+
+void
+update_scheduler_add_node (nodePtr node)
+{
+	if (!heap)
+		return;
+
+	update_scheduler_add_node_internal (node, g_get_real_time ());
+}
+
+void
+update_scheduler_remove_node (nodePtr node)
+{
+	schedulerEntryPtr	entry;
+
+	if (!heap)
+		return;
+
+	entry = (schedulerEntryPtr)g_hash_table_lookup (entries, node->id);
+	if (entry)
+		update_scheduler_heap_remove (entry);
+}
+
+void
+update_scheduler_reschedule (subscriptionPtr subscription)
+{
+	if (!heap || !subscription->node)
+		return;
+
+	if (!update_scheduler_is_subscription (subscription->node))
+		return;
+
+	update_scheduler_set (subscription->node, FALSE, update_scheduler_get_due (subscription));
+}
+
+void
+update_scheduler_reschedule_all (void)
+{
+	gint64	now;
+
+	if (!heap)
+		return;
+
+	update_scheduler_load_settings ();
+
+	/* Rebuilding is simpler than moving every single entry and picks
+	   up subscriptions that were not scheduled before */
+	if (timerId)
+		g_source_remove (timerId);
+	timerId = 0;
+	g_ptr_array_set_size (heap, 0);
+	g_hash_table_remove_all (entries);
+
+	now = g_get_real_time ();
+	update_scheduler_add_node_internal (feedlist_get_root (), now);
+}
+
+void
+update_scheduler_wakeup (void)
+{
+	if (!heap || running)
+		return;
+
+	if (timerId)
+		g_source_remove (timerId);
+	timerId = 0;
+
+	update_scheduler_wakeup_cb (NULL);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file update_scheduler.h  deadline ordered subscription auto updating
+ *
+ * Copyright (C) 2026 Lars Windolf <lars.windolf@gmx.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _UPDATE_SCHEDULER_H
+#define _UPDATE_SCHEDULER_H
+
+#include <glib.h>
+
+#include "node.h"
+#include "subscription.h"
+
+/* The update scheduler keeps the subscriptions of the default feed
+   list source in a min-heap ordered by the time they are due next and
+   wakes up only when the first one is due, instead of walking the
+   whole feed list periodically. Node sources (TinyTinyRSS, OPML...)
+   manage the update intervals of their children themselves and are
+   just triggered periodically as before. */
+
+/**
+ * Registers all subscriptions of the feed list and starts automatic
+ * updating. To be called once the feed list is loaded.
+ */
+void update_scheduler_init (void);
+
+/**
+ * Stops automatic updating and drops all scheduling state.
+ */
+void update_scheduler_deinit (void);
+
+/**
+ * Registers a node newly added to the feed list including all its
+ * descendants.
+ *
+ * @param node		the node
+ */
+void update_scheduler_add_node (nodePtr node);
+
+/**
+ * Unregisters a node removed from the feed list. Does not recurse
+ * as the feed list removes children one by one.
+ *
+ * @param node		the node
+ */
+void update_scheduler_remove_node (nodePtr node);
+
+/**
+ * Recalculates the time the subscription is due next. To be called
+ * whenever the last poll time, the update interval or the cache
+ * max-age of the subscription changes. Subscriptions not scheduled
+ * by the update scheduler are ignored.
+ *
+ * @param subscription	the subscription
+ */
+void update_scheduler_reschedule (subscriptionPtr subscription);
+
+/**
+ * Recalculates all due times. Called automatically whenever the
+ * default update interval or one of the adaptive updating
+ * preferences changes.
+ */
+void update_scheduler_reschedule_all (void);
+
+/**
+ * Immediately starts updating all subscriptions that are due,
+ * e.g. when the network becomes available again.
+ */
+void update_scheduler_wakeup (void);
+
+#endif
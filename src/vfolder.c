@@ -135,33 +135,22 @@ vfolder_foreach (nodeActionFunc func)
 GSList *
 vfolder_get_all_with_item_id (itemPtr item)
 {
-	GSList	*result = NULL;
-	GSList	*iter = vfolders;
-
-	while (iter) {
-		vfolderPtr vfolder = (vfolderPtr)iter->data;
-		if (itemset_check_item (vfolder->itemset, item))
-			result = g_slist_append (result, vfolder);
-		iter = g_slist_next (iter);
-	}
-
-	return result;
-}
-
-GSList *
-vfolder_get_all_without_item_id (itemPtr item)
-{
-	GSList	*result = NULL;
-	GSList	*iter = vfolders;
+	GSList			*result = NULL;
+	GSList			*iter = vfolders;
+	ruleCheckCachePtr	cache;
 
+	/* One cache for all search folders as many of them
+	   check the same item texts or even the same rules */
+	cache = rule_check_cache_new (item);
 	while (iter) {
 		vfolderPtr vfolder = (vfolderPtr)iter->data;
-		if (!itemset_check_item (vfolder->itemset, item))
-			result = g_slist_append (result, vfolder);
+		if (itemset_check_item_cached (vfolder->itemset, cache))
+			result = g_slist_prepend (result, vfolder);
 		iter = g_slist_next (iter);
 	}
+	rule_check_cache_free (cache);
 
-	return result;
+	return g_slist_reverse (result);
 }
 
 static void
@@ -261,8 +250,7 @@ static void
 vfolder_update_counters (nodePtr node)
 {
 	node->needsUpdate = TRUE;
-	node->unreadCount = db_search_folder_get_unread_count (node->id);
-	node->itemCount = db_search_folder_get_item_count (node->id);
+	db_node_get_counters (node->id, &node->itemCount, &node->unreadCount);
 }
 
 static void
@@ -23,6 +23,7 @@
 
 #include <glib.h>
 
+#include "db.h"
 #include "itemset.h"
 #include "node_type.h"
 
@@ -43,7 +44,8 @@ typedef struct vfolder {
 
    gboolean    unreadOnly; /**< TRUE if only unread items are to be shown in the item list */
 	gboolean    reloading;	/**< TRUE if the search folder is in async reloading */
-	gulong		loadOffset;	/**< when in reloading: current offset */
+	dbItemCursor	loadCursor;	/**< when in reloading: position of the next batch */
+	gboolean	loadMatches;	/**< when in reloading: TRUE if the DB matched the items already */
 } *vfolderPtr;
 
 /**
@@ -73,15 +75,6 @@ typedef void 	(*vfolderActionDataFunc)	(vfolderPtr vfolder, itemPtr item);
  */
 GSList * vfolder_get_all_with_item_id (itemPtr item);
 
-/**
- * Returns a list of all search folders currently not matching the given item.
- *
- * @param item		the item
- *
- * @returns a list of vfolderPtr (to be free'd using g_slist_free())
- */
-GSList * vfolder_get_all_without_item_id (itemPtr item);
-
 /**
  * Resets vfolder state. Drops all items from it.
  * To be called after vfolder_(add|remove)_rule().
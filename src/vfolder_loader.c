@@ -29,32 +29,232 @@
 
 #define VFOLDER_LOADER_BATCH_SIZE 	100
 
+/* If all rules of a search folder can be matched by the DB the items
+   are loaded on a worker thread using a read-only DB connection.
+
+   For search folders in the feed list the worker matches all items
+   with its first fetch and the main loop saves all matches at once,
+   so the search folder is complete even if the loading for display
+   is cancelled. Search results are matched by the worker while
+   loading and are saved batch by batch instead.
+
+   Search folders with rules that can only be checked in memory are
+   loaded in the main loop checking all items. */
+
+typedef struct vfolderLoader {
+	gchar		*nodeId;	/**< id of the search folder node */
+	dbReaderPtr	reader;		/**< read-only DB connection of the worker thread */
+	gchar		*condition;	/**< SQL condition selecting the items to load */
+	GSList		*params;	/**< values for the placeholders of the condition */
+	dbItemCursor	cursor;		/**< position of the next batch */
+	gboolean	matchAll;	/**< TRUE if all items are to be matched with the first fetch */
+	GArray		*matches;	/**< ids of all matching items (if matchAll is set) */
+	guint		next;		/**< position of the next batch in matches */
+	gboolean	matchesSaved;	/**< TRUE once the matches were added to the search folder */
+} *vfolderLoaderPtr;
+
+static void
+vfolder_loader_free (gpointer user_data)
+{
+	vfolderLoaderPtr	loader = (vfolderLoaderPtr)user_data;
+
+	db_reader_free (loader->reader);
+	if (loader->matches)
+		g_array_free (loader->matches, TRUE);
+	g_slist_free_full (loader->params, g_free);
+	g_free (loader->condition);
+	g_free (loader->nodeId);
+	g_free (loader);
+}
+
+/* Runs on the worker thread, matches all items on the first call
+   and loads the matches batch by batch */
+static gboolean
+vfolder_loader_fetch_all_thread_cb (vfolderLoaderPtr loader, GSList **resultItems)
+{
+	GList		*loaded, *iter;
+	guint		count;
+
+	if (!loader->matches) {
+		itemSetPtr	items = g_new0 (struct itemSet, 1);
+		dbItemCursor	cursor = DB_ITEM_CURSOR_START;
+
+		loader->matches = g_array_new (FALSE, FALSE, sizeof (gulong));
+		db_reader_itemset_get (loader->reader, items, loader->condition, loader->params,
+		                       &cursor, G_MAXINT);
+		for (iter = items->ids; iter; iter = g_list_next (iter)) {
+			gulong id = GPOINTER_TO_UINT (iter->data);
+			g_array_append_val (loader->matches, id);
+		}
+		itemset_free (items);
+	}
+
+	count = MIN (VFOLDER_LOADER_BATCH_SIZE, loader->matches->len - loader->next);
+	if (!count)
+		return FALSE;	/* last fetch */
+
+	loaded = db_reader_items_load_many (loader->reader, &g_array_index (loader->matches, gulong, loader->next), count);
+	loader->next += count;
+	for (iter = loaded; iter; iter = g_list_next (iter))
+		*resultItems = g_slist_prepend (*resultItems, iter->data);
+	*resultItems = g_slist_reverse (*resultItems);
+	g_list_free (loaded);
+
+	return TRUE;
+}
+
+/* Runs on the worker thread, must only use the reader connection */
+static gboolean
+vfolder_loader_fetch_thread_cb (gpointer user_data, GSList **resultItems)
+{
+	vfolderLoaderPtr	loader = (vfolderLoaderPtr)user_data;
+	itemSetPtr		items;
+	GArray			*ids;
+	GList			*loaded, *iter;
+	gboolean		result;
+
+	if (loader->matchAll)
+		return vfolder_loader_fetch_all_thread_cb (loader, resultItems);
+
+	items = g_new0 (struct itemSet, 1);
+	result = db_reader_itemset_get (loader->reader, items, loader->condition, loader->params,
+	                                &loader->cursor, VFOLDER_LOADER_BATCH_SIZE);
+	if (result) {
+		ids = g_array_new (FALSE, FALSE, sizeof (gulong));
+		for (iter = items->ids; iter; iter = g_list_next (iter)) {
+			gulong id = GPOINTER_TO_UINT (iter->data);
+			g_array_append_val (ids, id);
+		}
+
+		loaded = db_reader_items_load_many (loader->reader, (gulong *)ids->data, ids->len);
+		for (iter = loaded; iter; iter = g_list_next (iter))
+			*resultItems = g_slist_prepend (*resultItems, iter->data);
+		*resultItems = g_slist_reverse (*resultItems);
+
+		g_list_free (loaded);
+		g_array_free (ids, TRUE);
+	}
+
+	itemset_free (items);
+
+	return result;	/* FALSE on last fetch */
+}
+
+/* Saves all matches of a search folder in the feed list */
+static void
+vfolder_loader_save_matches (vfolderLoaderPtr loader, nodePtr node)
+{
+	if (loader->matchesSaved)
+		return;
+
+	if (loader->matches) {
+		db_search_folder_add_ids (node->id, (gulong *)loader->matches->data, loader->matches->len,
+		                          loader->condition, loader->params);
+	} else {
+		/* Cancelled before the worker ran, match synchronously
+		   as the search folder must be complete */
+		db_search_folder_add_matching (node->id, loader->condition, loader->params);
+	}
+	loader->matchesSaved = TRUE;
+
+	debug1 (DEBUG_CACHE, "search folder '%s' reload complete", node->title);
+	node_update_counters (node);
+	feed_list_view_update_node (node->id);
+}
+
+/* Saves the items matched by the worker thread */
+static void
+vfolder_loader_merge_cb (gpointer user_data, GSList **resultItems, gboolean more)
+{
+	vfolderLoaderPtr	loader = (vfolderLoaderPtr)user_data;
+	nodePtr			node;
+
+	node = node_from_id (loader->nodeId);
+	if (!node)
+		return;
+
+	if (loader->matchAll) {
+		vfolder_loader_save_matches (loader, node);
+		return;
+	}
+
+	db_search_folder_add_items (node->id, *resultItems);
+	node_update_counters (node);
+	feed_list_view_update_node (node->id);
+}
+
+static void
+vfolder_loader_finished_cb (ItemLoader *il, gpointer user_data)
+{
+	vfolderLoaderPtr	loader = (vfolderLoaderPtr)user_data;
+	nodePtr			node;
+
+	node = node_from_id (loader->nodeId);
+	if (!node)
+		return;
+
+	/* The display loading might have been cancelled before the
+	   matches were merged */
+	if (loader->matchAll)
+		vfolder_loader_save_matches (loader, node);
+
+	debug1 (DEBUG_CACHE, "search folder '%s' reload finished", node->title);
+	((vfolderPtr)node->data)->reloading = FALSE;
+	feed_list_view_update_node (node->id);
+}
+
+static ItemLoader *
+vfolder_loader_new_threaded (nodePtr node, dbReaderPtr reader, gchar *condition, GSList *params)
+{
+	vfolderPtr		vfolder = (vfolderPtr)node->data;
+	vfolderLoaderPtr	loader;
+	ItemLoader		*il;
+
+	loader = g_new0 (struct vfolderLoader, 1);
+	loader->nodeId = g_strdup (node->id);
+	loader->reader = reader;
+	loader->cursor = DB_ITEM_CURSOR_START;
+	loader->condition = condition;
+	loader->params = params;
+	loader->matchAll = (NULL != node->parent);
+	vfolder->reloading = TRUE;
+
+	il = item_loader_new_threaded (vfolder_loader_fetch_thread_cb,
+	                               vfolder_loader_merge_cb,
+	                               node, loader, vfolder_loader_free);
+	g_signal_connect (G_OBJECT (il), "finished", G_CALLBACK (vfolder_loader_finished_cb), loader);
+
+	return il;
+}
+
 static gboolean
 vfolder_loader_fetch_cb (gpointer user_data, GSList **resultItems)
 {
 	vfolderPtr	vfolder = (vfolderPtr)user_data;
 	itemSetPtr	items = g_new0 (struct itemSet, 1);
-	GList		*iter;
+	GList		*loaded, *iter;
 	gboolean	result;
 
 	/* 1. Fetch a batch of items */
-	result = db_itemset_get (items, vfolder->loadOffset, VFOLDER_LOADER_BATCH_SIZE);
-	vfolder->loadOffset += VFOLDER_LOADER_BATCH_SIZE;
+	if (vfolder->loadMatches) {
+		items->nodeId = vfolder->node->id;
+		result = db_search_folder_get (items, &vfolder->loadCursor, VFOLDER_LOADER_BATCH_SIZE);
+	} else {
+		result = db_itemset_get (items, &vfolder->loadCursor, VFOLDER_LOADER_BATCH_SIZE);
+	}
 
 	if (result) {
-		/* 2. Match all items against search folder */
-		iter = items->ids;
-		while (iter) {
-			gulong id = GPOINTER_TO_UINT (iter->data);
+		/* 2. Match all items against search folder (unless done by the DB) */
+		loaded = itemset_load_items (items->ids);
+		for (iter = loaded; iter; iter = g_list_next (iter)) {
+			itemPtr	item = (itemPtr)iter->data;
 
-			itemPtr	item = db_item_load (id);
-			if (itemset_check_item (vfolder->itemset, item))
+			if (vfolder->loadMatches || itemset_check_item (vfolder->itemset, item))
 				*resultItems = g_slist_append (*resultItems, item);
 			else
 				item_unload (item);
-
-			iter = g_list_next (iter);
 		}
+		g_list_free (loaded);
 	} else {
 		debug1 (DEBUG_CACHE, "search folder '%s' reload complete", vfolder->node->title);
 		vfolder->reloading = FALSE;
@@ -62,12 +262,11 @@ vfolder_loader_fetch_cb (gpointer user_data, GSList **resultItems)
 
 	itemset_free (items);
 
-	/* 3. Save items to DB and update UI (except for search results) */
-	if (vfolder->node) {
+	/* 3. Save items to DB and update UI */
+	if (!vfolder->loadMatches)
 		db_search_folder_add_items (vfolder->node->id, *resultItems);
-		node_update_counters (vfolder->node);
-		feed_list_view_update_node (vfolder->node->id);
-	}
+	node_update_counters (vfolder->node);
+	feed_list_view_update_node (vfolder->node->id);
 
 	return result;	/* FALSE on last fetch */
 }
@@ -75,7 +274,10 @@ vfolder_loader_fetch_cb (gpointer user_data, GSList **resultItems)
 ItemLoader *
 vfolder_loader_new (nodePtr node)
 {
-	vfolderPtr vfolder = (vfolderPtr)node->data;
+	vfolderPtr	vfolder = (vfolderPtr)node->data;
+	dbReaderPtr	reader;
+	GSList		*params = NULL;
+	gchar		*condition;
 
 	if(vfolder->reloading) {
 		debug1 (DEBUG_CACHE, "search folder '%s' still reloading", node->title);
@@ -84,8 +286,22 @@ vfolder_loader_new (nodePtr node)
 
 	debug1 (DEBUG_CACHE, "search folder '%s' reload started", node->title);
 	vfolder_reset (vfolder);
+	vfolder->loadCursor = DB_ITEM_CURSOR_START;
+	vfolder->loadMatches = FALSE;
+
+	/* Let the DB do the matching if possible */
+	condition = itemset_rules_to_sql (vfolder->itemset, &params);
+	if (!condition)
+		debug1 (DEBUG_CACHE, "search folder '%s' has rules that can only be matched in memory", node->title);
+	else if ((reader = db_reader_new ()))
+		return vfolder_loader_new_threaded (node, reader, condition, params);
+	else
+		vfolder->loadMatches = db_search_folder_add_matching (node->id, condition, params);
+
+	g_slist_free_full (params, g_free);
+	g_free (condition);
+
 	vfolder->reloading = TRUE;
-	vfolder->loadOffset = 0;
 
-        return item_loader_new (vfolder_loader_fetch_cb, node, vfolder);
+	return item_loader_new (vfolder_loader_fetch_cb, node, vfolder);
 }
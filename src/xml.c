@@ -578,7 +578,7 @@ xml_parse_feed (feedParserCtxtPtr fpc)
 
 	/* we don't like no data */
 	if (0 == fpc->dataLength) {
-		debug1 (DEBUG_PARSING, "xml_parse_feed(): empty input while parsing \"%s\"!", fpc->subscription->node->title);
+		debug1 (DEBUG_PARSING, "xml_parse_feed(): empty input while parsing \"%s\"!", fpc->subscription->source);
 		g_string_append (fpc->feed->parseErrors, "Empty input!\n");
 		return NULL;
 	}
@@ -588,7 +588,7 @@ xml_parse_feed (feedParserCtxtPtr fpc)
 
 	doc = xml_parse (fpc->data, (size_t)fpc->dataLength, errors);
 	if (!doc) {
-		debug1 (DEBUG_PARSING, "xml_parse_feed(): could not parse feed \"%s\"!", fpc->subscription->node->title);
+		debug1 (DEBUG_PARSING, "xml_parse_feed(): could not parse feed \"%s\"!", fpc->subscription->source);
 		g_string_prepend (fpc->feed->parseErrors, _("XML Parser: Could not parse document:\n"));
 		g_string_append (fpc->feed->parseErrors, "\n");
 	}
@@ -599,6 +599,32 @@ xml_parse_feed (feedParserCtxtPtr fpc)
 	return doc;
 }
 
+static void
+xml_reader_parse_error (void *arg, const char *msg, xmlParserSeverities severity, xmlTextReaderLocatorPtr locator)
+{
+	if (severity == XML_PARSER_SEVERITY_WARNING ||
+	    severity == XML_PARSER_SEVERITY_VALIDITY_WARNING) {
+		debug1 (DEBUG_PARSING, "XML reader warning : %s", msg);
+		return;
+	}
+
+	xml_buffer_parse_error (arg, "%s", msg);
+}
+
+xmlTextReaderPtr
+xml_reader_new (const gchar *data, size_t length, errorCtxtPtr errors)
+{
+	xmlTextReaderPtr	reader;
+
+	g_assert (NULL != data);
+
+	reader = xmlReaderForMemory (data, (int)length, NULL, NULL, XML_PARSE_NONET);
+	if (reader && errors)
+		xmlTextReaderSetErrorHandler (reader, xml_reader_parse_error, errors);
+
+	return reader;
+}
+
 void
 xml_init (void)
 {
@@ -25,6 +25,7 @@
 #include <glib.h>
 #include <libxml/xmlmemory.h>
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 
 #include "feed_parser.h"
 
@@ -207,4 +208,17 @@ xmlDocPtr xml_parse (const gchar *data, size_t length, errorCtxtPtr errors);
  */
 xmlDocPtr xml_parse_feed (feedParserCtxtPtr fpc);
 
+/**
+ * Creates a XML reader for streaming parsing of the given buffer.
+ * Parser errors are reported to the error context. Other than
+ * xml_parse() the reader does not resolve HTML entities.
+ *
+ * @param data		XML document buffer (must stay valid until the reader is freed)
+ * @param length	length of buffer
+ * @param errors	parser error context (can be NULL)
+ *
+ * @return XML reader to be free'd with xmlFreeTextReader() or NULL
+ */
+xmlTextReaderPtr xml_reader_new (const gchar *data, size_t length, errorCtxtPtr errors);
+
 #endif